@@ -2,6 +2,7 @@
 #define __Configuration_h
 
 #include <sstream>
+#include <vector>
 #include "PkModelingCLP.h"
 
 //! Simple struct encapsulating all configuration options comming from the command line
@@ -18,12 +19,23 @@ public:
   float MaxIter;
   float Hematocrit;
   float AUCTimeInterval;
+  std::vector<float> AUCTimeIntervals;
   bool ComputeFpv;
+  bool SinglePass;
+  bool ResumeFromConcentrations;
+  bool AnalyticAIF;
+  int AIFShiftsPerFrame;
+  bool SemiQuantitativeOnly;
+  bool MemoryMapInput;
+  bool MemoryMapOutputs;
   std::string AIFMode;
+  int AutoAIFCandidates;
   std::string InputFourDImageFileName;
+  std::string InputSidecarFileName;
   std::string ROIMaskFileName;
   std::string T1MapFileName;
   std::string AIFMaskFileName;
+  std::string AIFRegionMapFileName;
   std::string PrescribedAIFFileName;
   std::string OutputKtransFileName;
   std::string OutputVeFileName;
@@ -31,12 +43,24 @@ public:
   std::string OutputMaxSlopeFileName;
   std::string OutputAUCFileName;
   std::string BATCalculationMode;
+  std::string BATSource;
   int ConstantBAT;
   std::string OutputRSquaredFileName;
   std::string OutputBolusArrivalTimeImageFileName;
+  std::string OutputTimeToPeakFileName;
+  std::string OutputPeakEnhancementFileName;
+  std::string OutputWashoutSlopeFileName;
   std::string OutputConcentrationsImageFileName;
   std::string OutputFittedDataImageFileName;
   std::string OutputOptimizerDiagnosticsImageFileName;
+  std::string OutputAIFMaskFileName;
+  std::string OutputParameterMapsFileName;
+  std::string OutputSparseFileName;
+  std::string OutputModelManifestFileName;
+  std::string OutputHDF5FileName;
+  bool OutputHDF5IncludeInput;
+  std::string OutputCompression;
+  std::string OutputCompressor;
 
   ModuleProcessInformation* CLPProcessInformation;
 };
@@ -58,12 +82,23 @@ public:
     configuration.MaxIter = MaxIter; \
     configuration.Hematocrit = Hematocrit; \
     configuration.AUCTimeInterval = AUCTimeInterval; \
+    configuration.AUCTimeIntervals = AUCTimeIntervals; \
     configuration.ComputeFpv = ComputeFpv; \
+    configuration.SinglePass = SinglePass; \
+    configuration.ResumeFromConcentrations = ResumeFromConcentrations; \
+    configuration.AnalyticAIF = AnalyticAIF; \
+    configuration.AIFShiftsPerFrame = AIFShiftsPerFrame; \
+    configuration.SemiQuantitativeOnly = SemiQuantitativeOnly; \
+    configuration.MemoryMapInput = MemoryMapInput; \
+    configuration.MemoryMapOutputs = MemoryMapOutputs; \
     configuration.AIFMode = AIFMode; \
+    configuration.AutoAIFCandidates = AutoAIFCandidates; \
     configuration.InputFourDImageFileName = InputFourDImageFileName; \
+    configuration.InputSidecarFileName = InputSidecarFileName; \
     configuration.ROIMaskFileName = ROIMaskFileName; \
     configuration.T1MapFileName = T1MapFileName; \
     configuration.AIFMaskFileName = AIFMaskFileName; \
+    configuration.AIFRegionMapFileName = AIFRegionMapFileName; \
     configuration.PrescribedAIFFileName = PrescribedAIFFileName; \
     configuration.OutputKtransFileName = OutputKtransFileName; \
     configuration.OutputVeFileName = OutputVeFileName; \
@@ -71,12 +106,24 @@ public:
     configuration.OutputMaxSlopeFileName = OutputMaxSlopeFileName; \
     configuration.OutputAUCFileName = OutputAUCFileName; \
     configuration.BATCalculationMode = BATCalculationMode; \
+    configuration.BATSource = BATSource; \
     configuration.ConstantBAT = ConstantBAT; \
     configuration.OutputRSquaredFileName = OutputRSquaredFileName; \
     configuration.OutputBolusArrivalTimeImageFileName = OutputBolusArrivalTimeImageFileName; \
+    configuration.OutputTimeToPeakFileName = OutputTimeToPeakFileName; \
+    configuration.OutputPeakEnhancementFileName = OutputPeakEnhancementFileName; \
+    configuration.OutputWashoutSlopeFileName = OutputWashoutSlopeFileName; \
     configuration.OutputConcentrationsImageFileName = OutputConcentrationsImageFileName; \
     configuration.OutputFittedDataImageFileName = OutputFittedDataImageFileName; \
     configuration.OutputOptimizerDiagnosticsImageFileName = OutputOptimizerDiagnosticsImageFileName; \
+    configuration.OutputAIFMaskFileName = OutputAIFMaskFileName; \
+    configuration.OutputParameterMapsFileName = OutputParameterMapsFileName; \
+    configuration.OutputSparseFileName = OutputSparseFileName; \
+    configuration.OutputModelManifestFileName = OutputModelManifestFileName; \
+    configuration.OutputHDF5FileName = OutputHDF5FileName; \
+    configuration.OutputHDF5IncludeInput = OutputHDF5IncludeInput; \
+    configuration.OutputCompression = OutputCompression; \
+    configuration.OutputCompressor = OutputCompressor; \
     \
     configuration.CLPProcessInformation = CLPProcessInformation; \
   } \
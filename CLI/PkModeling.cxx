@@ -23,11 +23,37 @@ int main(int argc, char * argv[])
   // when the test succeeds (to see the reproducibility error measure)
   std::cout << "ctest needs: CTEST_FULL_OUTPUT" << std::endl;
 
-  PkModeling pkModeling(configuration);
-
   try
   {
-    pkModeling.execute();
+    // Integer signal intensities are kept in their stored type, which halves
+    // the memory of the input
+    itk::ImageIOBase::IOPixelType pixelType;
+    itk::ImageIOBase::IOComponentType componentType;
+    std::string inputFileName = configuration.InputFourDImageFileName;
+    if (itksys::SystemTools::FileIsDirectory(inputFileName))
+    {
+      // the type of all files of the series, not just of the first one
+      componentType = DICOMMultiVolumeReader(inputFileName).getComponentType();
+    }
+    else
+    {
+      itk::GetImageType(inputFileName, pixelType, componentType);
+    }
+    if (componentType == itk::ImageIOBase::SHORT)
+    {
+      PkModeling<short> pkModeling(configuration);
+      pkModeling.execute();
+    }
+    else if (componentType == itk::ImageIOBase::USHORT)
+    {
+      PkModeling<unsigned short> pkModeling(configuration);
+      pkModeling.execute();
+    }
+    else
+    {
+      PkModeling<float> pkModeling(configuration);
+      pkModeling.execute();
+    }
   }
   catch (std::exception& excep)
   {
@@ -5,39 +5,69 @@
 
 #include "itkMetaDataObject.h"
 #include "itkImageFileReader.h"
+#include "itkImageIOFactory.h"
 #include "itkImageFileWriter.h"
+#include "itkCastImageFilter.h"
+#include "itkExtractImageFilter.h"
 #include "itkTimeProbesCollectorBase.h"
 #include "itkMultiThreader.h"
 #include "itkResampleImageFilter.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
 
 #include "itkPluginUtilities.h"
+#include "itksys/SystemTools.hxx"
 
 #include "itkSignalIntensityToConcentrationImageFilter.h"
 #include "itkConcentrationToQuantitativeImageFilter.h"
+#include "itkSignalIntensityToQuantitativeImageFilter.h"
+#include "itkSignalIntensityToBATImageFilter.h"
 
 #include "AIF/ArterialInputFunctionPrescribed.h"
 #include "AIF/ArterialInputFunctionPopulation.h"
 #include "AIF/ArterialInputFunctionAverageUnderMask.h"
+#include "AIF/ArterialInputFunctionAuto.h"
+#include "AIF/SignalToConcentrationCurveSource.h"
 
 #include "BAT/BolusArrivalTimeEstimator.h"
 #include "BAT/BolusArrivalTimeEstimatorConstant.h"
 #include "BAT/BolusArrivalTimeEstimatorPeakGradient.h"
+#include "BAT/BolusArrivalTimeEstimatorPiecewiseLinear.h"
 
+#include "IO/AsyncVolumeWriter.h"
+#include "IO/BIDSSidecarReader.h"
+#include "IO/DICOMMultiVolumeReader.h"
+#include "IO/HDF5CurveWriter.h"
+#include "IO/MappedFile.h"
+#include "IO/MappedNrrdVolume.h"
+#include "IO/ModelManifest.h"
+#include "IO/MultiVolumeMetaDataProvider.h"
 #include "IO/MultiVolumeMetaDictReader.h"
+#include "IO/RawVolumeLayout.h"
+#include "IO/SparseVolume.h"
+
+#include "Exceptions.h"
+#include "StringUtils.h"
 
 #include <sstream>
 #include <fstream>
 #include <memory>
+#include <map>
+#include <algorithm>
+#include <limits>
 
 
 //! Slicer Extension providing pharmacokinetic modeling for dynamic contrast enhanced MRI.
+//! TSignalPixel is the component type the signal intensities are kept in,
+//! concentrations and outputs are always float.
+template <class TSignalPixel>
 class PkModeling {
 // Helper typedefs to make the code easier to read with all the templates
 private:
   static const unsigned int VectorVolumeDimension = 3;
-  typedef itk::VectorImage<float, VectorVolumeDimension> VectorVolumeType;
-  typedef itk::ImageFileReader<VectorVolumeType>         VectorVolumeReaderType;
+  typedef itk::VectorImage<TSignalPixel, VectorVolumeDimension> SignalVolumeType;
+  typedef itk::ImageFileReader<SignalVolumeType>                SignalVolumeReaderType;
+  typedef itk::VectorImage<float, VectorVolumeDimension>        VectorVolumeType;
+  typedef itk::ImageBase<VectorVolumeDimension>                 ReferenceVolumeType;
 
   static const unsigned int MaskVolumeDimension = 3;
   typedef itk::Image<unsigned short, MaskVolumeDimension> MaskVolumeType;
@@ -48,27 +78,46 @@ private:
   typedef itk::ResampleImageFilter<MaskVolumeType, MaskVolumeType>     ResamplerType;
   typedef itk::NearestNeighborInterpolateImageFunction<MaskVolumeType> InterpolatorType;
 
-  typedef itk::SignalIntensityToConcentrationImageFilter<VectorVolumeType, MaskVolumeType, VectorVolumeType> ConvertFilterType;
+  typedef itk::SignalIntensityToConcentrationImageFilter<SignalVolumeType, MaskVolumeType, VectorVolumeType> ConvertFilterType;
   typedef itk::ConcentrationToQuantitativeImageFilter<VectorVolumeType, MaskVolumeType, OutputVolumeType>    QuantifierType;
+  typedef itk::SignalIntensityToQuantitativeImageFilter<SignalVolumeType, MaskVolumeType, OutputVolumeType>  SinglePassQuantifierType;
+  typedef itk::SignalIntensityToBATImageFilter<SignalVolumeType, OutputVolumeType, MaskVolumeType>           BATFilterType;
+  typedef itk::CastImageFilter<SignalVolumeType, VectorVolumeType>                                         SignalCastFilterType;
+
+  typedef std::map<MaskVolumeType::PixelType, std::unique_ptr<ArterialInputFunction> > RegionalAIFMap;
+  typedef std::map<std::string, std::unique_ptr<MappedNrrdVolume> > OutputMappings;
 
 // Member Variables
 private:
   const Configuration m_config;
 
   // Input Data
-  VectorVolumeType::Pointer m_inputVectorVolume;
+  // declared first, the input volume and the curve outputs may reference
+  // the mapped pages
+  std::unique_ptr<MappedFile> m_inputMapping;
+  OutputMappings m_outputMappings;
+  typename SignalVolumeType::Pointer m_inputVectorVolume;
   MaskVolumeType::Pointer m_aifMaskVolume;
   MaskVolumeType::Pointer m_T1MapVolume;
   MaskVolumeType::Pointer m_roiMaskVolume;
-  std::unique_ptr<MultiVolumeMetaDictReader> m_imageMetaDict;
+  MaskVolumeType::Pointer m_aifRegionMapVolume;
+  // the input as float when resuming from concentrations
+  VectorVolumeType::Pointer m_resumedConcentrations;
+  std::unique_ptr<MultiVolumeMetaDataProvider> m_imageMetaDict;
 
   // Filters
-  ConvertFilterType::Pointer m_signalToConcentrationsConverter;
+  typename BATFilterType::Pointer m_signalToBATFilter;
+  typename ConvertFilterType::Pointer m_signalToConcentrationsConverter;
   QuantifierType::Pointer m_concentrationsToQuantitativeImageFilter;
+  typename SinglePassQuantifierType::Pointer m_signalToQuantitativeImageFilter;
 
   // Computation Strategies for Filters
   std::unique_ptr<BolusArrivalTime::BolusArrivalTimeEstimator> m_batEstimator;
   std::unique_ptr<ArterialInputFunction> m_aif;
+  RegionalAIFMap m_regionalAIFs;
+
+  // Writes the outputs while the processing goes on
+  std::unique_ptr<AsyncVolumeWriter> m_outputWriter;
 
   // Progress Watchers
   std::vector<itk::PluginFilterWatcher> m_progressWatchers;
@@ -96,43 +145,273 @@ public:
 private:
   void initialize()
   {
+    m_outputWriter = getOutputWriter();
     m_inputVectorVolume = getVectorVolume(m_config.InputFourDImageFileName);
     m_batEstimator = getBatEstimator();
 
-    m_imageMetaDict.reset(new MultiVolumeMetaDictReader(m_inputVectorVolume->GetMetaDataDictionary()));
+    m_imageMetaDict = getMetaDataProvider();
 
     m_aifMaskVolume = getMaskVolumeOrNull(m_config.AIFMaskFileName);
     m_T1MapVolume = getMaskVolumeOrNull(m_config.T1MapFileName);
     m_roiMaskVolume = getResampledMaskVolumeOrNull(m_config.ROIMaskFileName, m_inputVectorVolume);
+    if (m_config.AIFMode == "AverageUnderAIFMask") {
+      m_aifRegionMapVolume = getResampledMaskVolumeOrNull(m_config.AIFRegionMapFileName, m_inputVectorVolume);
+    }
   }
 
   void setupProcessingPipeline()
   {
-    setupSignalToConcentrationsConverter();
-    setupAIF();
-    setupConcentrationsToQuantitativeImageFilter();
+    if (m_config.ResumeFromConcentrations) {
+      setupResumedQuantitativeImageFilter();
+    }
+    else if (m_config.SinglePass) {
+      setupSignalToQuantitativeImageFilter();
+    }
+    else {
+      setupAIF();
+      setupSignalToBATFilter();
+      setupSignalToConcentrationsConverter();
+      setupConcentrationsToQuantitativeImageFilter();
+    }
   }
 
   void runProcessingPipeline()
   {
+    if (!m_config.SinglePass && !m_config.ResumeFromConcentrations) {
+      // the concentrations are written while the model is fitted
+      m_signalToConcentrationsConverter->Update();
+      writeConcentrationsIfFileNameValid();
+    }
     m_concentrationsToQuantitativeImageFilter->Update();
   }
 
+  //! Queues all requested outputs and waits until they are written.
+  //! Throws if any of them could not be written.
   void writeResults()
   {
-    writeMultiVolumeIfFileNameValid(m_config.OutputConcentrationsImageFileName, m_signalToConcentrationsConverter->GetOutput(), m_inputVectorVolume);
-    writeMultiVolumeIfFileNameValid(m_config.OutputFittedDataImageFileName, m_concentrationsToQuantitativeImageFilter->GetFittedDataOutput(), m_inputVectorVolume);
+    if (m_config.SinglePass || m_config.ResumeFromConcentrations) {
+      writeConcentrationsIfFileNameValid();
+    }
+    // the model parameters are not computed in semi-quantitative mode
+    if (!m_config.SemiQuantitativeOnly) {
+      writeMultiVolumeIfFileNameValid(m_config.OutputFittedDataImageFileName, m_concentrationsToQuantitativeImageFilter->GetFittedDataOutput(), m_inputVectorVolume);
+      writeVolumeIfFileNameValid(m_config.OutputKtransFileName, m_concentrationsToQuantitativeImageFilter->GetKTransOutput());
+      writeVolumeIfFileNameValid(m_config.OutputVeFileName, m_concentrationsToQuantitativeImageFilter->GetVEOutput());
+      writeVolumeIfFileNameValid(m_config.OutputRSquaredFileName, m_concentrationsToQuantitativeImageFilter->GetRSquaredOutput());
+      writeVolumeIfFileNameValid(m_config.OutputOptimizerDiagnosticsImageFileName, m_concentrationsToQuantitativeImageFilter->GetOptimizerDiagnosticsOutput());
+      if (m_config.ComputeFpv) {
+        writeVolumeIfFileNameValid(m_config.OutputFpvFileName, m_concentrationsToQuantitativeImageFilter->GetFPVOutput());
+      }
+      if (!m_config.OutputModelManifestFileName.empty()) {
+        writeModelManifest(m_config.OutputModelManifestFileName, m_concentrationsToQuantitativeImageFilter->GetModelManifest());
+      }
+    }
 
-    writeVolumeIfFileNameValid(m_config.OutputKtransFileName, m_concentrationsToQuantitativeImageFilter->GetKTransOutput());
-    writeVolumeIfFileNameValid(m_config.OutputVeFileName, m_concentrationsToQuantitativeImageFilter->GetVEOutput());
     writeVolumeIfFileNameValid(m_config.OutputMaxSlopeFileName, m_concentrationsToQuantitativeImageFilter->GetMaxSlopeOutput());
-    writeVolumeIfFileNameValid(m_config.OutputAUCFileName, m_concentrationsToQuantitativeImageFilter->GetAUCOutput());
-    writeVolumeIfFileNameValid(m_config.OutputRSquaredFileName, m_concentrationsToQuantitativeImageFilter->GetRSquaredOutput());
+    if (m_config.AUCTimeIntervals.empty()) {
+      writeVolumeIfFileNameValid(m_config.OutputAUCFileName, m_concentrationsToQuantitativeImageFilter->GetAUCOutput());
+    }
+    else if (!m_config.OutputAUCFileName.empty()) {
+      for (unsigned int i = 0; i < m_config.AUCTimeIntervals.size(); ++i) {
+        std::ostringstream suffix;
+        suffix << "-" << m_config.AUCTimeIntervals[i] << "s";
+        writeVolumeIfFileNameValid(StringUtils::insertBeforeExtension(m_config.OutputAUCFileName, suffix.str()),
+                                   m_concentrationsToQuantitativeImageFilter->GetAUCOutput(i));
+      }
+    }
     writeVolumeIfFileNameValid(m_config.OutputBolusArrivalTimeImageFileName, m_concentrationsToQuantitativeImageFilter->GetBATOutput());
-    writeVolumeIfFileNameValid(m_config.OutputOptimizerDiagnosticsImageFileName, m_concentrationsToQuantitativeImageFilter->GetOptimizerDiagnosticsOutput());
+    writeVolumeIfFileNameValid(m_config.OutputTimeToPeakFileName, m_concentrationsToQuantitativeImageFilter->GetTimeToPeakOutput());
+    writeVolumeIfFileNameValid(m_config.OutputPeakEnhancementFileName, m_concentrationsToQuantitativeImageFilter->GetPeakEnhancementOutput());
+    writeVolumeIfFileNameValid(m_config.OutputWashoutSlopeFileName, m_concentrationsToQuantitativeImageFilter->GetWashoutSlopeOutput());
+    if (!m_config.OutputParameterMapsFileName.empty()) {
+      writeVolumeIfFileNameValid(m_config.OutputParameterMapsFileName, m_concentrationsToQuantitativeImageFilter->GetParameterMapsOutput());
+    }
+    if (m_config.AIFMode == "Auto") {
+      writeVolumeIfFileNameValid(m_config.OutputAIFMaskFileName, m_aifMaskVolume.GetPointer());
+    }
+    // written here while the queued outputs are written on other threads
+    if (!m_config.OutputSparseFileName.empty()) {
+      writeSparseResults(m_config.OutputSparseFileName);
+    }
+    // the voxels of the mapped outputs are in their files already
+    for (OutputMappings::const_iterator it = m_outputMappings.begin(); it != m_outputMappings.end(); ++it) {
+      it->second->flush();
+    }
+    m_outputWriter->wait();
+    // after the queued outputs, as HDF5 must not be used from several threads
+    if (!m_config.OutputHDF5FileName.empty()) {
+      writeHDF5Results(m_config.OutputHDF5FileName);
+    }
+  }
 
-    if (m_config.ComputeFpv) {
-      writeVolumeIfFileNameValid(m_config.OutputFpvFileName, m_concentrationsToQuantitativeImageFilter->GetFPVOutput());
+  //! Writes the concentration and fitted curves, and the input if asked
+  //! for, to one HDF5 file with the geometry and MultiVolume meta data of
+  //! the input
+  void writeHDF5Results(const std::string& fileName)
+  {
+    unsigned int size[3];
+    double spacing[3];
+    double origin[3];
+    double direction[3][3];
+    getInputGeometry(size, spacing, origin, direction);
+    HDF5CurveWriter writer(fileName, size, spacing, origin, direction, getHDF5CompressionLevel());
+
+    const std::map<std::string, std::string> metaData = getMultiVolumeMetaData();
+    std::map<std::string, std::string>::const_iterator it;
+    for (it = metaData.begin(); it != metaData.end(); ++it) {
+      writer.writeAttribute(it->first, it->second);
+    }
+
+    const unsigned int numberOfFrames = m_inputVectorVolume->GetNumberOfComponentsPerPixel();
+    if (m_config.OutputHDF5IncludeInput) {
+      writer.write("Input", m_inputVectorVolume->GetBufferPointer(), numberOfFrames);
+    }
+    writer.write("Concentrations", getConcentrationsOutput()->GetBufferPointer(), numberOfFrames);
+    if (!m_config.SemiQuantitativeOnly) {
+      writer.write("Fitted", m_concentrationsToQuantitativeImageFilter->GetFittedDataOutput()->GetBufferPointer(), numberOfFrames);
+    }
+  }
+
+  //! Deflate level of the HDF5 chunks for the output compression
+  int getHDF5CompressionLevel() const
+  {
+    if (m_config.OutputCompression == "None") {
+      return 0;
+    }
+    else if (m_config.OutputCompression == "Fast") {
+      return 1;
+    }
+    else if (m_config.OutputCompression == "Best") {
+      return 9;
+    }
+    return 4;
+  }
+
+  //! Size, spacing, origin and direction (row major) of the input
+  void getInputGeometry(unsigned int size[3], double spacing[3], double origin[3], double direction[3][3]) const
+  {
+    for (unsigned int i = 0; i < 3; ++i) {
+      size[i] = m_inputVectorVolume->GetLargestPossibleRegion().GetSize(i);
+      spacing[i] = m_inputVectorVolume->GetSpacing()[i];
+      origin[i] = m_inputVectorVolume->GetOrigin()[i];
+      for (unsigned int j = 0; j < 3; ++j) {
+        direction[i][j] = m_inputVectorVolume->GetDirection()[i][j];
+      }
+    }
+  }
+
+  //! The MultiVolume.* fields of the input, for the curve outputs
+  std::map<std::string, std::string> getMultiVolumeMetaData() const
+  {
+    std::map<std::string, std::string> metaData;
+    const itk::MetaDataDictionary& dictionary = m_inputVectorVolume->GetMetaDataDictionary();
+    const std::vector<std::string> keys = dictionary.GetKeys();
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      std::string value;
+      if (keys[i].compare(0, 12, "MultiVolume.") == 0 && itk::ExposeMetaData<std::string>(dictionary, keys[i], value)) {
+        metaData[keys[i]] = value;
+      }
+    }
+    return metaData;
+  }
+
+  //! With MemoryMapOutputs, creates the file of the multi-volume output
+  //! fileName up front and returns its mapped voxels for the filter to
+  //! write to. NULL if the output is not mapped, e.g. not a .nrrd file.
+  float* getMappedOutputBuffer(const std::string& fileName,
+                               const std::map<std::string, std::string>& extraMetaData = std::map<std::string, std::string>())
+  {
+    if (!m_config.MemoryMapOutputs || fileName.empty() || !MappedNrrdVolume::canMap(fileName)) {
+      return NULL;
+    }
+    unsigned int size[3];
+    double spacing[3];
+    double origin[3];
+    double direction[3][3];
+    getInputGeometry(size, spacing, origin, direction);
+    std::map<std::string, std::string> metaData = getMultiVolumeMetaData();
+    metaData.insert(extraMetaData.begin(), extraMetaData.end());
+    std::unique_ptr<MappedNrrdVolume>& mapping = m_outputMappings[fileName];
+    mapping.reset(new MappedNrrdVolume(fileName, size, m_inputVectorVolume->GetNumberOfComponentsPerPixel(),
+                                       spacing, origin, direction, metaData));
+    return mapping->data();
+  }
+
+  //! Writes the scalar maps and the curves of the voxels in the ROI, of all
+  //! voxels without ROI, as a sparse volume with the geometry and the
+  //! MultiVolume meta data of the input
+  void writeSparseResults(const std::string& fileName)
+  {
+    SparseVolume sparse;
+    getInputGeometry(sparse.size, sparse.spacing, sparse.origin, sparse.direction);
+    sparse.metaData = getMultiVolumeMetaData();
+
+    // the mask is resampled to the input, so the linear indices match
+    if (m_roiMaskVolume.IsNotNull()) {
+      itk::ImageRegionConstIterator<MaskVolumeType> maskIter(m_roiMaskVolume, m_roiMaskVolume->GetLargestPossibleRegion());
+      for (unsigned long long index = 0; !maskIter.IsAtEnd(); ++maskIter, ++index) {
+        if (maskIter.Get()) {
+          sparse.indices.push_back(index);
+        }
+      }
+    }
+    else {
+      for (unsigned long long index = 0; index < sparse.numberOfVoxels(); ++index) {
+        sparse.indices.push_back(index);
+      }
+    }
+
+    const std::vector<std::string> names = m_concentrationsToQuantitativeImageFilter->GetParameterMapNames();
+    const std::vector<OutputVolumeType*> maps = m_concentrationsToQuantitativeImageFilter->GetParameterMapOutputs();
+    for (std::size_t i = 0; i < maps.size(); ++i) {
+      addSparseChannel(sparse, names[i], maps[i]->GetBufferPointer(), 1);
+    }
+    const VectorVolumeType* concentrations = getConcentrationsOutput();
+    addSparseChannel(sparse, "Concentrations", concentrations->GetBufferPointer(), concentrations->GetNumberOfComponentsPerPixel());
+    if (!m_config.SemiQuantitativeOnly) {
+      const VectorVolumeType* fitted = m_concentrationsToQuantitativeImageFilter->GetFittedDataOutput();
+      addSparseChannel(sparse, "Fitted", fitted->GetBufferPointer(), fitted->GetNumberOfComponentsPerPixel());
+    }
+
+    writeSparseVolume(fileName, sparse);
+  }
+
+  //! Adds the records of the sparse voxels from the buffer of a volume,
+  //! nothing if the volume was not computed
+  static void addSparseChannel(SparseVolume& sparse, const std::string& name, const float* buffer, unsigned int numberOfComponents)
+  {
+    if (!buffer) {
+      return;
+    }
+    SparseVolume::Channel channel(name, numberOfComponents);
+    channel.values.resize(sparse.indices.size() * numberOfComponents);
+    float* record = channel.values.empty() ? NULL : &channel.values[0];
+    for (std::size_t i = 0; i < sparse.indices.size(); ++i, record += numberOfComponents) {
+      std::copy(buffer + sparse.indices[i] * numberOfComponents,
+                buffer + (sparse.indices[i] + 1) * numberOfComponents, record);
+    }
+    sparse.channels.push_back(channel);
+  }
+
+  //! The AIF mask is drawn by the user, or detected when the AIF is set up
+  bool usesAIFMask() const
+  {
+    return m_config.AIFMode == "AverageUnderAIFMask" || m_config.AIFMode == "Auto";
+  }
+
+  //! With BATSource "Signal" the BAT is estimated once on the signal intensities
+  //! and shared by S0 estimation and the model fit
+  void setupSignalToBATFilter()
+  {
+    if (m_config.BATSource != "Signal") {
+      return;
+    }
+    m_signalToBATFilter = BATFilterType::New();
+    m_signalToBATFilter->SetInput(m_inputVectorVolume);
+    m_signalToBATFilter->SetBatEstimator(m_batEstimator.get());
+    m_signalToBATFilter->SetROIMask(m_roiMaskVolume);
+    if (usesAIFMask()) {
+      m_signalToBATFilter->SetAIFMask(m_aifMaskVolume);
     }
   }
 
@@ -143,15 +422,20 @@ private:
     m_signalToConcentrationsConverter->SetROIMask(m_roiMaskVolume);
     m_signalToConcentrationsConverter->SetT1PreBlood(m_config.T1PreBloodValue);
     m_signalToConcentrationsConverter->SetT1PreTissue(m_config.T1PreTissueValue);
-    m_signalToConcentrationsConverter->SetTR(m_imageMetaDict->get("MultiVolume.DICOM.RepetitionTime"));
-    m_signalToConcentrationsConverter->SetFA(m_imageMetaDict->get("MultiVolume.DICOM.FlipAngle"));
+    m_signalToConcentrationsConverter->SetTR(m_imageMetaDict->getRepetitionTime());
+    m_signalToConcentrationsConverter->SetFA(m_imageMetaDict->getFlipAngle());
     m_signalToConcentrationsConverter->SetBatEstimator(m_batEstimator.get());
     m_signalToConcentrationsConverter->SetRGD_relaxivity(m_config.RelaxivityValue);
     m_signalToConcentrationsConverter->SetS0GradThresh(m_config.S0GradValue);
     m_signalToConcentrationsConverter->SetT1Map(m_T1MapVolume);
-    if (m_config.AIFMode == "AverageUnderAIFMask") {
+    if (usesAIFMask()) {
       m_signalToConcentrationsConverter->SetAIFMask(m_aifMaskVolume);
     }
+    if (m_signalToBATFilter.IsNotNull()) {
+      m_signalToConcentrationsConverter->SetBATMap(m_signalToBATFilter->GetOutput());
+    }
+    m_signalToConcentrationsConverter->SetOutputBuffer(getMappedOutputBuffer(m_config.OutputConcentrationsImageFileName,
+                                                                             getConversionMetaData()));
 
     m_progressWatchers.push_back(itk::PluginFilterWatcher(m_signalToConcentrationsConverter, "Concentrations", m_config.CLPProcessInformation, 1.0 / 20.0, 0.0));
   }
@@ -166,18 +450,231 @@ private:
     {
       m_aif.reset(new ArterialInputFunctionPopulation(m_imageMetaDict->getTiming()));
     }
+    else if (m_config.AIFMode == "Auto")
+    {
+      // The AIF mask, if any, restricts the search and is replaced by the detected voxels
+      std::unique_ptr<SignalToConcentrationCurveSource> curveSource = getAIFCurveSource();
+      std::unique_ptr<ArterialInputFunctionAuto> aif(new ArterialInputFunctionAuto(*curveSource, m_inputVectorVolume,
+                                                                                   m_aifMaskVolume, m_imageMetaDict->getTiming(),
+                                                                                   m_config.AutoAIFCandidates));
+      m_aifMaskVolume = aif->getAIFMask();
+      m_aif = std::move(aif);
+    }
+    else if (m_config.ResumeFromConcentrations)
+    {
+      m_aif.reset(new ArterialInputFunctionAverageUnderMask(m_resumedConcentrations, m_aifMaskVolume));
+    }
     else
     {
-      m_aif.reset(new ArterialInputFunctionAverageUnderMask(m_signalToConcentrationsConverter->GetOutput(), m_aifMaskVolume));
+      // Only the voxels under the AIF mask are converted, the concentration image is not needed yet
+      std::unique_ptr<SignalToConcentrationCurveSource> curveSource = getAIFCurveSource();
+      m_aif.reset(new ArterialInputFunctionAverageUnderMask(*curveSource, m_aifMaskVolume));
+    }
+  }
+
+  //! One AIF per label of the AIF mask, for the regions of the AIF region map
+  void setupRegionalAIFs()
+  {
+    if (m_aifMaskVolume.IsNull()) {
+      throw ImageNullException("AIF mask");
+    }
+    const std::vector<MaskVolumeType::PixelType> labels = ArterialInputFunctionAverageUnderMask::getLabels(m_aifMaskVolume);
+    if (m_config.ResumeFromConcentrations) {
+      for (std::size_t i = 0; i < labels.size(); ++i)
+      {
+        m_regionalAIFs[labels[i]].reset(new ArterialInputFunctionAverageUnderMask(m_resumedConcentrations, m_aifMaskVolume, labels[i]));
+      }
+      return;
+    }
+    std::unique_ptr<SignalToConcentrationCurveSource> curveSource = getAIFCurveSource();
+    for (std::size_t i = 0; i < labels.size(); ++i)
+    {
+      m_regionalAIFs[labels[i]].reset(new ArterialInputFunctionAverageUnderMask(*curveSource, m_aifMaskVolume, labels[i]));
     }
   }
 
+  //! Concentration curves of single voxels, converted with the blood T1Pre
+  std::unique_ptr<SignalToConcentrationCurveSource> getAIFCurveSource()
+  {
+    return std::unique_ptr<SignalToConcentrationCurveSource>(
+      new SignalToConcentrationCurveSource(m_inputVectorVolume, m_config.T1PreBloodValue,
+                                           m_imageMetaDict->getRepetitionTime(),
+                                           m_imageMetaDict->getFlipAngle(),
+                                           m_config.RelaxivityValue, m_config.S0GradValue, m_batEstimator.get()));
+  }
+
   void setupConcentrationsToQuantitativeImageFilter()
   {
     m_concentrationsToQuantitativeImageFilter = QuantifierType::New();
     m_concentrationsToQuantitativeImageFilter->SetInput(m_signalToConcentrationsConverter->GetOutput());
     m_concentrationsToQuantitativeImageFilter->SetAIF(m_aif.get());
-    m_concentrationsToQuantitativeImageFilter->SetAUCTimeInterval(m_config.AUCTimeInterval);
+    if (m_signalToBATFilter.IsNotNull()) {
+      m_concentrationsToQuantitativeImageFilter->SetBATMap(m_signalToBATFilter->GetOutput());
+    }
+    configureQuantitativeImageFilter();
+
+    m_progressWatchers.push_back(itk::PluginFilterWatcher(m_concentrationsToQuantitativeImageFilter, "Quantifying", m_config.CLPProcessInformation, 19.0 / 20.0, 1.0 / 20.0));
+  }
+
+  //! Single pass alternative to the converter and quantifier, converts and fits each voxel in one go
+  void setupSignalToQuantitativeImageFilter()
+  {
+    m_signalToQuantitativeImageFilter = SinglePassQuantifierType::New();
+    m_signalToQuantitativeImageFilter->SetInput(m_inputVectorVolume);
+    m_signalToQuantitativeImageFilter->SetT1PreBlood(m_config.T1PreBloodValue);
+    m_signalToQuantitativeImageFilter->SetT1PreTissue(m_config.T1PreTissueValue);
+    m_signalToQuantitativeImageFilter->SetTR(m_imageMetaDict->getRepetitionTime());
+    m_signalToQuantitativeImageFilter->SetFA(m_imageMetaDict->getFlipAngle());
+    m_signalToQuantitativeImageFilter->SetRGD_relaxivity(m_config.RelaxivityValue);
+    m_signalToQuantitativeImageFilter->SetS0GradThresh(m_config.S0GradValue);
+    m_signalToQuantitativeImageFilter->SetT1Map(m_T1MapVolume);
+    m_signalToQuantitativeImageFilter->SetComputeConcentrations(!m_config.OutputConcentrationsImageFileName.empty() ||
+                                                                !m_config.OutputSparseFileName.empty() ||
+                                                                !m_config.OutputHDF5FileName.empty());
+    m_signalToQuantitativeImageFilter->SetUseSignalBAT(m_config.BATSource == "Signal");
+    if (m_config.AIFMode == "Auto") {
+      setupAIF();
+    }
+    // after the Auto AIF replaced the AIF mask, which is part of the meta data
+    m_signalToQuantitativeImageFilter->SetConcentrationsBuffer(getMappedOutputBuffer(m_config.OutputConcentrationsImageFileName,
+                                                                                     getConversionMetaData()));
+    if (usesAIFMask()) {
+      if (m_aifMaskVolume.IsNull()) {
+        throw ImageNullException("AIF mask");
+      }
+      m_signalToQuantitativeImageFilter->SetAIFMask(m_aifMaskVolume);
+    }
+    else {
+      setupAIF();
+      m_signalToQuantitativeImageFilter->SetAIF(m_aif.get());
+    }
+
+    m_concentrationsToQuantitativeImageFilter = m_signalToQuantitativeImageFilter.GetPointer();
+    configureQuantitativeImageFilter();
+
+    m_progressWatchers.push_back(itk::PluginFilterWatcher(m_signalToQuantitativeImageFilter, "Quantifying", m_config.CLPProcessInformation, 1.0, 0.0));
+  }
+
+  //! Fits the model to a concentration image written by an earlier run,
+  //! which must have been converted with the parameters of this run
+  void setupResumedQuantitativeImageFilter()
+  {
+    if (m_config.SinglePass) {
+      throw std::runtime_error("Single pass processing converts signal intensities, it cannot resume from concentrations.");
+    }
+    if (m_config.BATSource == "Signal") {
+      throw std::runtime_error("The BAT source \"Signal\" needs the signal intensities, it cannot resume from concentrations.");
+    }
+    if (m_config.AIFMode == "Auto") {
+      throw std::runtime_error("The Auto AIF mode needs the signal intensities, resume with the AIF mask it detected "
+                               "and the AverageUnderAIFMask mode instead.");
+    }
+    validateConversionMetaData();
+    m_resumedConcentrations = getFloatVolume(m_inputVectorVolume.GetPointer());
+    setupAIF();
+
+    m_concentrationsToQuantitativeImageFilter = QuantifierType::New();
+    m_concentrationsToQuantitativeImageFilter->SetInput(m_resumedConcentrations);
+    m_concentrationsToQuantitativeImageFilter->SetAIF(m_aif.get());
+    configureQuantitativeImageFilter();
+
+    m_progressWatchers.push_back(itk::PluginFilterWatcher(m_concentrationsToQuantitativeImageFilter, "Quantifying", m_config.CLPProcessInformation, 1.0, 0.0));
+  }
+
+  //! Throws if the input concentrations were converted with parameters
+  //! other than the ones of this run, or carry no record of them
+  void validateConversionMetaData() const
+  {
+    std::map<std::string, std::string> expected = getConversionMetaData();
+    // the AIF mask selects the voxels converted with the blood T1, which
+    // only matters if they are averaged to the AIF again
+    if (!usesAIFMask()) {
+      expected.erase("PkModeling.Concentrations.AIFMask");
+    }
+
+    const itk::MetaDataDictionary& dictionary = m_inputVectorVolume->GetMetaDataDictionary();
+    std::ostringstream mismatches;
+    std::map<std::string, std::string>::const_iterator it;
+    for (it = expected.begin(); it != expected.end(); ++it) {
+      std::string recorded;
+      if (!itk::ExposeMetaData<std::string>(dictionary, it->first, recorded)) {
+        throw std::runtime_error("\"" + m_config.InputFourDImageFileName + "\" has no meta data key \"" + it->first +
+                                 "\", it is not a concentration image written by PkModeling.");
+      }
+      if (recorded != it->second) {
+        mismatches << "\n  " << it->first << ": " << recorded << " in the concentrations, " << it->second << " in this run";
+      }
+    }
+    if (!mismatches.str().empty()) {
+      throw std::runtime_error("The concentrations were converted with other parameters:" + mismatches.str());
+    }
+  }
+
+  //! The parameters the concentrations are converted with, stored with the
+  //! concentration output to resume from it
+  std::map<std::string, std::string> getConversionMetaData() const
+  {
+    std::map<std::string, std::string> metaData;
+    metaData["PkModeling.Concentrations.T1PreBlood"] = toString(m_config.T1PreBloodValue);
+    metaData["PkModeling.Concentrations.T1PreTissue"] = toString(m_config.T1PreTissueValue);
+    metaData["PkModeling.Concentrations.T1Map"] = getMaskChecksum(m_T1MapVolume);
+    metaData["PkModeling.Concentrations.Relaxivity"] = toString(m_config.RelaxivityValue);
+    metaData["PkModeling.Concentrations.RepetitionTime"] = toString(m_imageMetaDict->getRepetitionTime());
+    metaData["PkModeling.Concentrations.FlipAngle"] = toString(m_imageMetaDict->getFlipAngle());
+    metaData["PkModeling.Concentrations.S0GradThresh"] = toString(m_config.S0GradValue);
+    metaData["PkModeling.Concentrations.BATCalculationMode"] = m_config.BATCalculationMode;
+    if (m_config.BATCalculationMode == "UseConstantBAT") {
+      metaData["PkModeling.Concentrations.ConstantBAT"] = toString(m_config.ConstantBAT);
+    }
+    metaData["PkModeling.Concentrations.BATSource"] = m_config.BATSource;
+    metaData["PkModeling.Concentrations.AIFMask"] = usesAIFMask() ? getMaskChecksum(m_aifMaskVolume) : "none";
+    return metaData;
+  }
+
+  //! Number and FNV-1a hash of the indices and values of the non-zero
+  //! voxels, "none" without mask
+  static std::string getMaskChecksum(const MaskVolumeType* mask)
+  {
+    if (!mask) {
+      return "none";
+    }
+    unsigned long long hash = 14695981039346656037ULL;
+    unsigned long long numberOfVoxels = 0;
+    itk::ImageRegionConstIterator<MaskVolumeType> maskIter(mask, mask->GetLargestPossibleRegion());
+    for (unsigned long long index = 0; !maskIter.IsAtEnd(); ++maskIter, ++index) {
+      if (!maskIter.Get()) {
+        continue;
+      }
+      ++numberOfVoxels;
+      const unsigned long long values[2] = { index, maskIter.Get() };
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values);
+      for (std::size_t i = 0; i < sizeof(values); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+      }
+    }
+    std::ostringstream checksum;
+    checksum << numberOfVoxels << ":" << std::hex << hash;
+    return checksum.str();
+  }
+
+  //! Round trips through the text of the meta data
+  template <typename T>
+  static std::string toString(T value)
+  {
+    std::ostringstream text;
+    text.precision(std::numeric_limits<T>::max_digits10);
+    text << value;
+    return text.str();
+  }
+
+  void configureQuantitativeImageFilter()
+  {
+    if (m_config.AUCTimeIntervals.empty()) {
+      m_concentrationsToQuantitativeImageFilter->SetAUCTimeInterval(m_config.AUCTimeInterval);
+    }
+    else {
+      m_concentrationsToQuantitativeImageFilter->SetAUCTimeIntervals(m_config.AUCTimeIntervals);
+    }
     m_concentrationsToQuantitativeImageFilter->SetTiming(m_imageMetaDict->getTiming());
     m_concentrationsToQuantitativeImageFilter->SetfTol(m_config.FTolerance);
     m_concentrationsToQuantitativeImageFilter->SetgTol(m_config.GTolerance);
@@ -186,15 +683,60 @@ private:
     m_concentrationsToQuantitativeImageFilter->SetmaxIter(m_config.MaxIter);
     m_concentrationsToQuantitativeImageFilter->Sethematocrit(m_config.Hematocrit);
     m_concentrationsToQuantitativeImageFilter->SetBatEstimator(m_batEstimator.get());
+    m_concentrationsToQuantitativeImageFilter->SetUseAnalyticAIF(m_config.AnalyticAIF);
+    m_concentrationsToQuantitativeImageFilter->SetAIFShiftsPerFrame(std::max(m_config.AIFShiftsPerFrame, 0));
+    m_concentrationsToQuantitativeImageFilter->SetSemiQuantitativeOnly(m_config.SemiQuantitativeOnly);
+    m_concentrationsToQuantitativeImageFilter->SetComputeParameterMaps(!m_config.OutputParameterMapsFileName.empty());
+    // the sparse output holds all maps
+    m_concentrationsToQuantitativeImageFilter->SetComputeCurveShapeMaps(!m_config.OutputTimeToPeakFileName.empty() ||
+                                                                        !m_config.OutputPeakEnhancementFileName.empty() ||
+                                                                        !m_config.OutputWashoutSlopeFileName.empty() ||
+                                                                        !m_config.OutputSparseFileName.empty());
     m_concentrationsToQuantitativeImageFilter->SetROIMask(m_roiMaskVolume);
+    if (!m_config.SemiQuantitativeOnly) {
+      m_concentrationsToQuantitativeImageFilter->SetFittedDataBuffer(getMappedOutputBuffer(m_config.OutputFittedDataImageFileName));
+    }
+    if (m_aifRegionMapVolume.IsNotNull()) {
+      setupRegionalAIFs();
+      m_concentrationsToQuantitativeImageFilter->SetAIFRegionMap(m_aifRegionMapVolume);
+      RegionalAIFMap::const_iterator it;
+      for (it = m_regionalAIFs.begin(); it != m_regionalAIFs.end(); ++it) {
+        m_concentrationsToQuantitativeImageFilter->SetRegionalAIF(it->first, it->second.get());
+      }
+    }
     if (m_config.ComputeFpv) {
       m_concentrationsToQuantitativeImageFilter->SetModelType(itk::LMCostFunction::TOFTS_3_PARAMETER);
     }
     else {
       m_concentrationsToQuantitativeImageFilter->SetModelType(itk::LMCostFunction::TOFTS_2_PARAMETER);
     }
+  }
 
-    m_progressWatchers.push_back(itk::PluginFilterWatcher(m_concentrationsToQuantitativeImageFilter, "Quantifying", m_config.CLPProcessInformation, 19.0 / 20.0, 1.0 / 20.0));
+  //! Resumed concentrations are fitted as floats. They are written as
+  //! floats, other types are only cast for files that were converted.
+  static VectorVolumeType::Pointer getFloatVolume(VectorVolumeType* volume)
+  {
+    return volume;
+  }
+
+  template <class TVolume>
+  static VectorVolumeType::Pointer getFloatVolume(TVolume* volume)
+  {
+    typename SignalCastFilterType::Pointer castFilter = SignalCastFilterType::New();
+    castFilter->SetInput(volume);
+    castFilter->Update();
+    return castFilter->GetOutput();
+  }
+
+  VectorVolumeType::Pointer getConcentrationsOutput()
+  {
+    if (m_config.ResumeFromConcentrations) {
+      return m_resumedConcentrations;
+    }
+    if (m_config.SinglePass) {
+      return m_signalToQuantitativeImageFilter->GetConcentrationOutput();
+    }
+    return m_signalToConcentrationsConverter->GetOutput();
   }
 
   MaskVolumeType::Pointer getMaskVolumeOrNull(const std::string& maskFileName)
@@ -212,7 +754,7 @@ private:
     return maskVolume;
   }
 
-  MaskVolumeType::Pointer getResampledMaskVolumeOrNull(const std::string& maskFileName, const VectorVolumeType::Pointer referenceVolume)
+  MaskVolumeType::Pointer getResampledMaskVolumeOrNull(const std::string& maskFileName, const ReferenceVolumeType* referenceVolume)
   {
     MaskVolumeType::Pointer maskVolume = getMaskVolumeOrNull(maskFileName);
     if (maskVolume.IsNotNull()) {
@@ -233,40 +775,264 @@ private:
     return maskVolume;
   }
 
-  VectorVolumeType::Pointer getVectorVolume(const std::string& volumeFileName)
+  typename SignalVolumeType::Pointer getVectorVolume(const std::string& volumeFileName)
   {
-    VectorVolumeReaderType::Pointer multiVolumeReader = VectorVolumeReaderType::New();
+    if (itksys::SystemTools::FileIsDirectory(volumeFileName)) {
+      return getDICOMVectorVolume(volumeFileName);
+    }
+    typename SignalVolumeReaderType::Pointer multiVolumeReader = SignalVolumeReaderType::New();
     multiVolumeReader->SetFileName(volumeFileName.c_str());
+    if (m_config.MemoryMapInput) {
+      typename SignalVolumeType::Pointer mappedVolume = getMappedVectorVolume(multiVolumeReader, volumeFileName);
+      if (mappedVolume.IsNotNull()) {
+        return mappedVolume;
+      }
+    }
+    if (isFourDVolume(volumeFileName)) {
+      return getFourDVectorVolume(volumeFileName);
+    }
     multiVolumeReader->Update();
     return multiVolumeReader->GetOutput();
   }
 
+  //! Whether the file holds a scalar 4D volume, e.g. a NIfTI-4D series,
+  //! which ITK reads as its first frame into a vector volume
+  bool isFourDVolume(const std::string& volumeFileName) const
+  {
+    itk::ImageIOBase::Pointer imageIO =
+      itk::ImageIOFactory::CreateImageIO(volumeFileName.c_str(), itk::ImageIOFactory::ReadMode);
+    if (imageIO.IsNull()) {
+      return false;
+    }
+    imageIO->SetFileName(volumeFileName);
+    imageIO->ReadImageInformation();
+    return imageIO->GetNumberOfDimensions() == 4 && imageIO->GetNumberOfComponents() == 1;
+  }
+
+  //! Reads a scalar 4D volume with the frames of the fourth axis as the
+  //! components of the voxels. The frames are extracted one at a time, so
+  //! that only one frame is held next to the vector volume where the reader
+  //! can stream.
+  typename SignalVolumeType::Pointer getFourDVectorVolume(const std::string& volumeFileName)
+  {
+    typedef itk::Image<TSignalPixel, 4> FourDVolumeType;
+    typedef itk::Image<TSignalPixel, 3> FrameVolumeType;
+    typedef itk::ExtractImageFilter<FourDVolumeType, FrameVolumeType> FrameExtractorType;
+    typename itk::ImageFileReader<FourDVolumeType>::Pointer reader = itk::ImageFileReader<FourDVolumeType>::New();
+    reader->SetFileName(volumeFileName.c_str());
+    reader->UpdateOutputInformation();
+    const FourDVolumeType* fourDVolume = reader->GetOutput();
+    const typename FourDVolumeType::RegionType fourDRegion = fourDVolume->GetLargestPossibleRegion();
+
+    typename SignalVolumeType::RegionType region;
+    typename SignalVolumeType::SpacingType spacing;
+    typename SignalVolumeType::PointType origin;
+    typename SignalVolumeType::DirectionType direction;
+    for (unsigned int i = 0; i < 3; ++i) {
+      region.SetIndex(i, fourDRegion.GetIndex(i));
+      region.SetSize(i, fourDRegion.GetSize(i));
+      spacing[i] = fourDVolume->GetSpacing()[i];
+      origin[i] = fourDVolume->GetOrigin()[i];
+      for (unsigned int j = 0; j < 3; ++j) {
+        direction[i][j] = fourDVolume->GetDirection()[i][j];
+      }
+    }
+    const unsigned int numberOfFrames = fourDRegion.GetSize(3);
+    typename SignalVolumeType::Pointer volume = SignalVolumeType::New();
+    volume->SetRegions(region);
+    volume->SetSpacing(spacing);
+    volume->SetOrigin(origin);
+    volume->SetDirection(direction);
+    volume->SetNumberOfComponentsPerPixel(numberOfFrames);
+    volume->Allocate();
+    volume->SetMetaDataDictionary(fourDVolume->GetMetaDataDictionary());
+
+    // the frames are stored one after the other, the components interleaved
+    typename FrameExtractorType::Pointer extractor = FrameExtractorType::New();
+    extractor->SetInput(reader->GetOutput());
+    extractor->SetDirectionCollapseToSubmatrix();
+    typename FourDVolumeType::RegionType frameRegion = fourDRegion;
+    frameRegion.SetSize(3, 0);
+    const std::size_t numberOfVoxels = region.GetNumberOfPixels();
+    TSignalPixel* buffer = volume->GetBufferPointer();
+    for (unsigned int frame = 0; frame < numberOfFrames; ++frame) {
+      frameRegion.SetIndex(3, fourDRegion.GetIndex(3) + frame);
+      extractor->SetExtractionRegion(frameRegion);
+      extractor->Update();
+      const TSignalPixel* frameValues = extractor->GetOutput()->GetBufferPointer();
+      for (std::size_t voxel = 0; voxel < numberOfVoxels; ++voxel) {
+        buffer[voxel * numberOfFrames + frame] = frameValues[voxel];
+      }
+    }
+    return volume;
+  }
+
+  //! The acquisition parameters from the BIDS sidecar of a NIfTI input,
+  //! given or next to the input, otherwise from the MultiVolume meta data of
+  //! the input. The parameters of a sidecar are added to the meta data of the
+  //! input as MultiVolume meta data, which the outputs are written with.
+  std::unique_ptr<MultiVolumeMetaDataProvider> getMetaDataProvider()
+  {
+    itk::MetaDataDictionary& dictionary = m_inputVectorVolume->GetMetaDataDictionary();
+    std::string sidecarFileName = m_config.InputSidecarFileName;
+    if (sidecarFileName.empty() && !dictionary.HasKey("MultiVolume.FrameLabels")) {
+      const std::string candidate = BIDSSidecarReader::getSidecarFileName(m_config.InputFourDImageFileName);
+      if (!candidate.empty() && itksys::SystemTools::FileExists(candidate.c_str(), true)) {
+        sidecarFileName = candidate;
+      }
+    }
+    if (sidecarFileName.empty()) {
+      return std::unique_ptr<MultiVolumeMetaDataProvider>(new MultiVolumeMetaDictReader(dictionary));
+    }
+
+    std::unique_ptr<MultiVolumeMetaDataProvider> sidecar(
+      new BIDSSidecarReader(sidecarFileName, m_inputVectorVolume->GetNumberOfComponentsPerPixel()));
+    const std::vector<float> timing = sidecar->getTiming();
+    std::ostringstream frameLabels;
+    for (std::size_t i = 0; i < timing.size(); ++i) {
+      frameLabels << (i ? "," : "") << timing[i] * 1000.0;
+    }
+    std::ostringstream numberOfFrames, repetitionTime, flipAngle;
+    numberOfFrames << timing.size();
+    repetitionTime << sidecar->getRepetitionTime();
+    flipAngle << sidecar->getFlipAngle();
+    itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameIdentifyingDICOMTagName", "TriggerTime");
+    itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameIdentifyingDICOMTagUnits", "ms");
+    itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameLabels", frameLabels.str());
+    itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.NumberOfFrames", numberOfFrames.str());
+    itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.DICOM.RepetitionTime", repetitionTime.str());
+    itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.DICOM.FlipAngle", flipAngle.str());
+    return sidecar;
+  }
+
+  //! Reads a DICOM series directory, with the meta data of a MultiVolume
+  typename SignalVolumeType::Pointer getDICOMVectorVolume(const std::string& directory)
+  {
+    DICOMMultiVolumeReader reader(directory);
+    typename SignalVolumeType::Pointer volume = SignalVolumeType::New();
+    reader.copyInformation(volume);
+    volume->Allocate();
+    reader.read(volume);
+    return volume;
+  }
+
+  //! Reads the voxels of an uncompressed volume from a mapping of the file.
+  //! Voxels stored as interleaved floats are used in place, others are
+  //! converted slice by slice. The header and meta data are read by ITK.
+  //! Returns NULL if the file cannot be read this way.
+  typename SignalVolumeType::Pointer getMappedVectorVolume(SignalVolumeReaderType* multiVolumeReader, const std::string& volumeFileName)
+  {
+    RawVolumeLayout layout;
+    if (!readRawVolumeLayout(volumeFileName, layout)) {
+      return NULL;
+    }
+
+    multiVolumeReader->UpdateOutputInformation();
+    typename SignalVolumeType::Pointer volume = multiVolumeReader->GetOutput();
+    const typename SignalVolumeType::RegionType region = volume->GetLargestPossibleRegion();
+    if (!layout.interleaved && volume->GetNumberOfComponentsPerPixel() == 1) {
+      // a NIfTI-4D series, read by ITK as its first frame
+      volume->SetNumberOfComponentsPerPixel(layout.numberOfComponents);
+    }
+    const unsigned int numberOfComponents = volume->GetNumberOfComponentsPerPixel();
+    if (numberOfComponents != layout.numberOfComponents || region.GetNumberOfPixels() != layout.numberOfVoxels) {
+      return NULL;
+    }
+
+    std::unique_ptr<MappedFile> mapping;
+    try {
+      mapping.reset(new MappedFile(layout.dataFileName));
+    }
+    catch (const FileNotFoundException&) {
+      return NULL;
+    }
+    if (mapping->size() < layout.dataOffset + layout.dataSize()) {
+      // truncated, ITK reports it
+      return NULL;
+    }
+
+    volume->DisconnectPipeline();
+    volume->SetBufferedRegion(region);
+    char* data = mapping->data() + layout.dataOffset;
+    if (layout.componentType == RawVolumeComponentType<TSignalPixel>::value && layout.interleaved &&
+        reinterpret_cast<std::size_t>(data) % sizeof(TSignalPixel) == 0) {
+      volume->GetPixelContainer()->SetImportPointer(reinterpret_cast<TSignalPixel*>(data),
+                                                    layout.numberOfVoxels * numberOfComponents, false);
+      m_inputMapping.reset(mapping.release());
+    }
+    else {
+      volume->Allocate();
+      TSignalPixel* buffer = volume->GetBufferPointer();
+      const std::size_t sliceSize = region.GetSize(0) * region.GetSize(1);
+      for (std::size_t first = 0; first < layout.numberOfVoxels; first += sliceSize) {
+        convertRawVoxels(layout, data, first, std::min(sliceSize, layout.numberOfVoxels - first),
+                         buffer + first * numberOfComponents);
+      }
+    }
+    return volume;
+  }
+
   std::unique_ptr<BolusArrivalTime::BolusArrivalTimeEstimator> getBatEstimator()
   {
     std::unique_ptr<BolusArrivalTime::BolusArrivalTimeEstimator> batEstimator(new BolusArrivalTime::BolusArrivalTimeEstimatorConstant(m_config.ConstantBAT));
     if (m_config.BATCalculationMode == "PeakGradient") {
       batEstimator.reset(new BolusArrivalTime::BolusArrivalTimeEstimatorPeakGradient());
     }
+    else if (m_config.BATCalculationMode == "PiecewiseLinear") {
+      batEstimator.reset(new BolusArrivalTime::BolusArrivalTimeEstimatorPiecewiseLinear());
+    }
     return batEstimator;
   }
 
+  std::unique_ptr<AsyncVolumeWriter> getOutputWriter()
+  {
+    AsyncVolumeWriter::Compression compression = AsyncVolumeWriter::DefaultCompression;
+    if (m_config.OutputCompression == "None") {
+      compression = AsyncVolumeWriter::NoCompression;
+    }
+    else if (m_config.OutputCompression == "Fast") {
+      compression = AsyncVolumeWriter::FastCompression;
+    }
+    else if (m_config.OutputCompression == "Best") {
+      compression = AsyncVolumeWriter::BestCompression;
+    }
+    return std::unique_ptr<AsyncVolumeWriter>(new AsyncVolumeWriter(
+      itk::MultiThreader::GetGlobalDefaultNumberOfThreads(), compression, m_config.OutputCompressor));
+  }
+
   template <typename TOutVolume>
   void writeVolumeIfFileNameValid(std::string fileName, const TOutVolume* outVolume)
   {
-    try
-    {
-      typename itk::ImageFileWriter<TOutVolume>::Pointer volumeWriter = itk::ImageFileWriter<TOutVolume>::New();
-      volumeWriter->SetFileName(fileName.c_str());
-      volumeWriter->SetInput(outVolume);
-      volumeWriter->SetUseCompression(1);
-      volumeWriter->Update();
+    m_outputWriter->write(fileName, outVolume);
+  }
+
+  //! The concentrations with the meta data of the input and the parameters
+  //! they were converted with, which a resumed input already has
+  void writeConcentrationsIfFileNameValid()
+  {
+    const std::string& fileName = m_config.OutputConcentrationsImageFileName;
+    if (fileName.empty() || m_outputMappings.count(fileName)) {
+      return;
     }
-    catch (...)
-    { }
+    VectorVolumeType::Pointer concentrations = getConcentrationsOutput();
+    itk::MetaDataDictionary dictionary = m_inputVectorVolume->GetMetaDataDictionary();
+    if (!m_config.ResumeFromConcentrations) {
+      const std::map<std::string, std::string> metaData = getConversionMetaData();
+      std::map<std::string, std::string>::const_iterator it;
+      for (it = metaData.begin(); it != metaData.end(); ++it) {
+        itk::EncapsulateMetaData<std::string>(dictionary, it->first, it->second);
+      }
+    }
+    concentrations->SetMetaDataDictionary(dictionary);
+    writeVolumeIfFileNameValid(fileName, concentrations.GetPointer());
   }
 
-  void writeMultiVolumeIfFileNameValid(std::string fileName, const VectorVolumeType::Pointer outVolume, const VectorVolumeType::Pointer referenceVolume)
+  void writeMultiVolumeIfFileNameValid(std::string fileName, const VectorVolumeType::Pointer outVolume, const ReferenceVolumeType* referenceVolume)
   {
+    // already in its file, flushed with the other mapped outputs
+    if (m_outputMappings.count(fileName)) {
+      return;
+    }
     // this line is needed to make Slicer recognize this as a VectorVolume and not a MultiVolume
     outVolume->SetMetaDataDictionary(referenceVolume->GetMetaDataDictionary());
     writeVolumeIfFileNameValid(fileName, outVolume.GetPointer());
@@ -1,7 +1,22 @@
 #include "itkTestMain.h"
+#include "itkVectorImage.h"
+#include "itkGDCMImageIO.h"
+#include "itkMetaDataObject.h"
+#include "itksys/SystemTools.hxx"
+#include "itk_hdf5.h"
+#include "AIF/ParkerAIFModel.h"
+#include "BAT/BolusArrivalTimeEstimatorPiecewiseLinear.h"
+#include "PkSolver.h"
+#include "Exceptions.h"
 
 // STD includes
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #if defined(_WIN32) && !defined(MODULE_STATIC)
 #define MODULE_IMPORT __declspec(dllimport)
@@ -29,9 +44,593 @@ int DoNothingAndPass(int argc, char * argv[])
   return 0;
 }
 
+//! Writes a vector volume as a scalar 4D volume with the components along
+//! the fourth axis, e.g. a NRRD MultiVolume as a NIfTI-4D series
+int WriteFourDVolume(int argc, char * argv[])
+{
+  if (argc < 3) {
+    std::cerr << "Usage: WriteFourDVolume inputVectorVolume outputFourDVolume" << std::endl;
+    return 1;
+  }
+  typedef itk::VectorImage<double, 3> VectorVolumeType;
+  typedef itk::Image<double, 4> FourDVolumeType;
+  itk::ImageFileReader<VectorVolumeType>::Pointer reader = itk::ImageFileReader<VectorVolumeType>::New();
+  reader->SetFileName(argv[1]);
+  reader->Update();
+  const VectorVolumeType* vectorVolume = reader->GetOutput();
+  const VectorVolumeType::RegionType vectorRegion = vectorVolume->GetLargestPossibleRegion();
+  const unsigned int numberOfFrames = vectorVolume->GetNumberOfComponentsPerPixel();
+
+  FourDVolumeType::RegionType region;
+  FourDVolumeType::SpacingType spacing;
+  FourDVolumeType::PointType origin;
+  FourDVolumeType::DirectionType direction;
+  direction.SetIdentity();
+  for (unsigned int i = 0; i < 3; ++i) {
+    region.SetSize(i, vectorRegion.GetSize(i));
+    spacing[i] = vectorVolume->GetSpacing()[i];
+    origin[i] = vectorVolume->GetOrigin()[i];
+    for (unsigned int j = 0; j < 3; ++j) {
+      direction[i][j] = vectorVolume->GetDirection()[i][j];
+    }
+  }
+  region.SetSize(3, numberOfFrames);
+  spacing[3] = 1.0;
+  origin[3] = 0.0;
+  FourDVolumeType::Pointer fourDVolume = FourDVolumeType::New();
+  fourDVolume->SetRegions(region);
+  fourDVolume->SetSpacing(spacing);
+  fourDVolume->SetOrigin(origin);
+  fourDVolume->SetDirection(direction);
+  fourDVolume->Allocate();
+
+  const std::size_t numberOfVoxels = vectorRegion.GetNumberOfPixels();
+  const double* voxels = vectorVolume->GetBufferPointer();
+  double* frames = fourDVolume->GetBufferPointer();
+  for (std::size_t voxel = 0; voxel < numberOfVoxels; ++voxel) {
+    for (unsigned int frame = 0; frame < numberOfFrames; ++frame) {
+      frames[frame * numberOfVoxels + voxel] = voxels[voxel * numberOfFrames + frame];
+    }
+  }
+
+  itk::ImageFileWriter<FourDVolumeType>::Pointer writer = itk::ImageFileWriter<FourDVolumeType>::New();
+  writer->SetFileName(argv[2]);
+  writer->SetInput(fourDVolume);
+  writer->Write();
+  return 0;
+}
+
+//! Writes a MultiVolume as a DICOM series into a directory, one MR file per
+//! slice and frame, with the trigger time, repetition time, flip angle and
+//! echo time of its meta data. Each file has its own rescale slope and
+//! intercept, the slices are stored as integers.
+int WriteDICOMSeries(int argc, char * argv[])
+{
+  if (argc < 3) {
+    std::cerr << "Usage: WriteDICOMSeries inputVectorVolume outputDirectory" << std::endl;
+    return 1;
+  }
+  typedef itk::VectorImage<double, 3> VectorVolumeType;
+  typedef itk::Image<float, 3> SliceType;
+  itk::ImageFileReader<VectorVolumeType>::Pointer reader = itk::ImageFileReader<VectorVolumeType>::New();
+  reader->SetFileName(argv[1]);
+  reader->Update();
+  const VectorVolumeType* vectorVolume = reader->GetOutput();
+  const VectorVolumeType::SizeType size = vectorVolume->GetLargestPossibleRegion().GetSize();
+  const unsigned int numberOfFrames = vectorVolume->GetNumberOfComponentsPerPixel();
+  const itk::MetaDataDictionary& dictionary = vectorVolume->GetMetaDataDictionary();
+
+  std::string frameLabels, repetitionTime, flipAngle, echoTime;
+  if (!itk::ExposeMetaData<std::string>(dictionary, "MultiVolume.FrameLabels", frameLabels) ||
+      !itk::ExposeMetaData<std::string>(dictionary, "MultiVolume.DICOM.RepetitionTime", repetitionTime) ||
+      !itk::ExposeMetaData<std::string>(dictionary, "MultiVolume.DICOM.FlipAngle", flipAngle)) {
+    std::cerr << argv[1] << " has no MultiVolume frame labels, repetition time or flip angle" << std::endl;
+    return 1;
+  }
+  itk::ExposeMetaData<std::string>(dictionary, "MultiVolume.DICOM.EchoTime", echoTime);
+  std::vector<std::string> triggerTimes;
+  std::istringstream labelStream(frameLabels);
+  std::string label;
+  while (std::getline(labelStream, label, ',')) {
+    triggerTimes.push_back(label);
+  }
+  if (triggerTimes.size() != numberOfFrames) {
+    std::cerr << "The frame labels of " << argv[1] << " do not match its " << numberOfFrames << " frames" << std::endl;
+    return 1;
+  }
+
+  itksys::SystemTools::MakeDirectory(argv[2]);
+  // Fixed UIDs under the UUID derived root, so the series is the same on every run
+  const std::string uidRoot = "2.25.329800735698586629295641978511506172918";
+  const std::size_t sliceSize = size[0] * size[1];
+  const double* voxels = vectorVolume->GetBufferPointer();
+  unsigned int instance = 0;
+  for (unsigned int frame = 0; frame < numberOfFrames; ++frame) {
+    for (unsigned int z = 0; z < size[2]; ++z) {
+      SliceType::RegionType region;
+      region.SetSize(0, size[0]);
+      region.SetSize(1, size[1]);
+      region.SetSize(2, 1);
+      SliceType::PointType origin;
+      for (unsigned int i = 0; i < 3; ++i) {
+        origin[i] = vectorVolume->GetOrigin()[i] + z * vectorVolume->GetSpacing()[2] * vectorVolume->GetDirection()[i][2];
+      }
+      SliceType::Pointer slice = SliceType::New();
+      slice->SetRegions(region);
+      slice->SetSpacing(vectorVolume->GetSpacing());
+      slice->SetOrigin(origin);
+      slice->SetDirection(vectorVolume->GetDirection());
+      slice->Allocate();
+      float* pixels = slice->GetBufferPointer();
+      double minimum = voxels[z * sliceSize * numberOfFrames + frame];
+      double maximum = minimum;
+      for (std::size_t i = 0; i < sliceSize; ++i) {
+        const double value = voxels[(z * sliceSize + i) * numberOfFrames + frame];
+        pixels[i] = static_cast<float>(value);
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+      }
+
+      // Stored as integers from 0 to 60000 over the range of the slice
+      std::ostringstream intercept, slope, sopInstanceUID, instanceNumber;
+      intercept.precision(12);
+      slope.precision(12);
+      intercept << minimum;
+      slope << (maximum > minimum ? (maximum - minimum) / 60000.0 : 1.0);
+      sopInstanceUID << uidRoot << ".3." << ++instance;
+      instanceNumber << instance;
+
+      itk::MetaDataDictionary& sliceDictionary = slice->GetMetaDataDictionary();
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0008|0016", "1.2.840.10008.5.1.4.1.1.4");
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0008|0018", sopInstanceUID.str());
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0008|0060", "MR");
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0020|000d", uidRoot + ".1");
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0020|000e", uidRoot + ".2");
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0020|0013", instanceNumber.str());
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0018|1060", triggerTimes[frame]);
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0018|0080", repetitionTime);
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0018|1314", flipAngle);
+      if (!echoTime.empty()) {
+        itk::EncapsulateMetaData<std::string>(sliceDictionary, "0018|0081", echoTime);
+      }
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0028|1052", intercept.str());
+      itk::EncapsulateMetaData<std::string>(sliceDictionary, "0028|1053", slope.str());
+
+      itk::GDCMImageIO::Pointer imageIO = itk::GDCMImageIO::New();
+      imageIO->KeepOriginalUIDOn();
+      std::ostringstream fileName;
+      fileName << argv[2] << "/IM" << instanceNumber.str() << ".dcm";
+      itk::ImageFileWriter<SliceType>::Pointer writer = itk::ImageFileWriter<SliceType>::New();
+      writer->SetFileName(fileName.str());
+      writer->SetInput(slice);
+      writer->SetImageIO(imageIO);
+      writer->Write();
+    }
+  }
+  return 0;
+}
+
+//! Writes components of a --outputParameterMaps volume, by name, as scalar
+//! volumes to compare them with the single maps
+int ExtractParameterMaps(int argc, char * argv[])
+{
+  if (argc < 4 || argc % 2 != 0) {
+    std::cerr << "Usage: ExtractParameterMaps parameterMaps componentName outputVolume [componentName outputVolume ...]" << std::endl;
+    return 1;
+  }
+  typedef itk::VectorImage<float, 3> ParameterMapsType;
+  typedef itk::Image<float, 3> MapVolumeType;
+  itk::ImageFileReader<ParameterMapsType>::Pointer reader = itk::ImageFileReader<ParameterMapsType>::New();
+  reader->SetFileName(argv[1]);
+  reader->Update();
+  const ParameterMapsType* parameterMaps = reader->GetOutput();
+  const unsigned int numberOfComponents = parameterMaps->GetNumberOfComponentsPerPixel();
+  const std::size_t numberOfVoxels = parameterMaps->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  std::string labels;
+  if (!itk::ExposeMetaData<std::string>(parameterMaps->GetMetaDataDictionary(), "ParameterMaps.ComponentLabels", labels)) {
+    std::cerr << "No ParameterMaps.ComponentLabels in " << argv[1] << std::endl;
+    return 1;
+  }
+
+  for (int arg = 2; arg < argc; arg += 2) {
+    std::istringstream labelStream(labels);
+    std::string label;
+    unsigned int component = 0;
+    while (std::getline(labelStream, label, ',') && label != argv[arg]) {
+      ++component;
+    }
+    if (label != argv[arg] || component >= numberOfComponents) {
+      std::cerr << "No component " << argv[arg] << " in " << labels << std::endl;
+      return 1;
+    }
+
+    MapVolumeType::Pointer map = MapVolumeType::New();
+    map->CopyInformation(parameterMaps);
+    map->SetRegions(parameterMaps->GetLargestPossibleRegion());
+    map->Allocate();
+    const float* records = parameterMaps->GetBufferPointer();
+    float* voxels = map->GetBufferPointer();
+    for (std::size_t voxel = 0; voxel < numberOfVoxels; ++voxel) {
+      voxels[voxel] = records[voxel * numberOfComponents + component];
+    }
+
+    itk::ImageFileWriter<MapVolumeType>::Pointer writer = itk::ImageFileWriter<MapVolumeType>::New();
+    writer->SetFileName(argv[arg + 1]);
+    writer->SetInput(map);
+    writer->Write();
+  }
+  return 0;
+}
+
+//! Reads the root attribute name of an HDF5 file into values
+static bool ReadHDF5Attribute(hid_t file, const char* name, double* values)
+{
+  const hid_t attribute = H5Aopen(file, name, H5P_DEFAULT);
+  if (attribute < 0) {
+    return false;
+  }
+  const herr_t status = H5Aread(attribute, H5T_NATIVE_DOUBLE, values);
+  H5Aclose(attribute);
+  return status >= 0;
+}
+
+//! Passes if the datasets of a --outputHDF5 file have the curves of the
+//! reference volumes, and the file has their geometry. The arguments after
+//! the file are pairs of dataset name and reference volume.
+int HDF5CurvesMatch(int argc, char * argv[])
+{
+  if (argc < 4 || argc % 2 != 0) {
+    std::cerr << "Usage: HDF5CurvesMatch file.h5 datasetName referenceVolume [datasetName referenceVolume ...]" << std::endl;
+    return 1;
+  }
+  const double tolerance = 1e-4;
+  typedef itk::VectorImage<double, 3> VectorVolumeType;
+
+  const hid_t file = H5Fopen(argv[1], H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file < 0) {
+    std::cerr << "Cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+  int failures = 0;
+  for (int arg = 2; arg < argc; arg += 2) {
+    itk::ImageFileReader<VectorVolumeType>::Pointer reader = itk::ImageFileReader<VectorVolumeType>::New();
+    reader->SetFileName(argv[arg + 1]);
+    reader->Update();
+    const VectorVolumeType* reference = reader->GetOutput();
+    const VectorVolumeType::SizeType size = reference->GetLargestPossibleRegion().GetSize();
+    const unsigned int numberOfComponents = reference->GetNumberOfComponentsPerPixel();
+
+    if (arg == 2) {
+      // The geometry is the one of the input, as for every reference volume
+      double spacing[3], origin[3];
+      if (!ReadHDF5Attribute(file, "spacing", spacing) || !ReadHDF5Attribute(file, "origin", origin)) {
+        std::cerr << "No spacing or origin in " << argv[1] << std::endl;
+        ++failures;
+      }
+      else {
+        for (unsigned int i = 0; i < 3; ++i) {
+          if (std::fabs(spacing[i] - reference->GetSpacing()[i]) > tolerance ||
+              std::fabs(origin[i] - reference->GetOrigin()[i]) > tolerance) {
+            std::cerr << "The geometry differs along axis " << i << std::endl;
+            ++failures;
+          }
+        }
+      }
+    }
+
+    const hid_t dataset = H5Dopen2(file, argv[arg], H5P_DEFAULT);
+    if (dataset < 0) {
+      std::cerr << "No dataset " << argv[arg] << " in " << argv[1] << std::endl;
+      ++failures;
+      continue;
+    }
+    const hid_t space = H5Dget_space(dataset);
+    hsize_t dimensions[4] = { 0, 0, 0, 0 };
+    const bool sameSize = H5Sget_simple_extent_ndims(space) == 4 &&
+                          H5Sget_simple_extent_dims(space, dimensions, NULL) == 4 &&
+                          dimensions[0] == size[2] && dimensions[1] == size[1] && dimensions[2] == size[0] &&
+                          dimensions[3] == numberOfComponents;
+    H5Sclose(space);
+    if (!sameSize) {
+      std::cerr << "Dataset " << argv[arg] << " is not " << size[2] << " x " << size[1] << " x " << size[0]
+                << " x " << numberOfComponents << std::endl;
+      H5Dclose(dataset);
+      ++failures;
+      continue;
+    }
+
+    // z x y x x x time is the buffer order of the vector volume
+    const std::size_t numberOfValues = reference->GetLargestPossibleRegion().GetNumberOfPixels() * numberOfComponents;
+    std::vector<double> values(numberOfValues);
+    const herr_t status = H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0]);
+    H5Dclose(dataset);
+    if (status < 0) {
+      std::cerr << "Reading dataset " << argv[arg] << " failed" << std::endl;
+      ++failures;
+      continue;
+    }
+    const double* referenceValues = reference->GetBufferPointer();
+    std::size_t differences = 0;
+    for (std::size_t i = 0; i < numberOfValues; ++i) {
+      if (std::fabs(values[i] - referenceValues[i]) > tolerance) {
+        ++differences;
+      }
+    }
+    std::cout << differences << " of the " << numberOfValues << " values of " << argv[arg] << " differ from "
+              << argv[arg + 1] << std::endl;
+    if (differences) {
+      ++failures;
+    }
+  }
+  H5Fclose(file);
+  return failures == 0 ? 0 : 1;
+}
+
+//! Passes if the two masks have at least one non-zero voxel in common
+int MasksOverlap(int argc, char * argv[])
+{
+  if (argc < 3) {
+    std::cerr << "Usage: MasksOverlap mask referenceMask" << std::endl;
+    return 1;
+  }
+  typedef itk::Image<unsigned short, 3> MaskVolumeType;
+  itk::ImageFileReader<MaskVolumeType>::Pointer maskReader = itk::ImageFileReader<MaskVolumeType>::New();
+  maskReader->SetFileName(argv[1]);
+  maskReader->Update();
+  itk::ImageFileReader<MaskVolumeType>::Pointer referenceReader = itk::ImageFileReader<MaskVolumeType>::New();
+  referenceReader->SetFileName(argv[2]);
+  referenceReader->Update();
+  const MaskVolumeType* mask = maskReader->GetOutput();
+  const MaskVolumeType* reference = referenceReader->GetOutput();
+  if (mask->GetLargestPossibleRegion() != reference->GetLargestPossibleRegion()) {
+    std::cerr << "The masks differ in size" << std::endl;
+    return 1;
+  }
+
+  itk::ImageRegionConstIterator<MaskVolumeType> maskIter(mask, mask->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<MaskVolumeType> referenceIter(reference, reference->GetLargestPossibleRegion());
+  unsigned long maskVoxels = 0, overlapVoxels = 0;
+  for (; !maskIter.IsAtEnd(); ++maskIter, ++referenceIter) {
+    if (maskIter.Get()) {
+      ++maskVoxels;
+      if (referenceIter.Get()) {
+        ++overlapVoxels;
+      }
+    }
+  }
+  std::cout << overlapVoxels << " of the " << maskVoxels << " mask voxels are in the reference mask" << std::endl;
+  return overlapVoxels > 0 ? 0 : 1;
+}
+
+//! Fits every breakpoint of the piecewise linear BAT model directly and
+//! returns the best one, -1 if there is no rise. Reference for the prefix
+//! sum search of BolusArrivalTimeEstimatorPiecewiseLinear.
+static int BruteForcePiecewiseLinearBAT(int signalSize, const float* signal, double& slope)
+{
+  const int n = static_cast<int>(std::max_element(signal, signal + signalSize) - signal) + 1;
+  double bestError = 0.0;
+  int bestBreakpoint = -1;
+  for (int b = 1; b <= n - 3; ++b) {
+    double meanX = 0.0, meanY = 0.0;
+    for (int i = 0; i < n; ++i) {
+      meanX += std::max(0, i - b);
+      meanY += signal[i];
+    }
+    meanX /= n;
+    meanY /= n;
+    double SSxx = 0.0, SSxy = 0.0;
+    for (int i = 0; i < n; ++i) {
+      SSxx += (std::max(0, i - b) - meanX) * (std::max(0, i - b) - meanX);
+      SSxy += (std::max(0, i - b) - meanX) * (signal[i] - meanY);
+    }
+    if (SSxx <= 0.0 || SSxy <= 0.0) {
+      continue;
+    }
+    const double s = SSxy / SSxx;
+    const double c = meanY - s * meanX;
+    double error = 0.0;
+    for (int i = 0; i < n; ++i) {
+      const double r = signal[i] - c - s * std::max(0, i - b);
+      error += r * r;
+    }
+    if (bestBreakpoint < 0 || error < bestError) {
+      bestError = error;
+      bestBreakpoint = b;
+      slope = s;
+    }
+  }
+  return bestBreakpoint;
+}
+
+//! Passes if the piecewise linear BAT estimator finds the same breakpoints
+//! and slopes as a brute-force fit, on noisy synthetic curves
+int PiecewiseLinearBATMatchesBruteForce(int argc, char * argv[])
+{
+  const int signalSize = 60;
+  const int numberOfCurves = 500;
+  BolusArrivalTime::BolusArrivalTimeEstimatorPiecewiseLinear estimator;
+  std::vector<float> signal(signalSize);
+  // Fixed linear congruential generator, so that every run tests the same curves
+  unsigned int seed = 12345;
+  int failures = 0;
+  for (int curve = 0; curve < numberOfCurves; ++curve) {
+    seed = seed * 1103515245u + 12345u;
+    const int bat = 1 + static_cast<int>((seed >> 8) % (signalSize / 2));
+    seed = seed * 1103515245u + 12345u;
+    const double riseSlope = 0.01 + ((seed >> 8) % 1000) / 2000.0;
+    seed = seed * 1103515245u + 12345u;
+    const int riseLength = 2 + static_cast<int>((seed >> 8) % 10);
+    // Increasing noise, the last curves are hardly more than noise
+    const double noise = 0.5 * curve / numberOfCurves;
+    for (int i = 0; i < signalSize; ++i) {
+      seed = seed * 1103515245u + 12345u;
+      const double uniform = ((seed >> 8) & 0xffff) / 65535.0 - 0.5;
+      double value = 0.0;
+      if (i > bat) {
+        value = riseSlope * std::min(i - bat, riseLength) * std::exp(-0.02 * std::max(0, i - bat - riseLength));
+      }
+      signal[i] = static_cast<float>(value + noise * uniform);
+    }
+
+    double expectedSlope = 0.0;
+    const int expected = BruteForcePiecewiseLinearBAT(signalSize, &signal[0], expectedSlope);
+    int found = -1;
+    float slope = 0.0f;
+    try {
+      found = estimator.getBATIndex(signalSize, &signal[0], &slope);
+    }
+    catch (BATDetectionFailedException&) {
+      found = -1;
+    }
+    if (found != expected
+        || (found >= 0 && std::fabs(slope - expectedSlope) > 1e-4 * std::max(1.0, std::fabs(expectedSlope)))) {
+      std::cerr << "Curve " << curve << ": BAT " << found << " with slope " << slope
+                << ", brute force " << expected << " with slope " << expectedSlope << std::endl;
+      ++failures;
+    }
+  }
+  std::cout << failures << " of the " << numberOfCurves << " curves differ from the brute-force fit" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
+
+//! Int_0^t Cp(u) exp(-k (t-u)) du by 5 point Gauss-Legendre quadrature on
+//! fine panels, in the time since the arrival. The exponential only matters
+//! within a few 1/k of t for large k.
+static double QuadratureOfParkerConvolution(const ParkerAIFModel::Parameters& parameters, double k, double t)
+{
+  const double nodes[5] = { -0.9061798459386640, -0.5384693101056831, 0.0,
+                            0.5384693101056831, 0.9061798459386640 };
+  const double weights[5] = { 0.2369268850561891, 0.4786286704993665, 0.5688888888888889,
+                              0.4786286704993665, 0.2369268850561891 };
+  const double duration = std::min(t - parameters.arrival, 60.0 / k);
+  if (!(duration > 0.0)) {
+    return 0.0;
+  }
+  const int panels = 20000;
+  const double h = duration / panels;
+  double sum = 0.0;
+  for (int p = 0; p < panels; ++p) {
+    for (int q = 0; q < 5; ++q) {
+      // v = t - u, the time before t
+      const double v = h * (p + 0.5 + 0.5 * nodes[q]);
+      sum += weights[q] * ParkerAIFModel::evaluate(parameters, t - v) * std::exp(-k * v);
+    }
+  }
+  return 0.5 * h * sum;
+}
+
+//! Passes if the closed form convolution of ParkerAIFModel matches a fine
+//! numerical quadrature. The rates cover the series and the recurrence of the
+//! panel weights, the erfcx expansion of the Gaussian terms, and k = inf.
+int ParkerAIFConvolutionMatchesQuadrature(int argc, char * argv[])
+{
+  // 36 frames 5 s apart, the bolus arrives between two of them
+  std::vector<float> timeMinute(36);
+  for (std::size_t i = 0; i < timeMinute.size(); ++i) {
+    timeMinute[i] = static_cast<float>(i * 5.0 / 60.0);
+  }
+  const ParkerAIFModel::Parameters parameters = ParkerAIFModel::populationParameters(0.3);
+  const ParkerAIFModel model(parameters, timeMinute);
+
+  const double rates[] = { 0.0, 0.01, 1.0, 30.0, 300.0, 1000.0, 1e5 };
+  const std::size_t numberOfRates = sizeof(rates) / sizeof(rates[0]);
+  const double tolerance = 1e-6;
+  std::vector<double> convolved(timeMinute.size());
+  int failures = 0;
+  for (std::size_t r = 0; r < numberOfRates; ++r) {
+    const double k = rates[r];
+    model.convolveExponential(k, &convolved[0]);
+    double maximumError = 0.0;
+    for (std::size_t i = 0; i < timeMinute.size(); ++i) {
+      const double expected = QuadratureOfParkerConvolution(parameters, k, timeMinute[i]);
+      const double error = std::fabs(convolved[i] - expected);
+      if (expected == 0.0 ? error > 0.0 : error > tolerance * std::fabs(expected)) {
+        std::cerr << "k " << k << ", t " << timeMinute[i] << ": " << convolved[i]
+                  << ", quadrature " << expected << std::endl;
+        ++failures;
+      }
+      if (expected != 0.0) {
+        maximumError = std::max(maximumError, error / std::fabs(expected));
+      }
+    }
+    std::cout << "k " << k << ": relative error " << maximumError << std::endl;
+  }
+
+  model.convolveExponential(std::numeric_limits<double>::infinity(), &convolved[0]);
+  for (std::size_t i = 0; i < timeMinute.size(); ++i) {
+    if (convolved[i] != 0.0) {
+      std::cerr << "k inf, t " << timeMinute[i] << ": " << convolved[i] << std::endl;
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+//! Passes if compute_curve_shape finds the time to peak, peak enhancement
+//! and wash-out slope of a synthetic curve with a linear rise and wash-out
+int CurveShapeMatchesSyntheticCurve(int argc, char * argv[])
+{
+  // 40 frames 5 s apart, the bolus arrives at frame 6 and peaks at frame 14
+  const int signalSize = 40;
+  const int bat = 6;
+  const int peak = 14;
+  const float peakValue = 2.0f;
+  const float washoutSlope = -0.01f;
+  std::vector<float> timing(signalSize);
+  std::vector<float> curve(signalSize);
+  for (int i = 0; i < signalSize; ++i) {
+    timing[i] = 5.0f * i;
+    if (i <= bat) {
+      curve[i] = 0.0f;
+    }
+    else if (i <= peak) {
+      curve[i] = peakValue * (i - bat) / (peak - bat);
+    }
+    else {
+      curve[i] = peakValue + washoutSlope * (timing[i] - timing[peak]);
+    }
+  }
+  // A spike before the bolus arrival must not count as the peak
+  curve[bat - 2] = 3.0f * peakValue;
+
+  int failures = 0;
+  float timeToPeak = -1.0f, peakEnhancement = -1.0f, slope = -1.0f;
+  itk::compute_curve_shape(signalSize, &timing[0], &curve[0], bat, timeToPeak, peakEnhancement, slope);
+  if (std::fabs(timeToPeak - (timing[peak] - timing[bat])) > 1e-4
+      || std::fabs(peakEnhancement - peakValue) > 1e-6
+      || std::fabs(slope - washoutSlope) > 1e-6) {
+    std::cerr << "Time to peak " << timeToPeak << ", peak " << peakEnhancement << ", wash-out slope " << slope
+              << ", expected " << timing[peak] - timing[bat] << ", " << peakValue << ", " << washoutSlope << std::endl;
+    ++failures;
+  }
+
+  // Still rising at the end, there is no wash-out
+  for (int i = peak + 1; i < signalSize; ++i) {
+    curve[i] = peakValue + 0.01f * (i - peak);
+  }
+  itk::compute_curve_shape(signalSize, &timing[0], &curve[0], bat, timeToPeak, peakEnhancement, slope);
+  if (std::fabs(timeToPeak - (timing[signalSize - 1] - timing[bat])) > 1e-4
+      || std::fabs(peakEnhancement - curve[signalSize - 1]) > 1e-6
+      || slope != 0.0f) {
+    std::cerr << "Rising curve: time to peak " << timeToPeak << ", peak " << peakEnhancement
+              << ", wash-out slope " << slope << std::endl;
+    ++failures;
+  }
+  return failures == 0 ? 0 : 1;
+}
+
 void RegisterTests()
 {
   StringToTestFunctionMap["ModuleEntryPoint"] = ModuleEntryPoint;
   StringToTestFunctionMap["ModuleEntryPointExpectFail"] = ModuleEntryPointExpectFail;
   StringToTestFunctionMap["DoNothingAndPass"] = DoNothingAndPass;
+  StringToTestFunctionMap["WriteFourDVolume"] = WriteFourDVolume;
+  StringToTestFunctionMap["WriteDICOMSeries"] = WriteDICOMSeries;
+  StringToTestFunctionMap["MasksOverlap"] = MasksOverlap;
+  StringToTestFunctionMap["ExtractParameterMaps"] = ExtractParameterMaps;
+  StringToTestFunctionMap["HDF5CurvesMatch"] = HDF5CurvesMatch;
+  StringToTestFunctionMap["PiecewiseLinearBATMatchesBruteForce"] = PiecewiseLinearBATMatchesBruteForce;
+  StringToTestFunctionMap["ParkerAIFConvolutionMatchesQuadrature"] = ParkerAIFConvolutionMatchesQuadrature;
+  StringToTestFunctionMap["CurveShapeMatchesSyntheticCurve"] = CurveShapeMatchesSyntheticCurve;
 }
@@ -117,6 +117,520 @@ add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
 set_property(TEST ${testName} PROPERTY LABELS ${CLP})
 
 
+#-----------------------------------------------------------------------------
+# Several AUC intervals, the map of the default interval must match the AUC
+# of the single interval run
+set(testName QINProstate001_AUCTimeIntervals)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-auc.nrrd
+            ${tempOutDataBaseName}-auc-90s.nrrd
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --aucTimeIntervals 60,90,180
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputAUC ${tempOutDataBaseName}-auc.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# All maps in one multi-component volume, the components must match the
+# single maps of the reference
+set(testName QINProstate001_ParameterMaps)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputParameterMaps ${tempOutDataBaseName}-maps.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Components COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-Ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-Ve.nrrd
+  --compare ${referenceDataBaseName}-maxslope.nrrd
+            ${tempOutDataBaseName}-MaxSlope.nrrd
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}-BAT.nrrd
+  ExtractParameterMaps
+    ${tempOutDataBaseName}-maps.nrrd
+    Ktrans ${tempOutDataBaseName}-Ktrans.nrrd
+    Ve ${tempOutDataBaseName}-Ve.nrrd
+    MaxSlope ${tempOutDataBaseName}-MaxSlope.nrrd
+    BAT ${tempOutDataBaseName}-BAT.nrrd
+)
+set_property(TEST ${testName}Components PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Components PROPERTY DEPENDS ${testName})
+
+#-----------------------------------------------------------------------------
+# Without the model fit the BAT and max slope must not change
+set(testName QINProstate001_SemiQuantitativeOnly)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}-bat.nrrd
+  --compare ${referenceDataBaseName}-maxslope.nrrd
+            ${tempOutDataBaseName}-maxslope.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --semiQuantitativeOnly
+    --outputBAT ${tempOutDataBaseName}-bat.nrrd
+    --outputMaxSlope ${tempOutDataBaseName}-maxslope.nrrd
+    --outputTimeToPeak ${tempOutDataBaseName}-ttp.nrrd
+    --outputPeakEnhancement ${tempOutDataBaseName}-peak.nrrd
+    --outputWashoutSlope ${tempOutDataBaseName}-washout.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# No AIF shifts is the default, whole frame shifts of the voxels
+set(testName QINProstate001_AIFShiftsPerFrame0)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    ${outputParamsArgs}
+    --aifShiftsPerFrame 0
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# With a bank of delayed AIFs the model is fitted to the unshifted voxels,
+# the concentrations and max slope must not change. The BAT map is the
+# fractional BAT then, from which the fitted curves are regenerated.
+set(testName QINProstate001_AIFShiftsPerFrame1)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-conc.nrrd
+            ${tempOutDataBaseName}-conc.nrrd
+  --compare ${referenceDataBaseName}-maxslope.nrrd
+            ${tempOutDataBaseName}-maxslope.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    ${outputParamsArgs}
+    --outputModelManifest ${tempOutDataBaseName}-manifest.csv
+    --aifShiftsPerFrame 1
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Curves COMMAND ${Launcher_Command} $<TARGET_FILE:PkModelCurves>
+  ${tempOutDataBaseName}-manifest.csv
+  ${tempOutDataBaseName}-ktrans.nrrd
+  ${tempOutDataBaseName}-ve.nrrd
+  ${tempOutDataBaseName}-bat.nrrd
+  --roi ${inputDataBaseName}-ROI.nrrd
+  --output ${tempOutDataBaseName}-curves.nrrd
+)
+set_property(TEST ${testName}Curves PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Curves PROPERTY DEPENDS ${testName})
+
+add_test(NAME ${testName}CurvesCompare COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${tempOutDataBaseName}-fit.nrrd
+            ${tempOutDataBaseName}-curves.nrrd
+  DoNothingAndPass
+)
+set_property(TEST ${testName}CurvesCompare PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}CurvesCompare PROPERTY DEPENDS ${testName}Curves)
+
+#-----------------------------------------------------------------------------
+# The input is compressed, memory mapping must fall back to the reader
+set(testName QINProstate001_MemoryMapInput)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --memoryMapInput
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# Uncompressed concentrations written by a first run are mapped in place by
+# the resumed run
+set(testName QINProstate001_MemoryMapUncompressedInput)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-conc.nrrd
+            ${tempOutDataBaseName}-conc.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputCompression None
+    --concentrations ${tempOutDataBaseName}-conc.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    --semiQuantitativeOnly
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Fit COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  --compare ${referenceDataBaseName}-fit.nrrd
+            ${tempOutDataBaseName}-fit.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --fitted ${tempOutDataBaseName}-fit.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    --resumeFromConcentrations
+    --memoryMapInput
+    ${tempOutDataBaseName}-conc.nrrd
+)
+set_property(TEST ${testName}Fit PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Fit PROPERTY DEPENDS ${testName})
+
+#-----------------------------------------------------------------------------
+# All outputs written in parallel without compression
+set(testName QINProstate001_UncompressedOutputs)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputCompression None
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# ROI voxels only, scattered back into full size volumes by PkScatterSparse
+set(testName QINProstate001_SparseOutput)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputSparse ${tempOutDataBaseName}.pksparse
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Scatter COMMAND ${Launcher_Command} $<TARGET_FILE:PkScatterSparse>
+  ${tempOutDataBaseName}.pksparse
+  ${tempOutDataBaseName}Scatter
+)
+set_property(TEST ${testName}Scatter PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Scatter PROPERTY DEPENDS ${testName})
+
+# The scattered maps are zero outside of the ROI, as the maps of the reference
+add_test(NAME ${testName}ScatterMaps COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}Scatter-Ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}Scatter-Ve.nrrd
+  --compare ${referenceDataBaseName}-maxslope.nrrd
+            ${tempOutDataBaseName}Scatter-MaxSlope.nrrd
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}Scatter-BAT.nrrd
+  DoNothingAndPass
+)
+set_property(TEST ${testName}ScatterMaps PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}ScatterMaps PROPERTY DEPENDS ${testName}Scatter)
+
+# The reference also has the concentrations of the AIF voxel, which is
+# outside of the ROI and not in the sparse output. The tolerance is the one
+# voxel in each of the 60 frames, the differences are counted per frame.
+add_test(NAME ${testName}ScatterConcentrations COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compareNumberOfPixelsTolerance 60
+  --compare ${referenceDataBaseName}-conc.nrrd
+            ${tempOutDataBaseName}Scatter-Concentrations.nrrd
+  DoNothingAndPass
+)
+set_property(TEST ${testName}ScatterConcentrations PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}ScatterConcentrations PROPERTY DEPENDS ${testName}Scatter)
+
+#-----------------------------------------------------------------------------
+# Model manifest, fitted curves of the ROI regenerated by PkModelCurves
+set(testName QINProstate001_ModelManifest)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --outputBAT ${tempOutDataBaseName}-bat.nrrd
+    --outputModelManifest ${tempOutDataBaseName}-manifest.csv
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Curves COMMAND ${Launcher_Command} $<TARGET_FILE:PkModelCurves>
+  ${tempOutDataBaseName}-manifest.csv
+  ${tempOutDataBaseName}-ktrans.nrrd
+  ${tempOutDataBaseName}-ve.nrrd
+  ${tempOutDataBaseName}-bat.nrrd
+  --roi ${inputDataBaseName}-ROI.nrrd
+  --output ${tempOutDataBaseName}-fit.nrrd
+)
+set_property(TEST ${testName}Curves PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Curves PROPERTY DEPENDS ${testName})
+
+# The regenerated curves of the ROI are the fitted curves of the reference,
+# which are zero outside of the ROI
+add_test(NAME ${testName}CurvesCompare COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-fit.nrrd
+            ${tempOutDataBaseName}-fit.nrrd
+  DoNothingAndPass
+)
+set_property(TEST ${testName}CurvesCompare PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}CurvesCompare PROPERTY DEPENDS ${testName}Curves)
+
+#-----------------------------------------------------------------------------
+# Chunked HDF5 curves, with the input
+set(testName QINProstate001_HDF5Output)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputHDF5 ${tempOutDataBaseName}.h5
+    --outputHDF5Input
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+# Read the datasets back, they must have the curves of the reference
+add_test(NAME ${testName}Contents COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  HDF5CurvesMatch
+    ${tempOutDataBaseName}.h5
+    Concentrations ${referenceDataBaseName}-conc.nrrd
+    Fitted ${referenceDataBaseName}-fit.nrrd
+    Input ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName}Contents PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Contents PROPERTY DEPENDS ${testName})
+
+#-----------------------------------------------------------------------------
+# Concentrations and fitted curves computed into mapped output files
+set(testName QINProstate001_MemoryMappedOutputs)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    --memoryMapOutputs
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# Same in a single pass
+set(testName QINProstate001_MemoryMappedOutputs_SinglePass)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    --singlePass
+    --memoryMapOutputs
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# The input is stored as 16 bit integers, which the single pass filter reads
+# without a float copy
+set(testName QINProstate001_SinglePass)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    --singlePass
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+#-----------------------------------------------------------------------------
+# The model fitted again to the concentrations written by a first run
+set(testName QINProstate001_ResumeFromConcentrations)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-conc.nrrd
+            ${tempOutDataBaseName}-conc.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --concentrations ${tempOutDataBaseName}-conc.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    --semiQuantitativeOnly
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Fit COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  --compare ${referenceDataBaseName}-fit.nrrd
+            ${tempOutDataBaseName}-fit.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --fitted ${tempOutDataBaseName}-fit.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    --resumeFromConcentrations
+    ${tempOutDataBaseName}-conc.nrrd
+)
+set_property(TEST ${testName}Fit PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Fit PROPERTY DEPENDS ${testName})
+
+#-----------------------------------------------------------------------------
+# PeakGradient BAT estimated on the signal intensities, by the BAT map filter
+# of the two pass processing. The single pass run estimates it voxel by voxel
+# along with the conversion and must reproduce all of its outputs.
+set(testName QINProstate001_SignalBATSource)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINProstate001_AllOutputsExceptFpv)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-conc.nrrd
+            ${tempOutDataBaseName}-conc.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --BATSource Signal
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+set(referenceDataBaseName ${tempOutDataBaseName})
+set(tempOutDataBaseName ${TEMP}/${testName}_SinglePass)
+set_compareArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName}_SinglePass COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    --BATSource Signal
+    --singlePass
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName}_SinglePass PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}_SinglePass PROPERTY DEPENDS ${testName})
+
+
 #-----------------------------------------------------------------------------
 # Regression Tests QINBreast001
 #-----------------------------------------------------------------------------
@@ -140,6 +654,25 @@ add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
 )
 set_property(TEST ${testName} PROPERTY LABELS ${CLP})
 
+#-----------------------------------------------------------------------------
+# Same with the unsigned 16 bit input quantified in a single pass
+set(testName QINBreast001_SinglePass)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINBreast001_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    --aifMode Population
+    --singlePass
+    ${outputParamsArgs}
+    ${inputDataBaseName}.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
 #-----------------------------------------------------------------------------
 set(testName QINBreast001_ConstantBat)
 set(tempOutDataBaseName ${TEMP}/${testName})
@@ -159,6 +692,27 @@ add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
 )
 set_property(TEST ${testName} PROPERTY LABELS ${CLP})
 
+#-----------------------------------------------------------------------------
+# A constant BAT is the same on signal and concentration, results must match
+set(testName QINBreast001_ConstantBat_SignalBATSource)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}QINBreast001_ConstantBat)
+set_compareArgs(FALSE)
+set_paramsArgs(FALSE)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    --aifMode Population
+    --BATCalculationMode UseConstantBAT
+    --constantBAT 4
+    --BATSource Signal
+    ${outputParamsArgs}
+    ${inputDataBaseName}.nrrd                   
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
 
 #-----------------------------------------------------------------------------
 # Regression Tests DROs
@@ -459,5 +1013,373 @@ add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
 )
 set_property(TEST ${testName} PROPERTY LABELS ${CLP})
 
+#-----------------------------------------------------------------------------
+# The analytic convolution of the population AIF integrates its narrow first
+# pass exactly, the discrete one samples it every 5s. Ktrans comes out up to
+# about 17% higher (0.065 at the largest Ktrans of the DRO) and Ve about 0.01
+# higher, and the 10 voxels where the reference fit clamps Ve may end up
+# anywhere.
+set(testName DRO3min5secinf_AllOutputsExceptFpv_WithPopulationAIF_Analytic)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}DRO3min5secinf_AllOutputsExceptFpv_WithPopulationAIF)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 0.1
+  --compareNumberOfPixelsTolerance 10
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}-bat.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --analyticAIF
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --outputBAT ${tempOutDataBaseName}-bat.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+
+
+
+#-----------------------------------------------------------------------------
+# Regression Tests DROs with single pass processing
+#-----------------------------------------------------------------------------
+set(testName DRO3min5secinf_AllOutputsExceptFpv_SinglePass)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}DRO3min5secinf_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set(paramsArgs --T1Tissue 1434
+               --T1Blood 1600
+               --relaxivity 0.0037
+               --S0grad 15.0
+               --hematocrit 0.45
+               --aucTimeInterval 90
+               --fTolerance 1e-4 
+               --gTolerance 1e-4 
+               --xTolerance 1e-5 
+               --epsilon 1e-9 
+               --maxIter 200
+               --singlePass)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd                   
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+
 
 
+#-----------------------------------------------------------------------------
+# Regression Tests DROs with AIF shifts
+#-----------------------------------------------------------------------------
+# The tissue curves of the DRO arrive with the AIF, but the sub-frame BAT of
+# the slower rising tissue is estimated 0.3 to 1.9 frames after the one of the
+# AIF. With AIF shifts the AIF is delayed by that much, while the reference
+# shifts the voxels by whole frames, mostly by one. Fitted with the same
+# model outside of PkModeling, the delay moves Ktrans by at most 0.05 and Ve
+# by at most 0.19 from the reference. The tolerances are 0.06 and 0.2,
+# except for the 3 voxels whose reference Ve is 0.
+set(testName DRO3min5secinf_AIFShiftsPerFrame4)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}DRO3min5secinf_AllOutputsExceptFpv)
+set(paramsArgs --T1Tissue 1434
+               --T1Blood 1600
+               --relaxivity 0.0037
+               --S0grad 15.0
+               --hematocrit 0.45
+               --aucTimeInterval 90
+               --fTolerance 1e-4
+               --gTolerance 1e-4
+               --xTolerance 1e-5
+               --epsilon 1e-9
+               --maxIter 200)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 0.06
+  --compareNumberOfPixelsTolerance 3
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --aifShiftsPerFrame 4
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Ve COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 0.2
+  --compareNumberOfPixelsTolerance 3
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  DoNothingAndPass
+)
+set_property(TEST ${testName}Ve PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Ve PROPERTY DEPENDS ${testName})
+
+#-----------------------------------------------------------------------------
+# A constant BAT is the same for the AIF and the voxels, the AIF is then not
+# delayed and the voxels are not shifted. The AIF shifts must give the
+# Ktrans and Ve of whole frame shifts, a wrong AIF of the bank does not.
+set(testName DRO3min5secinf_AIFShiftsPerFrame4_ConstantBat)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${TEMP}/${testName}WholeFrames)
+add_test(NAME ${testName}WholeFrames COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ModuleEntryPoint
+    ${paramsArgs}
+    --BATCalculationMode UseConstantBAT
+    --constantBAT 8
+    --outputKtrans ${referenceDataBaseName}-ktrans.nrrd
+    --outputVe ${referenceDataBaseName}-ve.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName}WholeFrames PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-6
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --BATCalculationMode UseConstantBAT
+    --constantBAT 8
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --aifShiftsPerFrame 4
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+set_property(TEST ${testName} PROPERTY DEPENDS ${testName}WholeFrames)
+
+
+#-----------------------------------------------------------------------------
+# Regression Tests DROs with regional AIFs
+#-----------------------------------------------------------------------------
+# The AIF mask as region map assigns its only label to the AIF voxels, whose
+# regional AIF equals the AIF, so the results must not change
+set(testName DRO3min5secinf_AllOutputsExceptFpv_AIFRegionMap)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}DRO3min5secinf_AllOutputsExceptFpv)
+set_compareArgs(FALSE)
+set(paramsArgs --T1Tissue 1434
+               --T1Blood 1600
+               --relaxivity 0.0037
+               --S0grad 15.0
+               --hematocrit 0.45
+               --aucTimeInterval 90
+               --fTolerance 1e-4 
+               --gTolerance 1e-4 
+               --xTolerance 1e-5 
+               --epsilon 1e-9 
+               --maxIter 200)
+set_outputParamsArgs(FALSE)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ${compareArgs}
+  ModuleEntryPoint
+    ${paramsArgs}
+    ${outputParamsArgs}
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    --aifRegions ${inputDataBaseName}-AIF.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd                   
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+# Two AIFs: label 1 is the AIF voxel of the DRO, label 2 the AIF voxels of
+# the first column diluted with one tissue voxel. The left half of the
+# region map gets AIF 1 and must not change. The right half, 96 ROI voxels,
+# gets AIF 2 and its Ktrans must differ from the single AIF run.
+set(testName DRO3min5secinf_AllOutputsExceptFpv_AIFRegionMapTwoLabels)
+set(tempOutDataBaseName ${TEMP}/${testName})
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compareNumberOfPixelsTolerance 96
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}-bat.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --outputBAT ${tempOutDataBaseName}-bat.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIFTwoLabels.nrrd
+    --aifRegions ${inputDataBaseName}-AIFRegionsTwoLabels.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+# Fails unless more than half of the voxels of region 2 differ
+add_test(NAME ${testName}Differs COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --expectFail
+  --compareIntensityTolerance 1e-4
+  --compareNumberOfPixelsTolerance 48
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  DoNothingAndPass
+)
+set_property(TEST ${testName}Differs PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Differs PROPERTY DEPENDS ${testName})
+
+
+#-----------------------------------------------------------------------------
+# Regression Tests DROs with Auto AIF
+#-----------------------------------------------------------------------------
+# The AIF voxels of the DRO, its first row and column, are outside of the ROI
+# and share one curve, the AIF under the DRO AIF mask. The detected voxels
+# must overlap that mask and their AIF must give the results of the mask.
+set(testName DRO3min5secinf_AllOutputsExceptFpv_AutoAIF)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}DRO3min5secinf_AllOutputsExceptFpv)
+set(paramsArgs --T1Tissue 1434
+               --T1Blood 1600
+               --relaxivity 0.0037
+               --S0grad 15.0
+               --hematocrit 0.45
+               --aucTimeInterval 90
+               --fTolerance 1e-4 
+               --gTolerance 1e-4 
+               --xTolerance 1e-5 
+               --epsilon 1e-9 
+               --maxIter 200)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}-bat.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --aifMode Auto
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --outputBAT ${tempOutDataBaseName}-bat.nrrd
+    --outputAIFMask ${tempOutDataBaseName}-aifmask.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName}Mask COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  MasksOverlap
+    ${tempOutDataBaseName}-aifmask.nrrd
+    ${inputDataBaseName}-AIF.nrrd
+)
+set_property(TEST ${testName}Mask PROPERTY LABELS ${CLP})
+set_property(TEST ${testName}Mask PROPERTY DEPENDS ${testName})
+
+
+#-----------------------------------------------------------------------------
+# Regression Tests DROs as NIfTI-4D with a BIDS sidecar
+#-----------------------------------------------------------------------------
+# The input is written as a NIfTI-4D series, without the MultiVolume meta
+# data, next to a sidecar with the acquisition parameters of the DRO. The
+# sidecar is found next to the input and the results must not change.
+set(testName DRO5min1secinf_NIfTI4DSidecar)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}DRO5min1secinf_AllOutputsExceptFpv)
+configure_file(${inputDataBaseName}5min1secinf.json ${tempOutDataBaseName}-input.json COPYONLY)
+add_test(NAME ${testName}Write COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  WriteFourDVolume
+    ${inputDataBaseName}5min1secinf.nrrd
+    ${tempOutDataBaseName}-input.nii.gz
+)
+set_property(TEST ${testName}Write PROPERTY LABELS ${CLP})
+
+set(paramsArgs --T1Tissue 1434
+               --T1Blood 1600
+               --relaxivity 0.0037
+               --S0grad 15.0
+               --hematocrit 0.45
+               --aucTimeInterval 90
+               --fTolerance 1e-4 
+               --gTolerance 1e-4 
+               --xTolerance 1e-5 
+               --epsilon 1e-9 
+               --maxIter 200)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-conc.nrrd
+            ${tempOutDataBaseName}-conc.nrrd
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}-bat.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --concentrations ${tempOutDataBaseName}-conc.nrrd
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --outputBAT ${tempOutDataBaseName}-bat.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${tempOutDataBaseName}-input.nii.gz
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+set_property(TEST ${testName} PROPERTY DEPENDS ${testName}Write)
+
+
+#-----------------------------------------------------------------------------
+# Regression Tests DROs as a DICOM series
+#-----------------------------------------------------------------------------
+# The input is written as one DICOM file per frame, with the trigger time,
+# repetition time and flip angle of the DRO. The frames are grouped by
+# trigger time and get the MultiVolume meta data from the files. Each file is
+# stored as integers with its own rescale, 60000 steps over the range of the
+# frame, which changes the signal by less than 1e-4 of the baseline. The
+# concentration peak of the AIF moves by about that much, Ktrans, Ve and the
+# BAT must not change.
+set(testName DRO3min5secinf_DICOMSeries)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(referenceDataBaseName ${referenceDataBaseDir}DRO3min5secinf_AllOutputsExceptFpv)
+add_test(NAME ${testName}Write COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  WriteDICOMSeries
+    ${inputDataBaseName}3min5secinf.nrrd
+    ${tempOutDataBaseName}-input
+)
+set_property(TEST ${testName}Write PROPERTY LABELS ${CLP})
+
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  --compareIntensityTolerance 1e-4
+  --compare ${referenceDataBaseName}-ktrans.nrrd
+            ${tempOutDataBaseName}-ktrans.nrrd
+  --compare ${referenceDataBaseName}-ve.nrrd
+            ${tempOutDataBaseName}-ve.nrrd
+  --compare ${referenceDataBaseName}-bat.nrrd
+            ${tempOutDataBaseName}-bat.nrrd
+  ModuleEntryPoint
+    ${paramsArgs}
+    --outputKtrans ${tempOutDataBaseName}-ktrans.nrrd
+    --outputVe ${tempOutDataBaseName}-ve.nrrd
+    --outputBAT ${tempOutDataBaseName}-bat.nrrd
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    ${tempOutDataBaseName}-input
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+set_property(TEST ${testName} PROPERTY DEPENDS ${testName}Write)
@@ -58,3 +58,61 @@ set_property(TEST ${testName} PROPERTY LABELS ${CLP})
 
 
 
+
+#-----------------------------------------------------------------------------
+# Resuming from concentrations, expecting to fail
+#-----------------------------------------------------------------------------
+# Concentrations to resume from, converted with the T1 of the DRO
+set(testName DRO3min5secinf_ResumeFromConcentrationsInput)
+set(tempOutDataBaseName ${TEMP}/${testName})
+set(resumeArgs --T1Tissue 1434
+               --T1Blood 1600
+               --relaxivity 0.0037
+               --roiMask ${inputDataBaseName}-ROI.nrrd
+               --aifMask ${inputDataBaseName}-AIF.nrrd)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ModuleEntryPoint
+    ${resumeArgs}
+    --semiQuantitativeOnly
+    --concentrations ${tempOutDataBaseName}-conc.nrrd
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+
+set(concentrationsFileName ${tempOutDataBaseName}-conc.nrrd)
+set(resumeInputTestName ${testName})
+
+set(testName DRO3min5secinf_FailOnResumeWithOtherT1Blood)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ModuleEntryPointExpectFail
+    --T1Tissue 1434
+    --T1Blood 1700
+    --relaxivity 0.0037
+    --roiMask ${inputDataBaseName}-ROI.nrrd
+    --aifMask ${inputDataBaseName}-AIF.nrrd
+    --resumeFromConcentrations
+    ${concentrationsFileName}
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+set_property(TEST ${testName} PROPERTY DEPENDS ${resumeInputTestName})
+
+set(testName DRO3min5secinf_FailOnResumeWithSinglePass)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ModuleEntryPointExpectFail
+    ${resumeArgs}
+    --resumeFromConcentrations
+    --singlePass
+    ${concentrationsFileName}
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
+set_property(TEST ${testName} PROPERTY DEPENDS ${resumeInputTestName})
+
+# The signal intensities have no PkModeling.Concentrations meta data
+set(testName DRO3min5secinf_FailOnResumeFromSignalIntensities)
+add_test(NAME ${testName} COMMAND ${Launcher_Command} $<TARGET_FILE:${CLP}Test>
+  ModuleEntryPointExpectFail
+    ${resumeArgs}
+    --resumeFromConcentrations
+    ${inputDataBaseName}3min5secinf.nrrd
+)
+set_property(TEST ${testName} PROPERTY LABELS ${CLP})
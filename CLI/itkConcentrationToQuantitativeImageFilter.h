@@ -15,9 +15,18 @@
 #include "itkVectorImage.h"
 #include "itkImageRegionIterator.h"
 #include "itkCastImageFilter.h"
+#include "itkLevenbergMarquardtOptimizer.h"
+#include "itkProgressReporter.h"
+#include "itkCurveChunk.h"
 #include "PkSolver.h"
 #include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <memory>
 #include "AIF/ArterialInputFunction.h"
+#include "AIF/ParkerAIFModel.h"
+#include "IO/ModelManifest.h"
 
 namespace itk
 {
@@ -128,10 +137,48 @@ namespace itk
     itkSetMacro(maxIter, int);
     itkGetMacro(hematocrit, float);
     itkSetMacro(hematocrit, float);
-    itkGetMacro(AUCTimeInterval, float);
-    itkSetMacro(AUCTimeInterval, float);
+
+    /// Length of the interval after the BAT the AUC is computed over
+    void SetAUCTimeInterval(float interval);
+    float GetAUCTimeInterval() const;
+
+    /// Several AUC intervals, one AUC output per interval. The first
+    /// interval is the one of GetAUCOutput().
+    void SetAUCTimeIntervals(const std::vector<float>& intervals);
+    const std::vector<float>& GetAUCTimeIntervals() const;
+
     itkGetMacro(ModelType, int);
     itkSetMacro(ModelType, int);
+    itkGetMacro(UseAnalyticAIF, bool);
+    itkSetMacro(UseAnalyticAIF, bool);
+
+    /// Only compute the semi-quantitative parameters (BAT, max slope, AUC,
+    /// time to peak, peak enhancement, wash-out slope) on the concentration
+    /// curves, without fitting the model. The AUC is then the one of the
+    /// concentration curve instead of the fitted curve.
+    itkGetMacro(SemiQuantitativeOnly, bool);
+    itkSetMacro(SemiQuantitativeOnly, bool);
+
+    /// Number of fractionally delayed AIFs per frame. When non-zero the AIF
+    /// is delayed to the sub-frame BAT of each voxel instead of shifting the
+    /// voxel by whole frames. The delays are steps of the mean frame interval
+    /// divided by this number, on the time axis of the acquisition, so the
+    /// frames need not be evenly spaced. The BAT output is then the
+    /// fractional BAT the AIF was delayed to, not the frame index.
+    /// 0 (default) shifts by whole frames.
+    itkGetMacro(AIFShiftsPerFrame, unsigned int);
+    itkSetMacro(AIFShiftsPerFrame, unsigned int);
+
+    /// Also fill the parameter maps output, all scalar maps of a voxel
+    /// stored next to each other as the components of one vector image.
+    itkGetMacro(ComputeParameterMaps, bool);
+    itkSetMacro(ComputeParameterMaps, bool);
+
+    /// Also fill the time to peak, peak enhancement and wash-out slope
+    /// outputs. Off by default, the curve shape of a voxel is then only
+    /// computed for the parameter maps output.
+    itkGetMacro(ComputeCurveShapeMaps, bool);
+    itkSetMacro(ComputeCurveShapeMaps, bool);
 
     void SetBatEstimator(const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
     {
@@ -153,23 +200,69 @@ namespace itk
     /// Get the mask that specifies from where the model fit is calculated
     const TMaskImage* GetROIMask() const;
 
+    /// Set a map of precomputed bolus arrival time indices, e.g. estimated
+    /// on the signal intensities. If set, the BAT estimator is not used to
+    /// find the BAT of the concentration curves and the BAT output is filled
+    /// from the map.
+    void SetBATMap(const TOutputImage* volume);
+
+    const TOutputImage* GetBATMap() const;
+
 
     /// Set the AIF
     void SetAIF(const ArterialInputFunction* aif);
 
+    /// Set a label map assigning each voxel to a region. Voxels of a region
+    /// with a regional AIF are fitted with it, all other voxels with the AIF.
+    void SetAIFRegionMap(const TMaskImage* volume);
+
+    const TMaskImage* GetAIFRegionMap() const;
+
+    /// Set the AIF of the voxels labeled regionLabel in the AIF region map
+    void SetRegionalAIF(MaskVolumePixelType regionLabel, const ArterialInputFunction* aif);
+
     /// Get the quantitative output images
     TOutputImage* GetKTransOutput();
     TOutputImage* GetVEOutput();
     TOutputImage* GetFPVOutput();
     TOutputImage* GetMaxSlopeOutput();
     TOutputImage* GetAUCOutput();
+    TOutputImage* GetAUCOutput(unsigned int interval);
     TOutputImage* GetRSquaredOutput();
     TOutputImage* GetBATOutput();
 
     VectorVolumeType* GetFittedDataOutput();
 
+    /// Set a buffer the fitted curves are written to instead of an allocated
+    /// one, e.g. the memory mapped voxels of the output file. It has to hold
+    /// the curves of all voxels and outlive the output.
+    void SetFittedDataBuffer(typename VectorVolumeType::InternalPixelType* buffer);
+
     TOutputImage* GetOptimizerDiagnosticsOutput();
 
+    /// Get the semi-quantitative output images. Time to peak is the time
+    /// from the BAT to the peak of the concentration in seconds, the
+    /// wash-out slope the slope of the concentration after the peak per second.
+    TOutputImage* GetTimeToPeakOutput();
+    TOutputImage* GetPeakEnhancementOutput();
+    TOutputImage* GetWashoutSlopeOutput();
+
+    /// Get the parameter maps output, one component per name of
+    /// GetParameterMapNames(). Only computed if ComputeParameterMaps is on.
+    VectorVolumeType* GetParameterMapsOutput();
+
+    /// Names of the components of the parameter maps output, in order. The
+    /// model parameters are left out in the semi-quantitative mode.
+    std::vector<std::string> GetParameterMapNames() const;
+
+    /// The scalar outputs of the maps of GetParameterMapNames(), in order
+    std::vector<TOutputImage*> GetParameterMapOutputs();
+
+    /// The model, time axis and AIFs the fit used, to regenerate the fitted
+    /// curves from the parameter maps with a ModelCurveGenerator. Only valid
+    /// after the filter has run.
+    ModelManifest GetModelManifest() const;
+
   protected:
     ConcentrationToQuantitativeImageFilter();
     ~ConcentrationToQuantitativeImageFilter(){
@@ -178,6 +271,280 @@ namespace itk
 
     void BeforeThreadedGenerateData();
 
+    /// Sets the number of components and the component names of the
+    /// parameter maps output.
+    void GenerateOutputInformation();
+
+    void AllocateOutputs();
+
+    /// Whether AllocateOutputs() allocates output idx. Subclasses with
+    /// optional outputs extend it.
+    virtual bool IsOutputComputed(DataObjectPointerArraySizeType idx) const;
+
+    /// Makes vector output idx use buffer instead of an allocated one
+    void SetOutputBuffer(DataObjectPointerArraySizeType idx, typename VectorVolumeType::InternalPixelType* buffer);
+
+    /// Returns the AIF concentration curve used for all voxels. Called once
+    /// before the threads start, subclasses may override it to derive the AIF
+    /// from their own inputs.
+    virtual std::vector<float> ComputeAIF();
+
+    /// Number of outputs before the AUC maps of the additional intervals.
+    /// Subclasses that add outputs number them from here on and return the
+    /// new count.
+    virtual DataObjectPointerArraySizeType GetNumberOfFixedOutputs() const
+    {
+      return 13;
+    }
+
+    /// Number of time points of the input curves. Subclasses may take an
+    /// input of another pixel type, so it is read through the image base.
+    unsigned int GetNumberOfTimePoints() const
+    {
+      typedef ImageBase<VectorVolumeType::ImageDimension> ImageBaseType;
+      return dynamic_cast<const ImageBaseType*>(this->ProcessObject::GetInput(0))->GetNumberOfComponentsPerPixel();
+    }
+
+    /// An AIF with the values derived from it that all voxels fitted with it
+    /// share. Computed once per AIF before the threads start.
+    struct AIFContext
+    {
+      std::vector<float> AIF;
+      int   BATIndex;
+      // BAT in fractional frames, BATIndex unless AIF shifts are enabled
+      float BATPosition;
+      // Acquisition time of BATPosition, in minutes
+      double BATTime;
+      // AUC of the AIF for each AUC interval
+      std::vector<float> AUC;
+      // Functional form of the AIF, if the convolution is evaluated analytically
+      std::shared_ptr<ParkerAIFModel> AnalyticAIF;
+      // With AIF shifts enabled, ShiftedAIFs[j] is the AIF delayed by
+      // j * ShiftStep minutes (same for the functional form)
+      double ShiftStep;
+      std::vector<std::vector<float> > ShiftedAIFs;
+      std::vector<std::shared_ptr<ParkerAIFModel> > ShiftedAnalyticAIFs;
+    };
+
+    /// Context of the voxels labeled regionLabel in the AIF region map,
+    /// the context of the AIF if there is no regional AIF for the label.
+    const AIFContext& GetAIFContext(MaskVolumePixelType regionLabel) const;
+
+    /// Context of the AIF
+    const AIFContext& GetAIFContext() const;
+
+    /// Per thread state of the model fit, allocated once and reused for every
+    /// voxel of the region the thread works on.
+    struct FitWorkspace
+    {
+      FitWorkspace(unsigned int timeSize)
+        : optimizer(itk::LevenbergMarquardtOptimizer::New()),
+          costFunction(LMCostFunction::New()),
+          shiftedVectorVoxel(timeSize),
+          fittedVectorVoxel(timeSize),
+          cumulativeArea(timeSize)
+      {
+      }
+
+      itk::LevenbergMarquardtOptimizer::Pointer optimizer;
+      LMCostFunction::Pointer                   costFunction;
+      // After QuantifyVoxel() this holds the fitted curve aligned with the input curve
+      VectorVoxelType shiftedVectorVoxel;
+      VectorVoxelType fittedVectorVoxel;
+      std::vector<double> cumulativeArea;
+    };
+
+    /// Quantitative parameters of a single voxel as written to the outputs.
+    struct VoxelResult
+    {
+      VoxelResult(unsigned int numberOfAUCs = 1) : auc(numberOfAUCs) { Reset(); }
+
+      void Reset()
+      {
+        ktrans = ve = fpv = maxSlope = 0.0f;
+        timeToPeak = peakEnhancement = washoutSlope = 0.0f;
+        std::fill(auc.begin(), auc.end(), 0.0f);
+        rSquared = 0.0;
+        bat = -1;
+        optimizerErrorCode = -1;
+      }
+
+      float  ktrans;
+      float  ve;
+      float  fpv;
+      float  maxSlope;
+      std::vector<float> auc;
+      double rSquared;
+      // Frame index, the fractional BAT with AIF shifts
+      float  bat;
+      float  optimizerErrorCode;
+      float  timeToPeak;
+      float  peakEnhancement;
+      float  washoutSlope;
+    };
+
+    /// Iterator over an output that may not be computed, which is then
+    /// neither allocated nor written
+    template <class TImage>
+    struct OptionalOutputIterator
+    {
+      OptionalOutputIterator() : computed(false) {}
+      OptionalOutputIterator(TImage* image, const OutputVolumeRegionType& region, bool computed)
+        : computed(computed)
+      {
+        if (computed)
+        {
+          iterator = ImageRegionIterator<TImage>(image, region);
+        }
+      }
+
+      void Set(const typename TImage::PixelType& value)
+      {
+        if (computed)
+        {
+          iterator.Set(value);
+        }
+      }
+
+      OptionalOutputIterator& operator++()
+      {
+        if (computed)
+        {
+          ++iterator;
+        }
+        return *this;
+      }
+
+      ImageRegionIterator<TImage> iterator;
+      bool computed;
+    };
+    typedef OptionalOutputIterator<OutputVolumeType> OptionalOutputVolumeIterType;
+    typedef OptionalOutputIterator<VectorVolumeType> OptionalVectorVolumeIterType;
+
+    /// Iterators over all quantitative outputs for the region of one thread.
+    /// Outputs that are not computed are skipped.
+    struct OutputIterators
+    {
+      OutputIterators(Self* filter, const OutputVolumeRegionType& region)
+        : ktrans(filter->GetKTransOutput(), region, filter->IsOutputComputed(0)),
+          ve(filter->GetVEOutput(), region, filter->IsOutputComputed(1)),
+          fpv(filter->GetFPVOutput(), region, filter->IsOutputComputed(2)),
+          maxSlope(filter->GetMaxSlopeOutput(), region),
+          rSquared(filter->GetRSquaredOutput(), region, filter->IsOutputComputed(5)),
+          bat(filter->GetBATOutput(), region),
+          diagnostics(filter->GetOptimizerDiagnosticsOutput(), region, filter->IsOutputComputed(8)),
+          fitted(filter->GetFittedDataOutput(), region, filter->IsOutputComputed(7)),
+          timeToPeak(filter->GetTimeToPeakOutput(), region, filter->IsOutputComputed(9)),
+          peakEnhancement(filter->GetPeakEnhancementOutput(), region, filter->IsOutputComputed(10)),
+          washoutSlope(filter->GetWashoutSlopeOutput(), region, filter->IsOutputComputed(11)),
+          parameterMaps(filter->GetComputeParameterMaps() ? filter->GetParameterMapsOutput() : NULL),
+          modelParameters(!filter->GetSemiQuantitativeOnly()),
+          fpvParameter(filter->GetModelType() == itk::LMCostFunction::TOFTS_3_PARAMETER)
+      {
+        for (unsigned int i = 0; i < filter->GetAUCTimeIntervals().size(); ++i)
+        {
+          auc.push_back(OutputVolumeIterType(filter->GetAUCOutput(i), region));
+        }
+      }
+
+      void Set(const VoxelResult& result, const VectorVoxelType& fittedVectorVoxel)
+      {
+        ktrans.Set(static_cast<OutputVolumePixelType>(result.ktrans));
+        ve.Set(static_cast<OutputVolumePixelType>(result.ve));
+        fpv.Set(static_cast<OutputVolumePixelType>(result.fpv));
+        maxSlope.Set(static_cast<OutputVolumePixelType>(result.maxSlope));
+        for (unsigned int i = 0; i < auc.size(); ++i)
+        {
+          auc[i].Set(static_cast<OutputVolumePixelType>(result.auc[i]));
+        }
+        rSquared.Set(static_cast<OutputVolumePixelType>(result.rSquared));
+        bat.Set(static_cast<OutputVolumePixelType>(result.bat));
+        diagnostics.Set(static_cast<OutputVolumePixelType>(result.optimizerErrorCode));
+        fitted.Set(fittedVectorVoxel);
+        timeToPeak.Set(static_cast<OutputVolumePixelType>(result.timeToPeak));
+        peakEnhancement.Set(static_cast<OutputVolumePixelType>(result.peakEnhancement));
+        washoutSlope.Set(static_cast<OutputVolumePixelType>(result.washoutSlope));
+        if (parameterMaps)
+        {
+          SetParameterRecord(result);
+        }
+      }
+
+      /// Writes the result straight into the interleaved buffer of the
+      /// parameter maps, in the order of GetParameterMapNames()
+      void SetParameterRecord(const VoxelResult& result)
+      {
+        const unsigned int numberOfComponents = parameterMaps->GetNumberOfComponentsPerPixel();
+        float* record = parameterMaps->GetBufferPointer() +
+          parameterMaps->ComputeOffset(bat.GetIndex()) * numberOfComponents;
+        if (modelParameters)
+        {
+          *record++ = result.ktrans;
+          *record++ = result.ve;
+          if (fpvParameter)
+          {
+            *record++ = result.fpv;
+          }
+        }
+        *record++ = result.maxSlope;
+        for (unsigned int i = 0; i < result.auc.size(); ++i)
+        {
+          *record++ = result.auc[i];
+        }
+        if (modelParameters)
+        {
+          *record++ = static_cast<float>(result.rSquared);
+        }
+        *record++ = static_cast<float>(result.bat);
+        if (modelParameters)
+        {
+          *record++ = result.optimizerErrorCode;
+        }
+        *record++ = result.timeToPeak;
+        *record++ = result.peakEnhancement;
+        *record++ = result.washoutSlope;
+      }
+
+      OutputIterators& operator++()
+      {
+        ++ktrans; ++ve; ++fpv; ++maxSlope; ++rSquared; ++bat; ++diagnostics; ++fitted;
+        ++timeToPeak; ++peakEnhancement; ++washoutSlope;
+        for (unsigned int i = 0; i < auc.size(); ++i)
+        {
+          ++auc[i];
+        }
+        return *this;
+      }
+
+      OptionalOutputVolumeIterType ktrans;
+      OptionalOutputVolumeIterType ve;
+      OptionalOutputVolumeIterType fpv;
+      OutputVolumeIterType maxSlope;
+      std::vector<OutputVolumeIterType> auc;
+      OptionalOutputVolumeIterType rSquared;
+      OutputVolumeIterType bat;
+      OptionalOutputVolumeIterType diagnostics;
+      OptionalVectorVolumeIterType fitted;
+      OptionalOutputVolumeIterType timeToPeak;
+      OptionalOutputVolumeIterType peakEnhancement;
+      OptionalOutputVolumeIterType washoutSlope;
+      VectorVolumeType* parameterMaps;
+      bool modelParameters;
+      bool fpvParameter;
+    };
+
+    /// Estimates the bolus arrival times of the curves of a chunk as the model
+    /// fit needs them, in one call. If the BAT indices were already set, e.g.
+    /// from a BAT map, only the max slopes are estimated.
+    void EstimateBATs(CurveChunk& chunk, bool hasBATIndices) const;
+
+    /// Fits the model to a single concentration curve with the BAT estimated
+    /// by EstimateBATs(), a negative index means BAT detection failed.
+    /// Returns false if the voxel could not be fitted, result then holds the
+    /// failure defaults and the reason in optimizerErrorCode.
+    bool QuantifyVoxel(const float* concentration, int BATIndex, float BATPosition, float maxSlope,
+                       const AIFContext& aif, FitWorkspace& workspace, VoxelResult& result) const;
+
 #if ITK_VERSION_MAJOR < 4
     void ThreadedGenerateData( const OutputVolumeRegionType& outputRegionForThread, int threadId );
 
@@ -190,6 +557,33 @@ namespace itk
 
   private:
     ConcentrationToQuantitativeImageFilter(const Self &); // purposely not implemented
+
+    bool FitShiftedVoxel(const float* concentration, int BATIndex, float BATPosition, float maxSlope, const AIFContext& aif,
+                         FitWorkspace& workspace, VoxelResult& result) const;
+
+    /// Semi-quantitative parameters of a concentration curve with a known
+    /// BAT, no model fit. The fitted curve in the workspace is zero.
+    bool SemiQuantifyVoxel(const float* concentration, int BATIndex, float maxSlope, const AIFContext& aif,
+                           FitWorkspace& workspace, VoxelResult& result) const;
+
+    /// Time to peak, peak enhancement and wash-out slope of a concentration
+    /// curve with a valid BAT
+    void ComputeCurveShape(const float* concentration, int BATIndex, VoxelResult& result) const;
+
+    /// Whether an output needs the curve shape of the voxels
+    bool IsCurveShapeComputed() const
+    {
+      return m_ComputeCurveShapeMaps || m_ComputeParameterMaps;
+    }
+
+    /// source is the AIF the samples come from, if any. Its functional form
+    /// is used for the analytic convolution, else the form is fitted.
+    AIFContext MakeAIFContext(const std::vector<float>& aif, const ArterialInputFunction* source = NULL) const;
+
+    /// Acquisition time in minutes at a fractional frame position, linearly
+    /// interpolated between the frames around it.
+    double GetTimeMinuteAt(double position) const;
+
     void operator=(const Self &); // purposely not implemented
 
     float  m_T1Pre;
@@ -203,17 +597,27 @@ namespace itk
     float  m_epsilon;
     int    m_maxIter;
     float  m_hematocrit;
-    float  m_AUCTimeInterval;
-    int    m_AIFBATIndex;
+    std::vector<float> m_AUCTimeIntervals;
     int    m_ModelType;
+    bool   m_UseAnalyticAIF;
+    bool   m_SemiQuantitativeOnly;
+    unsigned int m_AIFShiftsPerFrame;
+    bool   m_ComputeParameterMaps;
+    bool   m_ComputeCurveShapeMaps;
     const BolusArrivalTime::BolusArrivalTimeEstimator* m_batEstimator;
     const ArterialInputFunction* m_aif;
+    std::map<MaskVolumePixelType, const ArterialInputFunction*> m_RegionalAIFs;
 
     std::vector<float> m_Timing;
+    // buffers of vector outputs that are not allocated, by output index
+    std::map<DataObjectPointerArraySizeType, typename VectorVolumeType::InternalPixelType*> m_OutputBuffers;
 
     // variables to cache information to share between threads
-    std::vector<float> m_AIF;
-    float  m_aifAUC;
+    // (the first context is the one of the AIF, followed by the regional ones
+    // indexed by region label)
+    std::vector<AIFContext> m_AIFContexts;
+    std::vector<unsigned int> m_AIFContextIndex;
+    std::vector<float> m_TimeMinute;
   };
 
 }; // end namespace itk
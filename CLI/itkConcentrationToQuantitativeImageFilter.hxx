@@ -6,7 +6,10 @@
 #include "itkImageRegionIterator.h"
 #include "itkProgressReporter.h"
 #include "itkLevenbergMarquardtOptimizer.h"
+#include "itkMetaDataObject.h"
 #include "vnl/vnl_math.h"
+#include <algorithm>
+#include <sstream>
 
 // work around compile error on Windows
 #define M_PI 3.1415926535897932384626433832795
@@ -32,9 +35,15 @@ namespace itk
     m_epsilon = 1e-9f;
     m_maxIter = 200;
     m_hematocrit = 0.4f;
-    m_aifAUC = 0.0f;
-    m_AIFBATIndex = 0;
+    m_AUCTimeIntervals.assign(1, 90.0f);
     m_ModelType = itk::LMCostFunction::TOFTS_2_PARAMETER;
+    m_UseAnalyticAIF = false;
+    m_SemiQuantitativeOnly = false;
+    m_AIFShiftsPerFrame = 0;
+    m_ComputeParameterMaps = false;
+    m_ComputeCurveShapeMaps = false;
+    m_batEstimator = NULL;
+    m_aif = NULL;
     this->Superclass::SetNumberOfRequiredInputs(1);
     this->Superclass::SetNthOutput(1, static_cast<TOutputImage*>(this->MakeOutput(1).GetPointer()));  // Ve
     this->Superclass::SetNthOutput(2, static_cast<TOutputImage*>(this->MakeOutput(2).GetPointer()));  // FPV
@@ -44,6 +53,10 @@ namespace itk
     this->Superclass::SetNthOutput(6, static_cast<TOutputImage*>(this->MakeOutput(6).GetPointer()));  // BAT
     this->Superclass::SetNthOutput(7, static_cast<VectorVolumeType*>(this->MakeOutput(7).GetPointer())); // fitted
     this->Superclass::SetNthOutput(8, static_cast<TOutputImage*>(this->MakeOutput(8).GetPointer())); // diagnostics
+    this->Superclass::SetNthOutput(9, static_cast<TOutputImage*>(this->MakeOutput(9).GetPointer())); // time to peak
+    this->Superclass::SetNthOutput(10, static_cast<TOutputImage*>(this->MakeOutput(10).GetPointer())); // peak enhancement
+    this->Superclass::SetNthOutput(11, static_cast<TOutputImage*>(this->MakeOutput(11).GetPointer())); // wash-out slope
+    this->Superclass::SetNthOutput(12, static_cast<VectorVolumeType*>(this->MakeOutput(12).GetPointer())); // parameter maps
   }
 
   template< class TInputImage, class TMaskImage, class TOutputImage >
@@ -51,7 +64,7 @@ namespace itk
     ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
     ::MakeOutput(DataObjectPointerArraySizeType idx)
   {
-    if (idx == 7)
+    if (idx == 7 || idx == 12)
     {
       return VectorVolumeType::New().GetPointer();
     }
@@ -73,6 +86,35 @@ namespace itk
     m_aif = aif;
   }
 
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  void
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::SetRegionalAIF(MaskVolumePixelType regionLabel, const ArterialInputFunction* aif)
+  {
+    if (aif->getSignalSize() < 2)
+    {
+      itkExceptionMacro(<< "AIF must contain at least two time points");
+    }
+    m_RegionalAIFs[regionLabel] = aif;
+    this->Modified();
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  void
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::SetAIFRegionMap(const TMaskImage* volume)
+  {
+    this->SetNthInput(5, const_cast<TMaskImage*>(volume));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  const TMaskImage*
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetAIFRegionMap() const
+  {
+    return dynamic_cast<const TMaskImage *>(this->ProcessObject::GetInput(5));
+  }
+
   // Set 3D ROI mask as third input
   template< class TInputImage, class TMaskImage, class TOutputImage >
   void
@@ -90,6 +132,22 @@ namespace itk
     return dynamic_cast<const TMaskImage *>(this->ProcessObject::GetInput(2));
   }
 
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  void
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::SetBATMap(const TOutputImage* volume)
+  {
+    this->SetNthInput(4, const_cast<TOutputImage*>(volume));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  const TOutputImage*
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetBATMap() const
+  {
+    return dynamic_cast<const TOutputImage *>(this->ProcessObject::GetInput(4));
+  }
+
   template< class TInputImage, class TMaskImage, class TOutputImage >
   TOutputImage*
     ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
@@ -130,6 +188,16 @@ namespace itk
     return dynamic_cast<TOutputImage *>(this->ProcessObject::GetOutput(4));
   }
 
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  TOutputImage*
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetAUCOutput(unsigned int interval)
+  {
+    // the AUCs of the additional intervals follow the fixed outputs
+    return dynamic_cast<TOutputImage *>(this->ProcessObject::GetOutput(
+      interval == 0 ? 4 : this->GetNumberOfFixedOutputs() + interval - 1));
+  }
+
   template< class TInputImage, class TMaskImage, class TOutputImage >
   TOutputImage*
     ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
@@ -162,30 +230,437 @@ namespace itk
     return dynamic_cast<TOutputImage *>(this->ProcessObject::GetOutput(8));
   }
 
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  TOutputImage*
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetTimeToPeakOutput()
+  {
+    return dynamic_cast<TOutputImage *>(this->ProcessObject::GetOutput(9));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  TOutputImage*
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetPeakEnhancementOutput()
+  {
+    return dynamic_cast<TOutputImage *>(this->ProcessObject::GetOutput(10));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  TOutputImage*
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetWashoutSlopeOutput()
+  {
+    return dynamic_cast<TOutputImage *>(this->ProcessObject::GetOutput(11));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  TInputImage*
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetParameterMapsOutput()
+  {
+    return dynamic_cast<TInputImage *>(this->ProcessObject::GetOutput(12));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  void
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::SetFittedDataBuffer(typename VectorVolumeType::InternalPixelType* buffer)
+  {
+    this->SetOutputBuffer(7, buffer);
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  ModelManifest
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetModelManifest() const
+  {
+    if (m_AIFContexts.empty())
+    {
+      itkExceptionMacro(<< "The model manifest is only available after the filter has run");
+    }
+
+    ModelManifest manifest;
+    manifest.modelType = m_ModelType;
+    manifest.hematocrit = m_hematocrit;
+    manifest.aifShiftsPerFrame = m_AIFShiftsPerFrame;
+    manifest.timing = m_Timing;
+
+    std::vector<ModelManifest::AIF> aifs(m_AIFContexts.size());
+    for (std::size_t i = 0; i < m_AIFContexts.size(); ++i)
+    {
+      const AIFContext& context = m_AIFContexts[i];
+      aifs[i].curve = context.AIF;
+      aifs[i].BATIndex = context.BATIndex;
+      aifs[i].BATPosition = context.BATPosition;
+      if (context.AnalyticAIF)
+      {
+        aifs[i].hasParkerParameters = true;
+        aifs[i].parkerParameters = context.AnalyticAIF->getParameters();
+      }
+    }
+    manifest.aif = aifs[0];
+    for (std::size_t label = 0; label < m_AIFContextIndex.size(); ++label)
+    {
+      // labels without a regional AIF point to the AIF
+      if (m_AIFContextIndex[label] > 0)
+      {
+        manifest.regionalAIFs[static_cast<unsigned int>(label)] = aifs[m_AIFContextIndex[label]];
+      }
+    }
+    return manifest;
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  std::vector<std::string>
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetParameterMapNames() const
+  {
+    std::vector<std::string> names;
+    if (!m_SemiQuantitativeOnly)
+    {
+      names.push_back("Ktrans");
+      names.push_back("Ve");
+      if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
+      {
+        names.push_back("Fpv");
+      }
+    }
+    names.push_back("MaxSlope");
+    for (unsigned int i = 0; i < m_AUCTimeIntervals.size(); ++i)
+    {
+      // several AUCs are named by their interval, as their files
+      std::ostringstream name;
+      name << "AUC";
+      if (m_AUCTimeIntervals.size() > 1)
+      {
+        name << m_AUCTimeIntervals[i] << "s";
+      }
+      names.push_back(name.str());
+    }
+    if (!m_SemiQuantitativeOnly)
+    {
+      names.push_back("RSquared");
+    }
+    names.push_back("BAT");
+    if (!m_SemiQuantitativeOnly)
+    {
+      names.push_back("OptimizerDiagnostics");
+    }
+    names.push_back("TimeToPeak");
+    names.push_back("PeakEnhancement");
+    names.push_back("WashoutSlope");
+    return names;
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  std::vector<TOutputImage*>
+    ConcentrationToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetParameterMapOutputs()
+  {
+    std::vector<TOutputImage*> outputs;
+    if (!m_SemiQuantitativeOnly)
+    {
+      outputs.push_back(this->GetKTransOutput());
+      outputs.push_back(this->GetVEOutput());
+      if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
+      {
+        outputs.push_back(this->GetFPVOutput());
+      }
+    }
+    outputs.push_back(this->GetMaxSlopeOutput());
+    for (unsigned int i = 0; i < m_AUCTimeIntervals.size(); ++i)
+    {
+      outputs.push_back(this->GetAUCOutput(i));
+    }
+    if (!m_SemiQuantitativeOnly)
+    {
+      outputs.push_back(this->GetRSquaredOutput());
+    }
+    outputs.push_back(this->GetBATOutput());
+    if (!m_SemiQuantitativeOnly)
+    {
+      outputs.push_back(this->GetOptimizerDiagnosticsOutput());
+    }
+    outputs.push_back(this->GetTimeToPeakOutput());
+    outputs.push_back(this->GetPeakEnhancementOutput());
+    outputs.push_back(this->GetWashoutSlopeOutput());
+    return outputs;
+  }
+
   template <class TInputImage, class TMaskImage, class TOutputImage>
   void
     ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
-    ::BeforeThreadedGenerateData()
+    ::GenerateOutputInformation()
   {
-    const VectorVolumeType* inputVectorVolume = this->GetInput();
+    Superclass::GenerateOutputInformation();
 
-    std::cout << "Model type: " << m_ModelType << std::endl;
+    VectorVolumeType* parameterMaps = this->GetParameterMapsOutput();
+    if (!m_ComputeParameterMaps)
+    {
+      return;
+    }
+    const std::vector<std::string> names = this->GetParameterMapNames();
+    parameterMaps->SetNumberOfComponentsPerPixel(names.size());
 
-    int timeSize = (int)inputVectorVolume->GetNumberOfComponentsPerPixel();
+    std::ostringstream labels;
+    for (unsigned int i = 0; i < names.size(); ++i)
+    {
+      labels << (i ? "," : "") << names[i];
+    }
+    itk::EncapsulateMetaData<std::string>(parameterMaps->GetMetaDataDictionary(), "ParameterMaps.ComponentLabels", labels.str());
+  }
 
-    // Some of the outputs are optional and may not be calculated.
-    // Let's initialize those to all zeros
-    OutputVolumeType *fpv = this->GetFPVOutput();
-    fpv->FillBuffer(0.0);
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::AllocateOutputs()
+  {
+    typedef ImageBase<OutputVolumeType::ImageDimension> ImageBaseType;
+    for (DataObjectPointerArraySizeType i = 0; i < this->GetNumberOfIndexedOutputs(); ++i)
+    {
+      if (!this->IsOutputComputed(i))
+      {
+        continue;
+      }
+      ImageBaseType* output = dynamic_cast<ImageBaseType*>(this->ProcessObject::GetOutput(i));
+      if (!output)
+      {
+        continue;
+      }
+      output->SetBufferedRegion(output->GetRequestedRegion());
+      VectorVolumeType* vectorOutput = dynamic_cast<VectorVolumeType*>(output);
+      typename std::map<DataObjectPointerArraySizeType, typename VectorVolumeType::InternalPixelType*>::const_iterator
+        buffer = m_OutputBuffers.find(i);
+      if (vectorOutput && buffer != m_OutputBuffers.end())
+      {
+        const std::size_t size = vectorOutput->GetBufferedRegion().GetNumberOfPixels() *
+                                 vectorOutput->GetNumberOfComponentsPerPixel();
+        vectorOutput->GetPixelContainer()->SetImportPointer(buffer->second, size, false);
+      }
+      else
+      {
+        output->Allocate();
+      }
+    }
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::SetOutputBuffer(DataObjectPointerArraySizeType idx, typename VectorVolumeType::InternalPixelType* buffer)
+  {
+    if (buffer)
+    {
+      m_OutputBuffers[idx] = buffer;
+    }
+    else
+    {
+      m_OutputBuffers.erase(idx);
+    }
+    this->Modified();
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  bool
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::IsOutputComputed(DataObjectPointerArraySizeType idx) const
+  {
+    switch (idx)
+    {
+    // Ktrans, Ve, Fpv, R^2, fitted curves and diagnostics of the model fit
+    case 0: case 1: case 2: case 5: case 7: case 8:
+      return !m_SemiQuantitativeOnly;
+    // time to peak, peak enhancement and wash-out slope
+    case 9: case 10: case 11:
+      return m_ComputeCurveShapeMaps;
+    case 12:
+      return m_ComputeParameterMaps;
+    default:
+      return true;
+    }
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::BeforeThreadedGenerateData()
+  {
+    std::cout << "Model type: " << m_ModelType << std::endl;
+
+    // the model is fitted on a time axis in minutes
+    m_TimeMinute.resize(m_Timing.size());
+    for (unsigned int i = 0; i < m_TimeMinute.size(); i++)
+    {
+      m_TimeMinute[i] = m_Timing[i] / 60.0;
+    }
 
     // get AIF signal
-    m_AIF = m_aif->getSignalValues();
-    
+    m_AIFContexts.clear();
+    m_AIFContexts.push_back(this->MakeAIFContext(this->ComputeAIF(), m_aif));
+
+    // The regional AIFs are prepared once here, the voxels of a region then
+    // only look up their context
+    m_AIFContextIndex.clear();
+    if (this->GetAIFRegionMap())
+    {
+      typename std::map<MaskVolumePixelType, const ArterialInputFunction*>::const_iterator it;
+      for (it = m_RegionalAIFs.begin(); it != m_RegionalAIFs.end(); ++it)
+      {
+        if (m_AIFContextIndex.size() <= static_cast<std::size_t>(it->first))
+        {
+          m_AIFContextIndex.resize(static_cast<std::size_t>(it->first) + 1, 0);
+        }
+        m_AIFContextIndex[it->first] = m_AIFContexts.size();
+        m_AIFContexts.push_back(this->MakeAIFContext(it->second->getSignalValues(), it->second));
+      }
+    }
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  typename ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>::AIFContext
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::MakeAIFContext(const std::vector<float>& aif, const ArterialInputFunction* source) const
+  {
+    const int timeSize = (int)this->GetNumberOfTimePoints();
+    if (aif.size() != static_cast<std::size_t>(timeSize))
+    {
+      itkExceptionMacro(<< "AIF and concentration curves differ in length");
+    }
+
+    AIFContext context;
+    context.AIF = aif;
+
     // Compute the bolus arrival time
-    m_AIFBATIndex = m_batEstimator->getBATIndex(m_AIF.size(), &m_AIF[0]);
+    if (m_AIFShiftsPerFrame > 0)
+    {
+      context.BATIndex = m_batEstimator->getBATPosition(context.AIF.size(), &context.AIF[0], context.BATPosition);
+    }
+    else
+    {
+      context.BATIndex = m_batEstimator->getBATIndex(context.AIF.size(), &context.AIF[0]);
+      context.BATPosition = static_cast<float>(context.BATIndex);
+    }
 
     // Compute the area under the curve for the AIF
-    m_aifAUC = area_under_curve(timeSize, &m_Timing[0], &m_AIF[0], m_AIFBATIndex, m_AUCTimeInterval);
+    std::vector<double> cumulativeArea(timeSize);
+    cumulative_area_under_curve(timeSize, &m_Timing[0], &context.AIF[0], &cumulativeArea[0]);
+    context.AUC.resize(m_AUCTimeIntervals.size());
+    for (std::size_t i = 0; i < m_AUCTimeIntervals.size(); ++i)
+    {
+      context.AUC[i] = area_under_curve(timeSize, &m_Timing[0], &context.AIF[0], &cumulativeArea[0],
+                                        context.BATIndex, m_AUCTimeIntervals[i]);
+    }
+
+    if (m_UseAnalyticAIF)
+    {
+      ParkerAIFModel::Parameters parameters;
+      if (!source || !source->getParkerParameters(parameters))
+      {
+        parameters = ParkerAIFModel::fit(m_TimeMinute, context.AIF);
+      }
+      context.AnalyticAIF.reset(new ParkerAIFModel(parameters, m_TimeMinute));
+    }
+
+    // Bank of the AIF delayed in steps of a fraction of the mean frame
+    // interval, up to the length of the series. The delayed AIF is sampled
+    // on the acquisition times, which need not be evenly spaced.
+    context.BATTime = this->GetTimeMinuteAt(context.BATPosition);
+    context.ShiftStep = 0.0;
+    if (m_AIFShiftsPerFrame > 0 && timeSize > 1)
+    {
+      const std::size_t bankSize = (timeSize - 1) * m_AIFShiftsPerFrame + 1;
+      context.ShiftStep = (m_TimeMinute[timeSize - 1] - m_TimeMinute[0]) / (bankSize - 1);
+      context.ShiftedAIFs.resize(bankSize);
+      if (context.AnalyticAIF)
+      {
+        context.ShiftedAnalyticAIFs.resize(bankSize);
+      }
+      for (std::size_t j = 0; j < bankSize; ++j)
+      {
+        const double delay = j * context.ShiftStep;
+        std::vector<float>& shiftedAIF = context.ShiftedAIFs[j];
+        shiftedAIF.assign(timeSize, 0.0f);
+        // Frame at or before the delayed time, only moves forward with i
+        int before = 0;
+        for (int i = 0; i < timeSize; ++i)
+        {
+          // Zero before the first frame, with some slack for the delays that
+          // fall on a frame in exact arithmetic
+          if (m_TimeMinute[i] - delay < m_TimeMinute[0] - 1e-3 * context.ShiftStep)
+          {
+            continue;
+          }
+          const double time = std::max(m_TimeMinute[i] - delay, static_cast<double>(m_TimeMinute[0]));
+          while (before + 1 < timeSize && m_TimeMinute[before + 1] <= time)
+          {
+            ++before;
+          }
+          const int after = std::min(before + 1, timeSize - 1);
+          const double interval = m_TimeMinute[after] - m_TimeMinute[before];
+          const double fraction = interval > 0.0 ? (time - m_TimeMinute[before]) / interval : 0.0;
+          shiftedAIF[i] = (1.0 - fraction)*context.AIF[before] + fraction*context.AIF[after];
+        }
+        if (context.AnalyticAIF)
+        {
+          ParkerAIFModel::Parameters parameters = context.AnalyticAIF->getParameters();
+          parameters.arrival += delay;
+          context.ShiftedAnalyticAIFs[j].reset(new ParkerAIFModel(parameters, m_TimeMinute));
+        }
+      }
+    }
+    return context;
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  double
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::GetTimeMinuteAt(double position) const
+  {
+    const int last = (int)m_TimeMinute.size() - 1;
+    if (last <= 0 || position <= 0.0)
+    {
+      return m_TimeMinute.empty() ? 0.0 : m_TimeMinute[0];
+    }
+    if (position >= last)
+    {
+      return m_TimeMinute[last];
+    }
+    const int before = static_cast<int>(floor(position));
+    const double fraction = position - before;
+    return (1.0 - fraction)*m_TimeMinute[before] + fraction*m_TimeMinute[before + 1];
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  const typename ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>::AIFContext&
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::GetAIFContext(MaskVolumePixelType regionLabel) const
+  {
+    if (static_cast<std::size_t>(regionLabel) < m_AIFContextIndex.size())
+    {
+      return m_AIFContexts[m_AIFContextIndex[regionLabel]];
+    }
+    return m_AIFContexts[0];
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  const typename ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>::AIFContext&
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::GetAIFContext() const
+  {
+    return m_AIFContexts[0];
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  std::vector<float>
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::ComputeAIF()
+  {
+    if (!m_aif)
+    {
+      itkExceptionMacro(<< "AIF is not set");
+    }
+    return m_aif->getSignalValues();
   }
 
   template <class TInputImage, class TMaskImage, class TOutputImage>
@@ -197,271 +672,386 @@ namespace itk
     ::ThreadedGenerateData(const OutputVolumeRegionType& outputRegionForThread, ThreadIdType threadId)
 #endif
   {
-    VectorVoxelType vectorVoxel, fittedVectorVoxel;
-
-    float tempFpv = 0.0f;
-    float tempKtrans = 0.0f;
-    float tempVe = 0.0f;
-    float tempMaxSlope = 0.0f;
-    float tempAUC = 0.0f;
-    int   BATIndex = 0;
-
     const VectorVolumeType* inputVectorVolume = this->GetInput();
+    const unsigned int timeSize = inputVectorVolume->GetNumberOfComponentsPerPixel();
 
     VectorVolumeConstIterType inputVectorVolumeIter(inputVectorVolume, outputRegionForThread);
-    OutputVolumeIterType ktransVolumeIter(this->GetKTransOutput(), outputRegionForThread);
-    OutputVolumeIterType veVolumeIter(this->GetVEOutput(), outputRegionForThread);
-    typename VectorVolumeType::Pointer fitted = this->GetFittedDataOutput();
-    VectorVolumeIterType fittedVolumeIter(fitted, outputRegionForThread);
-    OutputVolumeIterType diagVolumeIter(this->GetOptimizerDiagnosticsOutput(), outputRegionForThread);
+    OutputIterators outputIters(this, outputRegionForThread);
 
     MaskVolumeConstIterType roiMaskVolumeIter;
     if (this->GetROIMask())
     {
       roiMaskVolumeIter = MaskVolumeConstIterType(this->GetROIMask(), outputRegionForThread);
     }
-
-    OutputVolumeIterType fpvVolumeIter;
-    if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
+    const OutputVolumeType* batMap = this->GetBATMap();
+    OutputVolumeConstIterType batMapVolumeIter;
+    if (batMap)
     {
-      fpvVolumeIter = OutputVolumeIterType(this->GetFPVOutput(), outputRegionForThread);
+      batMapVolumeIter = OutputVolumeConstIterType(batMap, outputRegionForThread);
     }
-    OutputVolumeIterType maxSlopeVolumeIter(this->GetMaxSlopeOutput(), outputRegionForThread);
-    OutputVolumeIterType aucVolumeIter(this->GetAUCOutput(), outputRegionForThread);
-    OutputVolumeIterType rsqVolumeIter(this->GetRSquaredOutput(), outputRegionForThread);
-    OutputVolumeIterType batVolumeIter(this->GetBATOutput(), outputRegionForThread);
-
-    //set up optimizer and cost function
-    itk::LevenbergMarquardtOptimizer::Pointer optimizer = itk::LevenbergMarquardtOptimizer::New();
-    LMCostFunction::Pointer                   costFunction = LMCostFunction::New();
-    int timeSize = (int)inputVectorVolume->GetNumberOfComponentsPerPixel();
-
-    std::vector<float> timeMinute;
-    timeMinute = m_Timing;
-    for (unsigned int i = 0; i < timeMinute.size(); i++)
+    const MaskVolumeType* aifRegionMap = this->GetAIFRegionMap();
+    MaskVolumeConstIterType aifRegionMapVolumeIter;
+    if (aifRegionMap)
     {
-      timeMinute[i] = m_Timing[i] / 60.0;
+      aifRegionMapVolumeIter = MaskVolumeConstIterType(aifRegionMap, outputRegionForThread);
     }
 
     ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
 
-    VectorVoxelType shiftedVectorVoxel(timeSize);
-    int shift;
-    unsigned int shiftStart = 0, shiftEnd = 0;
-    bool success = true;
-    while (!ktransVolumeIter.IsAtEnd())
-    {
-      success = true;
-      float optimizerErrorCode = -1;
-      tempKtrans = tempVe = tempFpv = tempMaxSlope = tempAUC = 0.0;
-      BATIndex = 0;
+    FitWorkspace workspace(timeSize);
+    VoxelResult result(this->GetAUCTimeIntervals().size());
 
-      if (!this->GetROIMask() || (this->GetROIMask() && roiMaskVolumeIter.Get()))
-      {
-        vectorVoxel = inputVectorVolumeIter.Get();
-        fittedVectorVoxel = inputVectorVolumeIter.Get();
-        // dump a specific voxel
-        // std::cout << "VectorVoxel = " << vectorVoxel;
+    // The curves are gathered in chunks, the BATs of a chunk are estimated
+    // in one call
+    CurveChunk chunk(timeSize);
+    // AIF context of each voxel of the chunk, NULL outside of the ROI
+    std::vector<const AIFContext*> aifs(CurveChunk::DefaultSize);
 
-        // Compute the bolus arrival time and the max slope parameter
-        if (success)
+    while (!inputVectorVolumeIter.IsAtEnd())
+    {
+      chunk.Clear();
+      while (!chunk.IsFull() && !inputVectorVolumeIter.IsAtEnd())
+      {
+        const unsigned int voxel = chunk.GetNumberOfVoxels();
+        aifs[voxel] = NULL;
+        if (!this->GetROIMask() || roiMaskVolumeIter.Get())
         {
-          try {
-            BATIndex = m_batEstimator->getBATIndex(timeSize, &vectorVoxel[0], &tempMaxSlope);
-          }
-          catch (...)
+          aifs[voxel] = aifRegionMap ? &this->GetAIFContext(aifRegionMapVolumeIter.Get()) : &this->GetAIFContext();
+          const unsigned int curve = chunk.AddCurve(inputVectorVolumeIter.Get());
+          if (batMap)
           {
-            success = false;
-            optimizerErrorCode = BAT_DETECTION_FAILED;
+            chunk.BATIndex(curve) = static_cast<int>(batMapVolumeIter.Get());
           }
         }
-
-
-        // Shift the current time course to align with the BAT of the AIF
-        // (note the sense of the shift)
-        if (success)
+        else
         {
-          batVolumeIter.Set(BATIndex);
-          shift = m_AIFBATIndex - BATIndex;
-          shiftedVectorVoxel.Fill(0.0);
-          if (shift <= 0)
-          {
-            // AIF BAT before current BAT, should always be the case
-            shiftStart = 0;
-            shiftEnd = vectorVoxel.Size() + shift;
-          }
-          else
-          {
-            success = false;
-            optimizerErrorCode = BAT_BEFORE_AIF_BAT;
-          }
+          chunk.Skip();
         }
-        if (success)
+        ++inputVectorVolumeIter;
+        if (this->GetROIMask())
         {
-          for (unsigned int i = shiftStart; i < shiftEnd; ++i)
-          {
-            shiftedVectorVoxel[i] = vectorVoxel[i - shift];
-          }
+          ++roiMaskVolumeIter;
         }
-
-        // Calculate parameter ktrans, ve, and fpv
-        double rSquared = 0.0;
-        if (success)
+        if (batMap)
         {
-          optimizerErrorCode = pk_solver(timeSize, &timeMinute[0],
-            const_cast<float *>(shiftedVectorVoxel.GetDataPointer()),
-            &m_AIF[0],
-            tempKtrans, tempVe, tempFpv,
-            m_fTol, m_gTol, m_xTol,
-            m_epsilon, m_maxIter, m_hematocrit,
-            optimizer, costFunction, m_ModelType, m_batEstimator);
-
-          itk::LMCostFunction::ParametersType param(3);
-          param[0] = tempKtrans; param[1] = tempVe;
-          if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
-          {
-            param[2] = tempFpv;
-          }
-          itk::LMCostFunction::MeasureType measure =
-            costFunction->GetFittedFunction(param);
-          for (size_t i = 0; i < fittedVectorVoxel.GetSize(); i++)
-          {
-            fittedVectorVoxel[i] = measure[i];
-          }
-
-          // Shift the current time course to align with the BAT of the AIF
-          // (note the sense of the shift)
-          shiftedVectorVoxel.Fill(0.0);
-          if (shift <= 0)
-          {
-            // AIF BAT before current BAT, should always be the case
-            shiftStart = shift*-1.;
-            shiftEnd = vectorVoxel.Size();
-            for (unsigned int i = shiftStart; i < shiftEnd; ++i)
-            {
-              shiftedVectorVoxel[i] = fittedVectorVoxel[i + shift];
-            }
-          }
-
-          fittedVolumeIter.Set(shiftedVectorVoxel);
-
-          // Only keep the estimated values if the optimization produced a good answer
-          // Check R-squared:
-          //   R2 = 1 - SSerr / SStot
-          // where
-          //   SSerr = \sum (y_i - f_i)^2
-          //   SStot = \sum (y_i - \bar{y})^2
-          //
-          // Note: R-squared is not a good metric for nonlinear function
-          // fitting. R-squared values are not bound between [0,1] when
-          // fitting nonlinear functions.
-
-          // SSerr we can get easily from the optimizer
-          double rms = optimizer->GetOptimizer()->get_end_error();
-          double SSerr = rms*rms*shiftedVectorVoxel.GetSize();
-
-          // if we couldn't get rms from the optimizer, we would calculate SSerr ourselves
-          // LMCostFunction::MeasureType residuals = costFunction->GetValue(optimizer->GetCurrentPosition());
-          // double SSerr = 0.0;
-          // for (unsigned int i=0; i < residuals.size(); ++i)
-          //   {
-          //   SSerr += (residuals[i]*residuals[i]);
-          //   }
-
-          // SStot we need to calculate
-          double sumSquared = 0.0;
-          double sum = 0.0;
-          for (unsigned int i = 0; i < shiftedVectorVoxel.GetSize(); ++i)
-          {
-            sum += shiftedVectorVoxel[i];
-            sumSquared += (shiftedVectorVoxel[i] * shiftedVectorVoxel[i]);
-          }
-          double SStot = sumSquared - sum*sum / (double)shiftedVectorVoxel.GetSize();
-
-          rSquared = 1.0 - (SSerr / SStot);
-
-          /*
-          double rSquaredThreshold = 0.15;
-          if (rSquared < rSquaredThreshold)
-          {
-          success = false;
-          }
-          */
+          ++batMapVolumeIter;
         }
-        // Calculate parameter AUC, normalized by AIF AUC
-        if (success)
+        if (aifRegionMap)
         {
-          tempAUC =
-            (area_under_curve(timeSize, &m_Timing[0], const_cast<float *>(shiftedVectorVoxel.GetDataPointer()), BATIndex, m_AUCTimeInterval)) / m_aifAUC;
+          ++aifRegionMapVolumeIter;
         }
+      }
+      this->EstimateBATs(chunk, batMap != NULL);
 
-        // If we were successful, save the estimated values, otherwise
-        // default to zero
-        if (success)
+      for (unsigned int i = 0; i < chunk.GetNumberOfVoxels(); ++i)
+      {
+        result.Reset();
+        const int curve = chunk.GetCurveIndex(i);
+        if (curve >= 0)
         {
-          ktransVolumeIter.Set(static_cast<OutputVolumePixelType>(tempKtrans));
-          veVolumeIter.Set(static_cast<OutputVolumePixelType>(tempVe));
-          maxSlopeVolumeIter.Set(static_cast<OutputVolumePixelType>(tempMaxSlope));
-          aucVolumeIter.Set(static_cast<OutputVolumePixelType>(tempAUC));
-          if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
-          {
-            fpvVolumeIter.Set(static_cast<OutputVolumePixelType>(tempFpv));
-          }
+          this->QuantifyVoxel(chunk.GetCurve(curve), chunk.BATIndex(curve), chunk.GetBATPosition(curve),
+                              chunk.GetMaxSlope(curve), *aifs[i], workspace, result);
         }
         else
         {
-          ktransVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
-          veVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
-          maxSlopeVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
-          aucVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
+          workspace.shiftedVectorVoxel.Fill(0.0);
+        }
+        outputIters.Set(result, workspace.shiftedVectorVoxel);
+        ++outputIters;
 
-          batVolumeIter.Set(-1);
-          rsqVolumeIter.Set(0.0);
-          shiftedVectorVoxel.Fill(0.0);
-          fittedVolumeIter.Set(shiftedVectorVoxel);
+        progress.CompletedPixel();
+      }
+    }
+  }
 
-        }
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  bool
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::SemiQuantifyVoxel(const float* vectorVoxel, int BATIndex, float maxSlope, const AIFContext& aif,
+                        FitWorkspace& workspace, VoxelResult& result) const
+  {
+    const int timeSize = (int)workspace.shiftedVectorVoxel.GetSize();
+    result.Reset();
+    workspace.shiftedVectorVoxel.Fill(0.0);
+    if (BATIndex < 0)
+    {
+      result.optimizerErrorCode = BAT_DETECTION_FAILED;
+      return false;
+    }
+
+    if (this->IsCurveShapeComputed())
+    {
+      this->ComputeCurveShape(vectorVoxel, BATIndex, result);
+    }
 
-        // RSquared output volume is always written
-        rsqVolumeIter.Set(rSquared);
+    // AUC of the measured concentration curve, normalized by AIF AUC. The
+    // fit computes it on the fitted curve instead, see QuantifyVoxel.
+    cumulative_area_under_curve(timeSize, &m_Timing[0], vectorVoxel, &workspace.cumulativeArea[0]);
+    for (std::size_t i = 0; i < m_AUCTimeIntervals.size(); ++i)
+    {
+      result.auc[i] =
+        (area_under_curve(timeSize, &m_Timing[0], vectorVoxel, &workspace.cumulativeArea[0],
+                          BATIndex, m_AUCTimeIntervals[i])) / aif.AUC[i];
+    }
+
+    result.maxSlope = maxSlope;
+    result.bat = BATIndex;
+    return true;
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::ComputeCurveShape(const float* vectorVoxel, int BATIndex, VoxelResult& result) const
+  {
+    compute_curve_shape((int)m_Timing.size(), &m_Timing[0], vectorVoxel, BATIndex,
+                        result.timeToPeak, result.peakEnhancement, result.washoutSlope);
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::EstimateBATs(CurveChunk& chunk, bool hasBATIndices) const
+  {
+    if (hasBATIndices)
+    {
+      chunk.EstimateMaxSlopes(m_batEstimator);
+    }
+    else if (m_AIFShiftsPerFrame > 0 && !m_SemiQuantitativeOnly)
+    {
+      chunk.EstimateBATPositions(m_batEstimator);
+    }
+    else
+    {
+      chunk.EstimateBATs(m_batEstimator);
+    }
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  bool
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::QuantifyVoxel(const float* vectorVoxel, int BATIndex, float BATPosition, float maxSlope,
+                    const AIFContext& aif, FitWorkspace& workspace, VoxelResult& result) const
+  {
+    if (BATIndex < 0)
+    {
+      result.Reset();
+      result.optimizerErrorCode = BAT_DETECTION_FAILED;
+      workspace.shiftedVectorVoxel.Fill(0.0);
+      return false;
+    }
+    if (m_SemiQuantitativeOnly)
+    {
+      return this->SemiQuantifyVoxel(vectorVoxel, BATIndex, maxSlope, aif, workspace, result);
+    }
+    return this->FitShiftedVoxel(vectorVoxel, BATIndex, BATPosition, maxSlope, aif, workspace, result);
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  bool
+    ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::FitShiftedVoxel(const float* vectorVoxel, int BATIndex, float BATPosition, float tempMaxSlope, const AIFContext& aif,
+                      FitWorkspace& workspace, VoxelResult& result) const
+  {
+    VectorVoxelType& shiftedVectorVoxel = workspace.shiftedVectorVoxel;
+    VectorVoxelType& fittedVectorVoxel = workspace.fittedVectorVoxel;
+    const int timeSize = (int)shiftedVectorVoxel.GetSize();
+
+    float tempFpv = 0.0f;
+    float tempKtrans = 0.0f;
+    float tempVe = 0.0f;
+    unsigned int shiftStart = 0, shiftEnd = 0;
+    result.Reset();
+    if (this->IsCurveShapeComputed())
+    {
+      this->ComputeCurveShape(vectorVoxel, BATIndex, result);
+    }
+
+    const float* concentration = vectorVoxel;
+    const float* aifCurve = &aif.AIF[0];
+    const ParkerAIFModel* analyticAIF = aif.AnalyticAIF.get();
+    int shift = 0;
+    if (!aif.ShiftedAIFs.empty())
+    {
+      // Delay the AIF to the BAT of the voxel with the nearest AIF of the
+      // bank, the voxel and its fitted curve then stay where they are
+      const double delayMinute = this->GetTimeMinuteAt(BATPosition) - aif.BATTime;
+      const int bankIndex = static_cast<int>(floor(delayMinute / aif.ShiftStep + 0.5));
+      if (bankIndex < 0)
+      {
+        shiftedVectorVoxel.Fill(0.0);
+        result.optimizerErrorCode = BAT_BEFORE_AIF_BAT;
+        return false;
       }
-      else
+      const std::size_t delay = std::min(static_cast<std::size_t>(bankIndex), aif.ShiftedAIFs.size() - 1);
+      aifCurve = &aif.ShiftedAIFs[delay][0];
+      if (analyticAIF)
+      {
+        analyticAIF = aif.ShiftedAnalyticAIFs[delay].get();
+      }
+    }
+    else
+    {
+      // Shift the current time course to align with the BAT of the AIF
+      // (note the sense of the shift)
+      shift = aif.BATIndex - BATIndex;
+      shiftedVectorVoxel.Fill(0.0);
+      if (shift > 0)
       {
-        ktransVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
-        veVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
-        maxSlopeVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
-        aucVolumeIter.Set(static_cast<OutputVolumePixelType>(0));
+        result.optimizerErrorCode = BAT_BEFORE_AIF_BAT;
+        return false;
+      }
+      // AIF BAT before current BAT, should always be the case
+      shiftStart = 0;
+      shiftEnd = timeSize + shift;
 
-        batVolumeIter.Set(-1);
-        rsqVolumeIter.Set(0.0);
-        shiftedVectorVoxel.Fill(0.0);
-        fittedVolumeIter.Set(shiftedVectorVoxel);
+      for (unsigned int i = shiftStart; i < shiftEnd; ++i)
+      {
+        shiftedVectorVoxel[i] = vectorVoxel[i - shift];
       }
+      concentration = shiftedVectorVoxel.GetDataPointer();
+    }
 
-      ++ktransVolumeIter;
-      ++veVolumeIter;
-      ++maxSlopeVolumeIter;
-      ++aucVolumeIter;
-      ++rsqVolumeIter;
-      ++batVolumeIter;
-      ++inputVectorVolumeIter;
-      ++fittedVolumeIter;
+    // Calculate parameter ktrans, ve, and fpv
+    result.optimizerErrorCode = pk_solver(timeSize, &m_TimeMinute[0],
+      concentration,
+      aifCurve,
+      tempKtrans, tempVe, tempFpv,
+      m_fTol, m_gTol, m_xTol,
+      m_epsilon, m_maxIter, m_hematocrit,
+      workspace.optimizer, workspace.costFunction, m_ModelType, m_batEstimator,
+      analyticAIF);
 
-      if (this->GetROIMask())
+    itk::LMCostFunction::ParametersType param(3);
+    param[0] = tempKtrans; param[1] = tempVe;
+    if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
+    {
+      param[2] = tempFpv;
+    }
+    itk::LMCostFunction::MeasureType measure =
+      workspace.costFunction->GetFittedFunction(param);
+
+    if (!aif.ShiftedAIFs.empty())
+    {
+      // Fitted with the delayed AIF, already aligned with the voxel
+      for (int i = 0; i < timeSize; i++)
       {
-        ++roiMaskVolumeIter;
+        shiftedVectorVoxel[i] = measure[i];
+      }
+    }
+    else
+    {
+      for (int i = 0; i < timeSize; i++)
+      {
+        fittedVectorVoxel[i] = measure[i];
       }
 
-      if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
+      // Shift the fitted time course back to align with the BAT of the voxel
+      // (note the sense of the shift)
+      shiftedVectorVoxel.Fill(0.0);
+      shiftStart = shift*-1.;
+      shiftEnd = timeSize;
+      for (unsigned int i = shiftStart; i < shiftEnd; ++i)
       {
-        ++fpvVolumeIter;
+        shiftedVectorVoxel[i] = fittedVectorVoxel[i + shift];
       }
+    }
+
+    // Check R-squared:
+    //   R2 = 1 - SSerr / SStot
+    // where
+    //   SSerr = \sum (y_i - f_i)^2
+    //   SStot = \sum (y_i - \bar{y})^2
+    //
+    // Note: R-squared is not a good metric for nonlinear function
+    // fitting. R-squared values are not bound between [0,1] when
+    // fitting nonlinear functions.
+
+    // SSerr we can get easily from the optimizer
+    double rms = workspace.optimizer->GetOptimizer()->get_end_error();
+    double SSerr = rms*rms*timeSize;
+
+    // SStot we need to calculate
+    double sumSquared = 0.0;
+    double sum = 0.0;
+    for (int i = 0; i < timeSize; ++i)
+    {
+      sum += shiftedVectorVoxel[i];
+      sumSquared += (shiftedVectorVoxel[i] * shiftedVectorVoxel[i]);
+    }
+    double SStot = sumSquared - sum*sum / (double)timeSize;
+
+    result.rSquared = 1.0 - (SSerr / SStot);
+
+    // Calculate parameter AUC, normalized by AIF AUC, for every interval
+    // from one cumulative integral of the curve
+    cumulative_area_under_curve(timeSize, &m_Timing[0], shiftedVectorVoxel.GetDataPointer(), &workspace.cumulativeArea[0]);
+    for (std::size_t i = 0; i < m_AUCTimeIntervals.size(); ++i)
+    {
+      result.auc[i] =
+        (area_under_curve(timeSize, &m_Timing[0], shiftedVectorVoxel.GetDataPointer(), &workspace.cumulativeArea[0],
+                          BATIndex, m_AUCTimeIntervals[i])) / aif.AUC[i];
+    }
+
+    result.ktrans = tempKtrans;
+    result.ve = tempVe;
+    result.maxSlope = tempMaxSlope;
+    result.bat = aif.ShiftedAIFs.empty() ? static_cast<float>(BATIndex) : BATPosition;
+    if (m_ModelType == itk::LMCostFunction::TOFTS_3_PARAMETER)
+    {
+      result.fpv = tempFpv;
+    }
+    return true;
+  }
 
-      diagVolumeIter.Set(static_cast<OutputVolumePixelType>(optimizerErrorCode));
-      ++diagVolumeIter;
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::SetAUCTimeInterval(float interval)
+  {
+    this->SetAUCTimeIntervals(std::vector<float>(1, interval));
+  }
 
-      progress.CompletedPixel();
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  float ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::GetAUCTimeInterval() const
+  {
+    return m_AUCTimeIntervals[0];
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::SetAUCTimeIntervals(const std::vector<float>& intervals)
+  {
+    if (intervals.empty())
+    {
+      itkExceptionMacro(<< "At least one AUC time interval is needed");
     }
+    if (intervals == m_AUCTimeIntervals)
+    {
+      return;
+    }
+    m_AUCTimeIntervals = intervals;
+
+    // One additional output per additional interval, after the fixed outputs
+    const DataObjectPointerArraySizeType first = this->GetNumberOfFixedOutputs();
+#if ITK_VERSION_MAJOR < 4
+    this->SetNumberOfOutputs(first + intervals.size() - 1);
+#else
+    this->SetNumberOfIndexedOutputs(first + intervals.size() - 1);
+#endif
+    for (unsigned int i = 1; i < intervals.size(); ++i)
+    {
+      this->Superclass::SetNthOutput(first + i - 1,
+        static_cast<TOutputImage*>(this->MakeOutput(first + i - 1).GetPointer()));
+    }
+    this->Modified();
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  const std::vector<float>& ConcentrationToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::GetAUCTimeIntervals() const
+  {
+    return m_AUCTimeIntervals;
   }
 
   template <class TInputImage, class TMaskImage, class TOutputImage>
@@ -489,6 +1079,8 @@ namespace itk
     os << indent << "Epsilon: " << m_epsilon << std::endl;
     os << indent << "Maximum number of iterations: " << m_maxIter << std::endl;
     os << indent << "Hematocrit: " << m_hematocrit << std::endl;
+    os << indent << "Compute parameter maps: " << m_ComputeParameterMaps << std::endl;
+    os << indent << "Compute curve shape maps: " << m_ComputeCurveShapeMaps << std::endl;
   }
 
 } // end namespace itk
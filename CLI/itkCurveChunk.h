@@ -0,0 +1,255 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $CurveChunk: itkCurveChunk.h $
+  Language:  C++
+
+  =========================================================================*/
+#ifndef __itkCurveChunk_h
+#define __itkCurveChunk_h
+
+#include "itkImageRegionConstIterator.h"
+#include "BAT/BolusArrivalTimeEstimator.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+  /** \class CurveChunk
+   * \brief Gathers the curves of a run of voxels, so that the bolus arrival
+   * times of all of them are estimated in one call.
+   *
+   * A thread walks its region in chunks: every voxel is either added with
+   * its curve, which is cast to floats, or skipped. Once the chunk is full
+   * or the region ends, one of the Estimate methods fills the BAT index,
+   * position and max slope of every gathered curve, and the voxels are
+   * visited again in the same order to write the outputs.
+   */
+  class CurveChunk
+  {
+  public:
+    static const unsigned int DefaultSize = 256;
+
+    CurveChunk(unsigned int timeSize, unsigned int size = DefaultSize)
+      : m_TimeSize(timeSize),
+        m_Size(size),
+        m_NumberOfVoxels(0),
+        m_NumberOfCurves(0),
+        m_Curves(size * timeSize),
+        m_CurveOfVoxel(size),
+        m_BATIndices(size),
+        m_BATPositions(size),
+        m_MaxSlopes(size),
+        m_EstimatedIndices(size)
+    {
+    }
+
+    //! Starts a new chunk.
+    void Clear()
+    {
+      m_NumberOfVoxels = 0;
+      m_NumberOfCurves = 0;
+    }
+
+    bool IsFull() const
+    {
+      return m_NumberOfVoxels == m_Size;
+    }
+
+    //! Adds a voxel and copies its curve, returns the index of the curve.
+    template <class TPixel>
+    unsigned int AddCurve(const TPixel& pixel)
+    {
+      float* curve = &m_Curves[m_NumberOfCurves * m_TimeSize];
+      for (unsigned int i = 0; i < m_TimeSize; ++i)
+      {
+        curve[i] = static_cast<float>(pixel[i]);
+      }
+      return this->AddCurve();
+    }
+
+    //! Adds a voxel whose curve the caller fills in through GetCurve().
+    unsigned int AddCurve()
+    {
+      m_CurveOfVoxel[m_NumberOfVoxels++] = static_cast<int>(m_NumberOfCurves);
+      return m_NumberOfCurves++;
+    }
+
+    //! Adds a voxel without a curve.
+    void Skip()
+    {
+      m_CurveOfVoxel[m_NumberOfVoxels++] = -1;
+    }
+
+    unsigned int GetNumberOfVoxels() const
+    {
+      return m_NumberOfVoxels;
+    }
+
+    unsigned int GetNumberOfCurves() const
+    {
+      return m_NumberOfCurves;
+    }
+
+    //! Index of the curve of the voxel, -1 if the voxel was skipped.
+    int GetCurveIndex(unsigned int voxel) const
+    {
+      return m_CurveOfVoxel[voxel];
+    }
+
+    float* GetCurve(unsigned int curve)
+    {
+      return &m_Curves[curve * m_TimeSize];
+    }
+
+    //! Estimates the BAT of every curve, -1 (and a max slope of 0) where
+    //! detection fails. The positions are the indices.
+    void EstimateBATs(const BolusArrivalTime::BolusArrivalTimeEstimator* estimator)
+    {
+      if (m_NumberOfCurves == 0)
+      {
+        return;
+      }
+      try {
+        estimator->getBATIndices((int)m_TimeSize, (int)m_NumberOfCurves, m_TimeSize, &m_Curves[0],
+                                 &m_BATIndices[0], &m_MaxSlopes[0]);
+      }
+      catch (...)
+      {
+        this->SetFailed(m_BATIndices);
+      }
+      std::copy(m_BATIndices.begin(), m_BATIndices.begin() + m_NumberOfCurves, m_BATPositions.begin());
+    }
+
+    //! Same as EstimateBATs(), with the fractional BAT positions.
+    void EstimateBATPositions(const BolusArrivalTime::BolusArrivalTimeEstimator* estimator)
+    {
+      if (m_NumberOfCurves == 0)
+      {
+        return;
+      }
+      try {
+        estimator->getBATPositions((int)m_TimeSize, (int)m_NumberOfCurves, m_TimeSize, &m_Curves[0],
+                                   &m_BATIndices[0], &m_BATPositions[0], &m_MaxSlopes[0]);
+      }
+      catch (...)
+      {
+        this->SetFailed(m_BATIndices);
+        std::copy(m_BATIndices.begin(), m_BATIndices.begin() + m_NumberOfCurves, m_BATPositions.begin());
+      }
+    }
+
+    //! Estimates only the max slopes, for BAT indices that were set from a
+    //! BAT map. The positions are the indices.
+    void EstimateMaxSlopes(const BolusArrivalTime::BolusArrivalTimeEstimator* estimator)
+    {
+      if (m_NumberOfCurves == 0)
+      {
+        return;
+      }
+      try {
+        estimator->getBATIndices((int)m_TimeSize, (int)m_NumberOfCurves, m_TimeSize, &m_Curves[0],
+                                 &m_EstimatedIndices[0], &m_MaxSlopes[0]);
+      }
+      catch (...)
+      {
+        this->SetFailed(m_EstimatedIndices);
+      }
+      std::copy(m_BATIndices.begin(), m_BATIndices.begin() + m_NumberOfCurves, m_BATPositions.begin());
+    }
+
+    //! BAT index of the curve, can also be set from a BAT map instead.
+    int& BATIndex(unsigned int curve)
+    {
+      return m_BATIndices[curve];
+    }
+
+    float GetBATPosition(unsigned int curve) const
+    {
+      return m_BATPositions[curve];
+    }
+
+    float GetMaxSlope(unsigned int curve) const
+    {
+      return m_MaxSlopes[curve];
+    }
+
+  private:
+    const unsigned int m_TimeSize;
+    const unsigned int m_Size;
+    unsigned int m_NumberOfVoxels;
+    unsigned int m_NumberOfCurves;
+    std::vector<float> m_Curves;
+    std::vector<int> m_CurveOfVoxel;
+    std::vector<int> m_BATIndices;
+    std::vector<float> m_BATPositions;
+    std::vector<float> m_MaxSlopes;
+    // Indices estimated along with the max slopes of EstimateMaxSlopes(), discarded
+    std::vector<int> m_EstimatedIndices;
+
+    void SetFailed(std::vector<int>& indices)
+    {
+      std::fill(indices.begin(), indices.begin() + m_NumberOfCurves, -1);
+      std::fill(m_MaxSlopes.begin(), m_MaxSlopes.begin() + m_NumberOfCurves, 0.0f);
+    }
+  };
+
+  /** \class ROIOrAIFMaskIterator
+   * \brief Walks the optional ROI and AIF masks of a region, in lockstep with
+   * the image iterators of that region.
+   *
+   * Get() is true for the voxels inside of either mask, and for every voxel
+   * if there is no ROI mask. Masks without a buffer are treated like no mask
+   * at all.
+   */
+  template <class TMaskImage>
+  class ROIOrAIFMaskIterator
+  {
+  public:
+    typedef TMaskImage                                   MaskImageType;
+    typedef typename MaskImageType::RegionType           RegionType;
+    typedef itk::ImageRegionConstIterator<MaskImageType> MaskConstIterType;
+
+    ROIOrAIFMaskIterator(const MaskImageType* roiMask, const MaskImageType* aifMask, const RegionType& region)
+      : m_hasRoiMask(roiMask && roiMask->GetBufferedRegion().GetSize()[0] != 0),
+        m_hasAifMask(aifMask && aifMask->GetBufferedRegion().GetSize()[0] != 0)
+    {
+      if (m_hasRoiMask)
+      {
+        m_roiMaskVolumeIter = MaskConstIterType(roiMask, region);
+      }
+      if (m_hasAifMask)
+      {
+        m_aifMaskVolumeIter = MaskConstIterType(aifMask, region);
+      }
+    }
+
+    bool Get() const
+    {
+      return !m_hasRoiMask || m_roiMaskVolumeIter.Get() || (m_hasAifMask && m_aifMaskVolumeIter.Get());
+    }
+
+    ROIOrAIFMaskIterator& operator++()
+    {
+      if (m_hasRoiMask)
+      {
+        ++m_roiMaskVolumeIter;
+      }
+      if (m_hasAifMask)
+      {
+        ++m_aifMaskVolumeIter;
+      }
+      return *this;
+    }
+
+  private:
+    MaskConstIterType m_roiMaskVolumeIter;
+    MaskConstIterType m_aifMaskVolumeIter;
+    const bool m_hasRoiMask;
+    const bool m_hasAifMask;
+  };
+
+}; // end namespace itk
+
+#endif
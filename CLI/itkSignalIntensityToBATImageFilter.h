@@ -0,0 +1,119 @@
+/*=========================================================================
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $SignalIntensityToBATImageFilter: itkSignalIntensityToBATImageFilter.h$
+  Language:  C++
+  =========================================================================*/
+#ifndef __itkSignalIntensityToBATImageFilter_h
+#define __itkSignalIntensityToBATImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkImage.h"
+#include "itkVectorImage.h"
+#include "itkImageRegionIterator.h"
+#include "itkCurveChunk.h"
+#include "PkSolver.h"
+
+#include <vector>
+
+namespace itk
+{
+  /** \class SignalIntensityToBATImageFilter
+   * \brief Estimates the bolus arrival time index of each signal intensity curve.
+   *
+   * The resulting map can be shared by S0 estimation and the model fit, so
+   * BAT is only estimated once per voxel. Voxels where detection failed, and
+   * voxels outside of the optional ROI and AIF masks, are set to -1.
+   */
+  template <class TInputImage, class TOutputImage, class TMaskImage = itk::Image<unsigned short, TInputImage::ImageDimension> >
+  class SignalIntensityToBATImageFilter : public ImageToImageFilter < TInputImage, TOutputImage >
+  {
+  public:
+    /** Convenient typedefs for simplifying declarations. */
+    typedef TInputImage                                   InputImageType;
+    typedef typename InputImageType::PixelType            InputPixelType;
+    typedef itk::ImageRegionConstIterator<InputImageType> InputImageConstIterType;
+
+    typedef TOutputImage                              OutputImageType;
+    typedef typename OutputImageType::PixelType       OutputPixelType;
+    typedef typename OutputImageType::RegionType      OutputImageRegionType;
+    typedef itk::ImageRegionIterator<OutputImageType> OutputImageIterType;
+
+    typedef TMaskImage                                   InputMaskType;
+    typedef itk::ImageRegionConstIterator<InputMaskType> InputMaskConstIterType;
+
+    /** Standard class typedefs. */
+    typedef SignalIntensityToBATImageFilter                      Self;
+    typedef ImageToImageFilter<InputImageType, OutputImageType> Superclass;
+    typedef SmartPointer<Self>                                  Pointer;
+    typedef SmartPointer<const Self>                            ConstPointer;
+
+    /** Method for creation through the object factory. */
+    itkNewMacro(Self);
+
+    /** Run-time type information (and related methods). */
+    itkTypeMacro(SignalIntensityToBATImageFilter, ImageToImageFilter);
+
+    void SetBatEstimator(const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
+    {
+      m_batEstimator = batEstimator;
+    }
+
+    const BolusArrivalTime::BolusArrivalTimeEstimator* GetBatEstimator() const
+    {
+      return this->m_batEstimator;
+    }
+
+    // Set a mask image for specifying the location of the arterial
+    // input function. BAT is always estimated for voxels under this mask.
+    void SetAIFMask(const InputMaskType* aifMaskVolume)
+    {
+      this->SetNthInput(1, const_cast<InputMaskType*>(aifMaskVolume));
+    }
+
+    // Get the mask image assigned as the arterial input function
+    const InputMaskType* GetAIFMask() const
+    {
+      return dynamic_cast<const InputMaskType*>(this->ProcessObject::GetInput(1));
+    }
+
+    // Set a mask image for specifying the location of voxels for model fit.
+    // If set, BAT is not estimated for voxels outside of it (and the AIF mask).
+    void SetROIMask(const InputMaskType* roiMaskVolume)
+    {
+      this->SetNthInput(2, const_cast<InputMaskType*>(roiMaskVolume));
+    }
+
+    // Get the mask image specifying the location of voxels for model fit.
+    const InputMaskType* GetROIMask() const
+    {
+      return dynamic_cast<const InputMaskType*>(this->ProcessObject::GetInput(2));
+    }
+
+  protected:
+    SignalIntensityToBATImageFilter();
+    virtual ~SignalIntensityToBATImageFilter()
+    {
+    }
+
+#if ITK_VERSION_MAJOR < 4
+    void ThreadedGenerateData( const OutputImageRegionType& outputRegionForThread, int threadId );
+
+#else
+    void ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread,
+      ThreadIdType threadId);
+
+#endif
+  private:
+    SignalIntensityToBATImageFilter(const Self &); // purposely not implemented
+    void operator=(const Self &);      // purposely not implemented
+
+    const BolusArrivalTime::BolusArrivalTimeEstimator* m_batEstimator;
+  };
+
+}; // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSignalIntensityToBATImageFilter.hxx"
+#endif
+
+#endif
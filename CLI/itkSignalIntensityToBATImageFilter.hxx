@@ -0,0 +1,62 @@
+#ifndef _itkSignalIntensityToBATImageFilter_hxx
+#define _itkSignalIntensityToBATImageFilter_hxx
+
+#include "itkSignalIntensityToBATImageFilter.h"
+
+namespace itk
+{
+
+  template <class TInputImage, class TOutputImage, class TMaskImage>
+  SignalIntensityToBATImageFilter<TInputImage, TOutputImage, TMaskImage>::SignalIntensityToBATImageFilter()
+  {
+    m_batEstimator = NULL;
+  }
+
+  template <class TInputImage, class TOutputImage, class TMaskImage>
+  void SignalIntensityToBATImageFilter<TInputImage, TOutputImage, TMaskImage>
+#if ITK_VERSION_MAJOR < 4
+    ::ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread, int itkNotUsed(threadId) )
+#else
+    ::ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread, ThreadIdType itkNotUsed(threadId))
+#endif
+  {
+    const InputImageType* inputVectorVolume = this->GetInput();
+    const unsigned int timeSize = inputVectorVolume->GetNumberOfComponentsPerPixel();
+
+    InputImageConstIterType inputVectorVolumeIter(inputVectorVolume, outputRegionForThread);
+    OutputImageIterType batVolumeIter(this->GetOutput(), outputRegionForThread);
+
+    ROIOrAIFMaskIterator<InputMaskType> needsBATIter(this->GetROIMask(), this->GetAIFMask(), outputRegionForThread);
+
+    // The curves are gathered in chunks, the BATs of a chunk are estimated
+    // in one call
+    CurveChunk chunk(timeSize);
+    while (!inputVectorVolumeIter.IsAtEnd())
+    {
+      chunk.Clear();
+      for (; !chunk.IsFull() && !inputVectorVolumeIter.IsAtEnd(); ++inputVectorVolumeIter, ++needsBATIter)
+      {
+        if (needsBATIter.Get())
+        {
+          chunk.AddCurve(inputVectorVolumeIter.Get());
+        }
+        else
+        {
+          chunk.Skip();
+        }
+      }
+      chunk.EstimateBATs(m_batEstimator);
+
+      for (unsigned int i = 0; i < chunk.GetNumberOfVoxels(); ++i)
+      {
+        const int curve = chunk.GetCurveIndex(i);
+        const int BATIndex = curve < 0 ? -1 : chunk.BATIndex(curve);
+        batVolumeIter.Set(static_cast<OutputPixelType>(BATIndex));
+        ++batVolumeIter;
+      }
+    }
+  }
+
+} // end namespace itk
+
+#endif
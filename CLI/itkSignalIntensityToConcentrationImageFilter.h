@@ -16,6 +16,7 @@
 #include "itkExtractImageFilter.h"
 #include "itkImageRegionIterator.h"
 #include "itkSignalIntensityToS0ImageFilter.h"
+#include "itkT1PreValueMapper.h"
 #include "itkImageFileWriter.h"
 
 #include "PkSolver.h"
@@ -54,6 +55,7 @@ namespace itk
 
     typedef TMaskImage                              InputMaskType;
     typedef itk::ImageRegionConstIterator<InputMaskType> InputMaskConstIterType;
+    typedef itk::T1PreValueMapper<InputMaskType>         T1PreValueMapperType;
 
     typedef TOutputImage                           OutputImageType;
     typedef typename OutputImageType::Pointer      OutputImagePointer;
@@ -67,6 +69,7 @@ namespace itk
     typedef itk::Image<FloatPixelType, TInputImage::ImageDimension> InternalVolumeType;
     typedef typename InternalVolumeType::Pointer         InternalVolumePointerType;
     typedef itk::ImageRegionIterator<InternalVolumeType> InternalVolumeIterType;
+    typedef itk::ImageRegionConstIterator<InternalVolumeType> InternalVolumeConstIterType;
     typedef typename InternalVolumeType::RegionType      InternalVolumeRegionType;
     typedef typename InternalVolumeType::SizeType        InternalVolumeSizeType;
 
@@ -152,6 +155,27 @@ namespace itk
       return dynamic_cast<const InputMaskType*>(this->ProcessObject::GetInput(3));
     }
 
+    // Set a map of bolus arrival time indices estimated on the signal, used
+    // for S0 estimation instead of the BAT estimator.
+    void SetBATMap(const InternalVolumeType* batMapVolume)
+    {
+      this->SetNthInput(4, const_cast<InternalVolumeType*>(batMapVolume));
+    }
+
+    const InternalVolumeType* GetBATMap() const
+    {
+      return dynamic_cast<const InternalVolumeType*>(this->ProcessObject::GetInput(4));
+    }
+
+    // Set a buffer the concentrations are written to instead of an
+    // allocated one, e.g. the memory mapped voxels of the output file. It
+    // has to hold the curves of all voxels and outlive the output.
+    void SetOutputBuffer(typename OutputImageType::InternalPixelType* buffer)
+    {
+      m_OutputBuffer = buffer;
+      this->Modified();
+    }
+
   protected:
     SignalIntensityToConcentrationImageFilter();
 
@@ -159,10 +183,23 @@ namespace itk
     {
     }
 
-    void GenerateData();
-    OutputImageType* GetAllocatedOutputVolume(const InputImageType* inputVectorVolume);
+    void AllocateOutputs();
+
+    void BeforeThreadedGenerateData();
+
+    /// Returns the converter for T1Pre, voxelConverter is a per thread
+    /// instance that is updated for T1Pre values from a T1 map.
+    const SignalToConcentrationConverter& GetConverter(float T1Pre, SignalToConcentrationConverter& voxelConverter) const;
+
+#if ITK_VERSION_MAJOR < 4
+    void ThreadedGenerateData( const OutputImageRegionType& outputRegionForThread, int threadId );
+
+#else
+    void ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread,
+      ThreadIdType threadId);
+
+#endif
     InternalVolumePointerType GetS0Image(const InputImageType* inputVectorVolume);
-    InternalVectorVoxelType convertToInternalVectorVoxel(const InputPixelType& inputVectorVoxel);
 
 
     void PrintSelf(std::ostream& os, Indent indent) const;
@@ -184,31 +221,14 @@ namespace itk
     float m_RGD_relaxivity;
     float m_S0GradThresh;
     const BolusArrivalTime::BolusArrivalTimeEstimator* m_batEstimator;
+    typename OutputImageType::InternalPixelType* m_OutputBuffer;
+
+    // S0 image computed before the threads start, shared read-only between them
+    InternalVolumePointerType m_S0Volume;
 
-    //! Private internal helper class to handle getting the correct T1Pre value.
-    //! Use it like an Iterator to walk through the voxel positions.
-    class T1PreValueMapper {
-    public:
-      //! Instantiate the Mapper by providing ROI mask, AIF mask, and/or T1 Map (all of which are optional and my be NULL if not available).
-      //! Also provide default constant Tissue and Blood value (these are required inputs).
-      T1PreValueMapper(const InputMaskType* roiMask, const InputMaskType* aifMask, const InputMaskType* t1Map, float t1PreTissue, float t1PreBlood);
-      virtual ~T1PreValueMapper();
-
-      //! Returns the T1Pre value for the current voxel position, based on the availability and validity of ROI/AIF mask and T1 Map at this position.
-      float Get();
-      void GoToBegin();
-      T1PreValueMapper& operator++();
-
-    private:
-      InputMaskConstIterType* getNewConstMaskIterOrNull(const InputMaskType* inMask);
-
-      InputMaskConstIterType* roiMaskVolumeIter;
-      InputMaskConstIterType* aifMaskVolumeIter;
-      InputMaskConstIterType* T1MapVolumeIter;
-      float m_T1PreTissue;
-      float m_T1PreBlood;
-
-    }; // end T1PreValueIterator class
+    // Conversion constants for the default tissue and blood T1Pre, shared read-only between threads
+    SignalToConcentrationConverter m_TissueConverter;
+    SignalToConcentrationConverter m_BloodConverter;
 
   };
 
@@ -15,49 +15,84 @@ SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>
   m_FA = 0.0f;
   m_RGD_relaxivity = 4.9E-3f;
   m_S0GradThresh = 15.0f;
+  m_OutputBuffer = NULL;
   this->SetNumberOfRequiredInputs(1);
 }
 
 
 template<class TInputImage, class TMaskImage, class TOutputImage>
-void SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::GenerateData()
+void SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::AllocateOutputs()
+{
+  if (!m_OutputBuffer)
+  {
+    Superclass::AllocateOutputs();
+    return;
+  }
+  OutputImageType* output = this->GetOutput();
+  output->SetBufferedRegion(output->GetRequestedRegion());
+  const std::size_t size = output->GetBufferedRegion().GetNumberOfPixels() * output->GetNumberOfComponentsPerPixel();
+  output->GetPixelContainer()->SetImportPointer(m_OutputBuffer, size, false);
+}
+
+
+template<class TInputImage, class TMaskImage, class TOutputImage>
+void SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::BeforeThreadedGenerateData()
+{
+  // The S0 filter is threaded itself, run it once up front so all threads can share the result
+  m_S0Volume = this->GetS0Image(this->GetInput());
+
+  // Without a T1 map every voxel uses one of these two, so their constants are computed only once
+  m_TissueConverter = SignalToConcentrationConverter(m_T1PreTissue, m_TR, m_FA, m_RGD_relaxivity);
+  m_BloodConverter = SignalToConcentrationConverter(m_T1PreBlood, m_TR, m_FA, m_RGD_relaxivity);
+}
+
+
+template<class TInputImage, class TMaskImage, class TOutputImage>
+void SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>
+#if ITK_VERSION_MAJOR < 4
+::ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread, int threadId )
+#else
+::ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread, ThreadIdType threadId)
+#endif
 {
   const InputImageType* inputVectorVolume = this->GetInput();
+  OutputImageType* outputVolume = this->GetOutput();
+  const unsigned int timeSize = inputVectorVolume->GetNumberOfComponentsPerPixel();
+
+  InputImageConstIterType inputVectorVolumeIter(inputVectorVolume, outputRegionForThread);
+  InternalVolumeConstIterType S0VolumeIter(m_S0Volume, outputRegionForThread);
+  OutputIterType outVolumeIter(outputVolume, outputRegionForThread);
+  T1PreValueMapperType t1PreMapper(this->GetROIMask(), this->GetAIFMask(), this->GetT1Map(), outputRegionForThread, this->m_T1PreTissue, this->m_T1PreBlood);
+
+  // Buffers are allocated once per thread and reused for every voxel of the region
+  std::vector<float> signalVectorVoxel(timeSize);
+  std::vector<float> concentrationVectorVoxel(timeSize);
+  OutputPixelType outputVectorVoxel(timeSize);
+  SignalToConcentrationConverter voxelConverter;
+
+  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
 
-  OutputImageType* outputVolume = this->GetAllocatedOutputVolume(inputVectorVolume);
-  InternalVolumePointerType S0Volume = this->GetS0Image(inputVectorVolume);
-  InternalVolumeIterType S0VolumeIter(S0Volume, S0Volume->GetRequestedRegion());
-  S0VolumeIter.GoToBegin();
-  InputImageConstIterType inputVectorVolumeIter(inputVectorVolume, inputVectorVolume->GetRequestedRegion());
-  inputVectorVolumeIter.GoToBegin();
-  OutputIterType outVolumeIter(outputVolume, outputVolume->GetRequestedRegion());
-  outVolumeIter.GoToBegin();
-  T1PreValueMapper t1PreMapper(this->GetROIMask(), this->GetAIFMask(), this->GetT1Map(), this->m_T1PreTissue, this->m_T1PreBlood);
-
-  float* concentrationVectorVoxelTemp = new float[(int)inputVectorVolume->GetNumberOfComponentsPerPixel()];
-  OutputPixelType outputVectorVoxel;
-
-  ProgressReporter progress(this, 0, outputVolume->GetRequestedRegion().GetNumberOfPixels());
-  
   // Convert signal intensities to concentration values
   while (!outVolumeIter.IsAtEnd())
   {
-    InternalVectorVoxelType vectorVoxel = this->convertToInternalVectorVoxel(inputVectorVolumeIter.Get());
-    outputVectorVoxel.SetSize(vectorVoxel.GetSize());
     float T1Pre = t1PreMapper.Get();
     if (T1Pre)
     {
-      bool isConvert = convert_signal_to_concentration(inputVectorVolume->GetNumberOfComponentsPerPixel(),
-                                                       vectorVoxel.GetDataPointer(),
-                                                       T1Pre, m_TR, m_FA,
-                                                       concentrationVectorVoxelTemp,
-                                                       m_RGD_relaxivity,
-                                                       S0VolumeIter.Get(),
-                                                       m_S0GradThresh);
-
-      for (typename OutputPixelType::ElementIdentifier i = 0; i < outputVectorVoxel.GetSize(); ++i)
+      // copy/cast input vector to floats, Get() references the image buffer without copying
+      const InputPixelType& inputVectorVoxel = inputVectorVolumeIter.Get();
+      for (unsigned int i = 0; i < timeSize; ++i)
+      {
+        signalVectorVoxel[i] = static_cast<float>(inputVectorVoxel[i]);
+      }
+
+      this->GetConverter(T1Pre, voxelConverter).convert(timeSize,
+                                                        &signalVectorVoxel[0],
+                                                        S0VolumeIter.Get(),
+                                                        &concentrationVectorVoxel[0]);
+
+      for (unsigned int i = 0; i < timeSize; ++i)
       {
-        outputVectorVoxel[i] = static_cast<typename OutputPixelType::ValueType>(concentrationVectorVoxelTemp[i]);
+        outputVectorVoxel[i] = static_cast<typename OutputPixelType::ValueType>(concentrationVectorVoxel[i]);
       }
     }
     else
@@ -72,20 +107,28 @@ void SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputI
     ++t1PreMapper;
 
     progress.CompletedPixel();
-    }
-
-  delete [] concentrationVectorVoxelTemp;
+  }
 }
 
 
 template<class TInputImage, class TMaskImage, class TOutputImage>
-typename SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::OutputImageType*
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::GetAllocatedOutputVolume(const InputImageType* inputVectorVolume)
+const SignalToConcentrationConverter&
+SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::GetConverter(float T1Pre, SignalToConcentrationConverter& voxelConverter) const
 {
-  OutputImageType* outputVolume = this->GetOutput();
-  outputVolume->SetBufferedRegion(inputVectorVolume->GetBufferedRegion());
-  outputVolume->Allocate();
-  return outputVolume;
+  if (T1Pre == m_TissueConverter.getT1Pre())
+  {
+    return m_TissueConverter;
+  }
+  if (T1Pre == m_BloodConverter.getT1Pre())
+  {
+    return m_BloodConverter;
+  }
+  // T1 map value, constants are computed once for this voxel
+  if (T1Pre != voxelConverter.getT1Pre())
+  {
+    voxelConverter = SignalToConcentrationConverter(T1Pre, m_TR, m_FA, m_RGD_relaxivity);
+  }
+  return voxelConverter;
 }
 
 
@@ -93,9 +136,22 @@ template<class TInputImage, class TMaskImage, class TOutputImage>
 typename SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::InternalVolumePointerType
 SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::GetS0Image(const InputImageType* inputVectorVolume)
 {
-  typedef SignalIntensityToS0ImageFilter<TInputImage, InternalVolumeType> S0VolumeFilterType;
+  typedef SignalIntensityToS0ImageFilter<TInputImage, InternalVolumeType, TMaskImage> S0VolumeFilterType;
   typename S0VolumeFilterType::Pointer S0VolumeFilter = S0VolumeFilterType::New();
   S0VolumeFilter->SetInput(inputVectorVolume);
+  // S0 is only needed where concentrations are computed
+  if (this->GetROIMask())
+  {
+    S0VolumeFilter->SetROIMask(this->GetROIMask());
+  }
+  if (this->GetAIFMask())
+  {
+    S0VolumeFilter->SetAIFMask(this->GetAIFMask());
+  }
+  if (this->GetBATMap())
+  {
+    S0VolumeFilter->SetBATMap(this->GetBATMap());
+  }
   S0VolumeFilter->SetS0GradThresh(m_S0GradThresh);
   S0VolumeFilter->SetBatEstimator(m_batEstimator);
   S0VolumeFilter->Update();
@@ -104,18 +160,6 @@ SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>
 }
 
 
-template<class TInputImage, class TMaskImage, class TOutputImage>
-typename SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::InternalVectorVoxelType
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::convertToInternalVectorVoxel(const InputPixelType& inputVectorVoxel)
-{
-  InternalVectorVoxelType vectorVoxel;
-  vectorVoxel.SetSize(inputVectorVoxel.GetSize());
-  vectorVoxel.Fill(0.0);
-  vectorVoxel += inputVectorVoxel; // shorthand for a copy/cast
-  return vectorVoxel;
-}
-
-
 
 template <class TInputImage, class TMaskImage, class TOutput>
 void SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutput>::PrintSelf( std::ostream& os, Indent indent ) const
@@ -131,96 +175,5 @@ void SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutput>
 
 
 
-//==================== T1PreValueIterator internal helper class ====================
-
-template<class TInputImage, class TMaskImage, class TOutputImage>
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::T1PreValueMapper::T1PreValueMapper(const InputMaskType* roiMask,
-                                                                                                                     const InputMaskType* aifMask, 
-                                                                                                                     const InputMaskType* t1Map, 
-                                                                                                                     float t1PreTissue, 
-                                                                                                                     float t1PreBlood)
-{
-  this->m_T1PreTissue = t1PreTissue;
-  this->m_T1PreBlood = t1PreBlood;
-  this->roiMaskVolumeIter = this->getNewConstMaskIterOrNull(roiMask);
-  this->aifMaskVolumeIter = this->getNewConstMaskIterOrNull(aifMask);
-  this->T1MapVolumeIter = this->getNewConstMaskIterOrNull(t1Map);
-}
-
-
-template<class TInputImage, class TMaskImage, class TOutputImage>
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::T1PreValueMapper::~T1PreValueMapper()
-{
-  delete this->roiMaskVolumeIter;
-  delete this->aifMaskVolumeIter;
-  delete this->T1MapVolumeIter;
-}
-
-
-template<class TInputImage, class TMaskImage, class TOutputImage>
-float
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::T1PreValueMapper::Get()
-{
-  float T1Pre = T1MapVolumeIter ? T1MapVolumeIter->Get() : m_T1PreTissue;
-  if (aifMaskVolumeIter && aifMaskVolumeIter->Get()) {
-    T1Pre = m_T1PreBlood;
-  }
-  else if (roiMaskVolumeIter && !roiMaskVolumeIter->Get()) {
-    T1Pre = 0;
-  }
-  return T1Pre;
-}
-
-
-template<class TInputImage, class TMaskImage, class TOutputImage>
-void
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::T1PreValueMapper::GoToBegin()
-{
-  if (this->roiMaskVolumeIter) {
-    this->roiMaskVolumeIter->GoToBegin();
-  }
-  if (aifMaskVolumeIter) {
-    this->aifMaskVolumeIter->GoToBegin();
-  }
-  if (T1MapVolumeIter) {
-    this->T1MapVolumeIter->GoToBegin();
-  }
-}
-
-
-template<class TInputImage, class TMaskImage, class TOutputImage>
-typename SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::T1PreValueMapper&
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::T1PreValueMapper::operator++()
-{
-  if (this->roiMaskVolumeIter) {
-    ++(*(this->roiMaskVolumeIter));
-  }
-  if (aifMaskVolumeIter) {
-    ++(*(this->aifMaskVolumeIter));
-  }
-  if (T1MapVolumeIter) {
-    ++(*(this->T1MapVolumeIter));
-  }
-  return *this;
-}
-
-
-template<class TInputImage, class TMaskImage, class TOutputImage>
-typename SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::InputMaskConstIterType*
-SignalIntensityToConcentrationImageFilter<TInputImage, TMaskImage, TOutputImage>::T1PreValueMapper::getNewConstMaskIterOrNull(const InputMaskType* inMask)
-{
-  InputMaskConstIterType* maskVolumeIter = NULL;
-  if (inMask && (inMask->GetBufferedRegion().GetSize()[0] != 0))
-  {
-    maskVolumeIter = new InputMaskConstIterType(inMask, inMask->GetRequestedRegion());
-    maskVolumeIter->GoToBegin();
-  }
-  return maskVolumeIter;
-}
-
-
-
-
-
 } // end namespace itk
 #endif
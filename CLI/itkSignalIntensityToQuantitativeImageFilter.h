@@ -0,0 +1,207 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $SignalIntensityToQuantitative: itkSignalIntensityToQuantitativeImageFilter.h $
+  Language:  C++
+
+  =========================================================================*/
+#ifndef __itkSignalIntensityToQuantitativeImageFilter_h
+#define __itkSignalIntensityToQuantitativeImageFilter_h
+
+#include "itkConcentrationToQuantitativeImageFilter.h"
+#include "itkT1PreValueMapper.h"
+#include "AIF/ArterialInputFunctionAverageUnderMask.h"
+#include "AIF/SignalToConcentrationCurveSource.h"
+
+namespace itk
+{
+  /** \class SignalIntensityToQuantitativeImageFilter
+   * \brief Calculates quantitative imaging parameters directly from signal intensities.
+   *
+   * Single pass alternative to running SignalIntensityToConcentrationImageFilter
+   * followed by ConcentrationToQuantitativeImageFilter. Each chunk of voxels is
+   * converted to concentrations in a buffer local to the thread and fitted
+   * right away, so neither the S0 image nor the 4D concentration image has to
+   * be held in memory. Both can still be requested as additional outputs.
+   *
+   * If an AIF mask is set, the AIF is computed from the concentrations of the
+   * voxels under the mask, converting only those voxels up front.
+   * Otherwise the AIF has to be provided with SetAIF().
+   *
+   * The input is the 4D signal intensity image, of any pixel type, the
+   * signal of a voxel is cast to floats only when it is converted. The
+   * outputs are the same as the ones of ConcentrationToQuantitativeImageFilter,
+   * the concentrations and the fitted curves are float vector images.
+   */
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  class ITK_EXPORT SignalIntensityToQuantitativeImageFilter
+    : public ConcentrationToQuantitativeImageFilter < VectorImage<float, TInputImage::ImageDimension>, TMaskImage, TOutputImage >
+  {
+  public:
+    /** Standard class typedefs. */
+    typedef SignalIntensityToQuantitativeImageFilter Self;
+    typedef ConcentrationToQuantitativeImageFilter<VectorImage<float, TInputImage::ImageDimension>, TMaskImage, TOutputImage> Superclass;
+    typedef SmartPointer<Self>       Pointer;
+    typedef SmartPointer<const Self> ConstPointer;
+
+    typedef TInputImage                                    SignalVolumeType;
+    typedef itk::ImageRegionConstIterator<SignalVolumeType> SignalVolumeConstIterType;
+
+    typedef typename Superclass::VectorVolumeType          VectorVolumeType;
+    typedef typename Superclass::VectorVolumeIterType      VectorVolumeIterType;
+    typedef typename Superclass::MaskVolumeType            MaskVolumeType;
+    typedef typename Superclass::MaskVolumeConstIterType   MaskVolumeConstIterType;
+    typedef typename Superclass::OutputVolumeType          OutputVolumeType;
+    typedef typename Superclass::OutputVolumePixelType     OutputVolumePixelType;
+    typedef typename Superclass::OutputVolumeRegionType    OutputVolumeRegionType;
+    typedef typename Superclass::OutputVolumeIterType      OutputVolumeIterType;
+    typedef typename Superclass::VectorVoxelType           VectorVoxelType;
+    typedef typename Superclass::DataObjectPointer         DataObjectPointer;
+    typedef typename Superclass::DataObjectPointerArraySizeType DataObjectPointerArraySizeType;
+    typedef typename Superclass::FitWorkspace              FitWorkspace;
+    typedef typename Superclass::VoxelResult               VoxelResult;
+    typedef typename Superclass::AIFContext                AIFContext;
+    typedef typename Superclass::OutputIterators           OutputIterators;
+
+    typedef itk::T1PreValueMapper<MaskVolumeType> T1PreValueMapperType;
+
+    /** Method for creation through the object factory. */
+    itkNewMacro(Self);
+
+    /** Run-time type information (and related methods). */
+    itkTypeMacro(SignalIntensityToQuantitativeImageFilter, ConcentrationToQuantitativeImageFilter);
+
+    using Superclass::MakeOutput;
+    virtual DataObjectPointer MakeOutput(DataObjectPointerArraySizeType idx);
+
+    /** The signal intensities, in place of the concentrations of the superclass */
+    void SetInput(const SignalVolumeType* signalVolume)
+    {
+      this->ProcessObject::SetNthInput(0, const_cast<SignalVolumeType*>(signalVolume));
+    }
+
+    const SignalVolumeType* GetInput() const
+    {
+      return dynamic_cast<const SignalVolumeType*>(this->ProcessObject::GetInput(0));
+    }
+
+    /** Set and get the parameters of the signal to concentration conversion */
+    itkGetMacro(T1PreBlood, float);
+    itkSetMacro(T1PreBlood, float);
+    itkGetMacro(T1PreTissue, float);
+    itkSetMacro(T1PreTissue, float);
+
+    /** Enable the concentration and S0 outputs, both are off by default */
+    itkGetMacro(ComputeConcentrations, bool);
+    itkSetMacro(ComputeConcentrations, bool);
+    itkBooleanMacro(ComputeConcentrations);
+    itkGetMacro(ComputeS0, bool);
+    itkSetMacro(ComputeS0, bool);
+    itkBooleanMacro(ComputeS0);
+
+    /** Use the bolus arrival time estimated on the signal intensities, which
+     * is needed for S0 anyway, for the model fit as well, instead of
+     * estimating it again on the concentration curve. Off by default. */
+    itkGetMacro(UseSignalBAT, bool);
+    itkSetMacro(UseSignalBAT, bool);
+    itkBooleanMacro(UseSignalBAT);
+
+    // Set a mask image for specifying the location of the arterial
+    // input function. This is interpretted as a binary image with
+    // nonzero values only at the arterial input function locations.
+    void SetAIFMask(const MaskVolumeType* aifMaskVolume)
+    {
+      this->SetNthInput(1, const_cast<MaskVolumeType*>(aifMaskVolume));
+    }
+
+    // Get the mask image assigned as the arterial input function
+    const MaskVolumeType* GetAIFMask() const
+    {
+      return dynamic_cast<const MaskVolumeType*>(this->ProcessObject::GetInput(1));
+    }
+
+    // Set a T1 map providing the T1Pre value of each tissue voxel
+    void SetT1Map(const MaskVolumeType* T1MapVolume)
+    {
+      this->SetNthInput(3, const_cast<MaskVolumeType*>(T1MapVolume));
+    }
+
+    // Get the T1 map
+    const MaskVolumeType* GetT1Map() const
+    {
+      return dynamic_cast<const MaskVolumeType*>(this->ProcessObject::GetInput(3));
+    }
+
+    /// Concentration curves of all voxels that have a non-zero T1Pre value,
+    /// only available if ComputeConcentrations is on.
+    VectorVolumeType* GetConcentrationOutput();
+
+    /// Set a buffer the concentration curves are written to instead of an
+    /// allocated one, see SetFittedDataBuffer()
+    void SetConcentrationsBuffer(typename VectorVolumeType::InternalPixelType* buffer)
+    {
+      this->SetOutputBuffer(ConcentrationOutputIndex, buffer);
+    }
+
+    /// S0 of all voxels that have a non-zero T1Pre value, only available if
+    /// ComputeS0 is on.
+    TOutputImage* GetS0Output();
+
+  protected:
+    SignalIntensityToQuantitativeImageFilter();
+    ~SignalIntensityToQuantitativeImageFilter() {}
+    void PrintSelf(std::ostream& os, Indent indent) const;
+
+    /// The optional outputs are only allocated if they were requested
+    bool IsOutputComputed(DataObjectPointerArraySizeType idx) const;
+
+    void BeforeThreadedGenerateData();
+
+    std::vector<float> ComputeAIF();
+
+    DataObjectPointerArraySizeType GetNumberOfFixedOutputs() const
+    {
+      return S0OutputIndex + 1;
+    }
+
+#if ITK_VERSION_MAJOR < 4
+    void ThreadedGenerateData( const OutputVolumeRegionType& outputRegionForThread, int threadId );
+
+#else
+    void ThreadedGenerateData(const OutputVolumeRegionType& outputRegionForThread,
+      ThreadIdType threadId);
+
+#endif
+
+    /// Converts the signal of one voxel to concentrations.
+    /// voxelConverter is a per thread instance that is updated for T1Pre
+    /// values from a T1 map. Returns the S0 used for the conversion.
+    float ConvertVoxel(const float* signalVectorVoxel, int BATIndex, float T1Pre,
+                       float* concentrationVectorVoxel, SignalToConcentrationConverter& voxelConverter);
+
+  private:
+    SignalIntensityToQuantitativeImageFilter(const Self &); // purposely not implemented
+    void operator=(const Self &); // purposely not implemented
+
+    // following the outputs of the superclass
+    static const DataObjectPointerArraySizeType ConcentrationOutputIndex = 13;
+    static const DataObjectPointerArraySizeType S0OutputIndex = 14;
+
+    float m_T1PreBlood;
+    float m_T1PreTissue;
+    bool  m_ComputeConcentrations;
+    bool  m_ComputeS0;
+    bool  m_UseSignalBAT;
+
+    // Conversion constants for the default tissue and blood T1Pre, shared read-only between threads
+    SignalToConcentrationConverter m_TissueConverter;
+    SignalToConcentrationConverter m_BloodConverter;
+  };
+
+}; // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkSignalIntensityToQuantitativeImageFilter.hxx"
+#endif
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef _itkSignalIntensityToQuantitativeImageFilter_hxx
+#define _itkSignalIntensityToQuantitativeImageFilter_hxx
+
+#include "itkSignalIntensityToQuantitativeImageFilter.h"
+#include "itkProgressReporter.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>::SignalIntensityToQuantitativeImageFilter()
+  {
+    m_T1PreTissue = 0.0f;
+    m_T1PreBlood = m_T1PreTissue;
+    m_ComputeConcentrations = false;
+    m_ComputeS0 = false;
+    m_UseSignalBAT = false;
+    this->ProcessObject::SetNthOutput(ConcentrationOutputIndex, this->MakeOutput(ConcentrationOutputIndex));
+    this->ProcessObject::SetNthOutput(S0OutputIndex, this->MakeOutput(S0OutputIndex));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  typename SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>::DataObjectPointer
+    SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::MakeOutput(DataObjectPointerArraySizeType idx)
+  {
+    if (idx == ConcentrationOutputIndex)
+    {
+      return VectorVolumeType::New().GetPointer();
+    }
+    return Superclass::MakeOutput(idx);
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  typename SignalIntensityToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >::VectorVolumeType*
+    SignalIntensityToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetConcentrationOutput()
+  {
+    return dynamic_cast<VectorVolumeType *>(this->ProcessObject::GetOutput(ConcentrationOutputIndex));
+  }
+
+  template< class TInputImage, class TMaskImage, class TOutputImage >
+  TOutputImage*
+    SignalIntensityToQuantitativeImageFilter< TInputImage, TMaskImage, TOutputImage >
+    ::GetS0Output()
+  {
+    return dynamic_cast<TOutputImage *>(this->ProcessObject::GetOutput(S0OutputIndex));
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  bool
+    SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::IsOutputComputed(DataObjectPointerArraySizeType idx) const
+  {
+    if (idx == ConcentrationOutputIndex)
+    {
+      return m_ComputeConcentrations;
+    }
+    if (idx == S0OutputIndex)
+    {
+      return m_ComputeS0;
+    }
+    return Superclass::IsOutputComputed(idx);
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  float
+    SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::ConvertVoxel(const float* signalVectorVoxel, int BATIndex, float T1Pre,
+                   float* concentrationVectorVoxel, SignalToConcentrationConverter& voxelConverter)
+  {
+    const unsigned int timeSize = this->GetInput()->GetNumberOfComponentsPerPixel();
+    const float S0 = compute_s0_individual_curve((int)timeSize, signalVectorVoxel,
+                                                 this->GetS0GradThresh(), BATIndex);
+
+    const SignalToConcentrationConverter* converter = &voxelConverter;
+    if (T1Pre == m_TissueConverter.getT1Pre())
+    {
+      converter = &m_TissueConverter;
+    }
+    else if (T1Pre == m_BloodConverter.getT1Pre())
+    {
+      converter = &m_BloodConverter;
+    }
+    else if (T1Pre != voxelConverter.getT1Pre())
+    {
+      // T1 map value, constants are computed once for this voxel
+      voxelConverter = SignalToConcentrationConverter(T1Pre, this->GetTR(), this->GetFA(), this->GetRGD_relaxivity());
+    }
+    converter->convert(timeSize, signalVectorVoxel, S0, concentrationVectorVoxel);
+    return S0;
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void
+    SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::BeforeThreadedGenerateData()
+  {
+    // Without a T1 map every voxel uses one of these two, so their constants are computed only once.
+    // Needed by the AIF pre-pass already, which runs in the superclass.
+    m_TissueConverter = SignalToConcentrationConverter(m_T1PreTissue, this->GetTR(), this->GetFA(), this->GetRGD_relaxivity());
+    m_BloodConverter = SignalToConcentrationConverter(m_T1PreBlood, this->GetTR(), this->GetFA(), this->GetRGD_relaxivity());
+
+    Superclass::BeforeThreadedGenerateData();
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  std::vector<float>
+    SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::ComputeAIF()
+  {
+    const MaskVolumeType* aifMask = this->GetAIFMask();
+    if (!T1PreValueMapperType::isValidMask(aifMask))
+    {
+      return Superclass::ComputeAIF();
+    }
+
+    // Average the concentration curves under the AIF mask, converting only
+    // the voxels of the mask (these always use the blood T1Pre)
+    SignalToConcentrationCurveSource curveSource(this->GetInput(), m_T1PreBlood,
+                                                 this->GetTR(), this->GetFA(), this->GetRGD_relaxivity(),
+                                                 this->GetS0GradThresh(), this->GetBatEstimator());
+    return ArterialInputFunctionAverageUnderMask(curveSource, aifMask).getSignalValues();
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void
+    SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+#if ITK_VERSION_MAJOR < 4
+    ::ThreadedGenerateData( const OutputVolumeRegionType & outputRegionForThread, int threadId )
+#else
+    ::ThreadedGenerateData(const OutputVolumeRegionType& outputRegionForThread, ThreadIdType threadId)
+#endif
+  {
+    const SignalVolumeType* inputVectorVolume = this->GetInput();
+    const unsigned int timeSize = inputVectorVolume->GetNumberOfComponentsPerPixel();
+
+    SignalVolumeConstIterType inputVectorVolumeIter(inputVectorVolume, outputRegionForThread);
+    OutputIterators outputIters(this, outputRegionForThread);
+    T1PreValueMapperType t1PreMapper(this->GetROIMask(), this->GetAIFMask(), this->GetT1Map(), outputRegionForThread, m_T1PreTissue, m_T1PreBlood);
+
+    MaskVolumeConstIterType roiMaskVolumeIter;
+    if (this->GetROIMask())
+    {
+      roiMaskVolumeIter = MaskVolumeConstIterType(this->GetROIMask(), outputRegionForThread);
+    }
+    const MaskVolumeType* aifRegionMap = this->GetAIFRegionMap();
+    MaskVolumeConstIterType aifRegionMapVolumeIter;
+    if (aifRegionMap)
+    {
+      aifRegionMapVolumeIter = MaskVolumeConstIterType(aifRegionMap, outputRegionForThread);
+    }
+    VectorVolumeIterType concentrationVolumeIter;
+    if (m_ComputeConcentrations)
+    {
+      concentrationVolumeIter = VectorVolumeIterType(this->GetConcentrationOutput(), outputRegionForThread);
+    }
+    OutputVolumeIterType S0VolumeIter;
+    if (m_ComputeS0)
+    {
+      S0VolumeIter = OutputVolumeIterType(this->GetS0Output(), outputRegionForThread);
+    }
+
+    // Buffers are allocated once per thread and reused for every chunk of the region
+    FitWorkspace workspace(timeSize);
+    VoxelResult result(this->GetAUCTimeIntervals().size());
+    std::vector<float> concentrationVectorVoxel(timeSize);
+    VectorVoxelType outputVectorVoxel(timeSize);
+    SignalToConcentrationConverter voxelConverter;
+
+    // The signal curves of a chunk are gathered to estimate their BATs in one
+    // call, then converted to the concentration curves of the ROI voxels, and
+    // the BATs of those are again estimated in one call for the fit
+    CurveChunk signalChunk(timeSize);
+    CurveChunk concentrationChunk(timeSize);
+    std::vector<float> T1Pres(CurveChunk::DefaultSize);
+    // AIF context of each voxel of the chunk, NULL outside of the ROI
+    std::vector<const AIFContext*> aifs(CurveChunk::DefaultSize);
+
+    ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
+
+    while (!inputVectorVolumeIter.IsAtEnd())
+    {
+      signalChunk.Clear();
+      while (!signalChunk.IsFull() && !inputVectorVolumeIter.IsAtEnd())
+      {
+        const unsigned int voxel = signalChunk.GetNumberOfVoxels();
+        const float T1Pre = t1PreMapper.Get();
+        const bool inROI = !this->GetROIMask() || roiMaskVolumeIter.Get();
+        T1Pres[voxel] = T1Pre;
+        aifs[voxel] = NULL;
+        if (inROI)
+        {
+          aifs[voxel] = aifRegionMap ? &this->GetAIFContext(aifRegionMapVolumeIter.Get()) : &this->GetAIFContext();
+        }
+        if (T1Pre || (inROI && m_UseSignalBAT))
+        {
+          signalChunk.AddCurve(inputVectorVolumeIter.Get());
+        }
+        else
+        {
+          signalChunk.Skip();
+        }
+        ++inputVectorVolumeIter;
+        ++t1PreMapper;
+        if (this->GetROIMask())
+        {
+          ++roiMaskVolumeIter;
+        }
+        if (aifRegionMap)
+        {
+          ++aifRegionMapVolumeIter;
+        }
+      }
+      signalChunk.EstimateBATs(this->GetBatEstimator());
+
+      concentrationChunk.Clear();
+      for (unsigned int i = 0; i < signalChunk.GetNumberOfVoxels(); ++i)
+      {
+        float* concentration = &concentrationVectorVoxel[0];
+        const int signalCurve = signalChunk.GetCurveIndex(i);
+        if (aifs[i])
+        {
+          const unsigned int curve = concentrationChunk.AddCurve();
+          concentration = concentrationChunk.GetCurve(curve);
+          if (m_UseSignalBAT)
+          {
+            concentrationChunk.BATIndex(curve) = signalCurve < 0 ? -1 : signalChunk.BATIndex(signalCurve);
+          }
+        }
+        else
+        {
+          concentrationChunk.Skip();
+        }
+
+        float S0 = 0.0f;
+        if (T1Pres[i])
+        {
+          S0 = this->ConvertVoxel(signalChunk.GetCurve(signalCurve), signalChunk.BATIndex(signalCurve), T1Pres[i],
+                                  concentration, voxelConverter);
+        }
+        else
+        {
+          std::fill(concentration, concentration + timeSize, 0.0f);
+        }
+
+        if (m_ComputeConcentrations)
+        {
+          for (unsigned int t = 0; t < timeSize; ++t)
+          {
+            outputVectorVoxel[t] = concentration[t];
+          }
+          concentrationVolumeIter.Set(outputVectorVoxel);
+          ++concentrationVolumeIter;
+        }
+        if (m_ComputeS0)
+        {
+          S0VolumeIter.Set(static_cast<OutputVolumePixelType>(S0));
+          ++S0VolumeIter;
+        }
+      }
+      this->EstimateBATs(concentrationChunk, m_UseSignalBAT);
+
+      for (unsigned int i = 0; i < concentrationChunk.GetNumberOfVoxels(); ++i)
+      {
+        result.Reset();
+        const int curve = concentrationChunk.GetCurveIndex(i);
+        if (curve >= 0)
+        {
+          this->QuantifyVoxel(concentrationChunk.GetCurve(curve), concentrationChunk.BATIndex(curve),
+                              concentrationChunk.GetBATPosition(curve), concentrationChunk.GetMaxSlope(curve),
+                              *aifs[i], workspace, result);
+        }
+        else
+        {
+          workspace.shiftedVectorVoxel.Fill(0.0);
+        }
+        outputIters.Set(result, workspace.shiftedVectorVoxel);
+        ++outputIters;
+
+        progress.CompletedPixel();
+      }
+    }
+  }
+
+  template <class TInputImage, class TMaskImage, class TOutputImage>
+  void SignalIntensityToQuantitativeImageFilter<TInputImage, TMaskImage, TOutputImage>
+    ::PrintSelf(std::ostream& os, Indent indent) const
+  {
+    Superclass::PrintSelf(os, indent);
+    os << indent << "T1PreBlood: " << m_T1PreBlood << std::endl;
+    os << indent << "T1PreTissue: " << m_T1PreTissue << std::endl;
+    os << indent << "ComputeConcentrations: " << m_ComputeConcentrations << std::endl;
+    os << indent << "ComputeS0: " << m_ComputeS0 << std::endl;
+    os << indent << "UseSignalBAT: " << m_UseSignalBAT << std::endl;
+  }
+
+} // end namespace itk
+
+#endif
@@ -12,15 +12,22 @@
 #include "itkImage.h"
 #include "itkVectorImage.h"
 #include "itkImageRegionIterator.h"
+#include "itkCurveChunk.h"
 #include "PkSolver.h"
 
 #include <string>
+#include <vector>
 
 namespace itk
 {
-  /** \class SignalIntensityToS0ImageFilter */
-
-  template <class TInputImage, class TOutputImage>
+  /** \class SignalIntensityToS0ImageFilter
+   * \brief Estimates S0 for each signal intensity curve.
+   *
+   * Optional ROI and AIF masks restrict the estimation to the voxels that
+   * are converted to concentrations later on, S0 is 0 everywhere else.
+   */
+
+  template <class TInputImage, class TOutputImage, class TMaskImage = itk::Image<unsigned short, TInputImage::ImageDimension> >
   class SignalIntensityToS0ImageFilter : public ImageToImageFilter < TInputImage, TOutputImage >
   {
   public:
@@ -39,6 +46,10 @@ namespace itk
     typedef typename OutputImageType::PixelType       OutputPixelType;
     typedef typename OutputImageType::RegionType      OutputImageRegionType;
     typedef itk::ImageRegionIterator<OutputImageType> OutputImageIterType;
+    typedef itk::ImageRegionConstIterator<OutputImageType> OutputImageConstIterType;
+
+    typedef TMaskImage                                   InputMaskType;
+    typedef itk::ImageRegionConstIterator<InputMaskType> InputMaskConstIterType;
 
     typedef itk::VariableLengthVector<float> InternalVectorVoxelType;
 
@@ -68,6 +79,44 @@ namespace itk
       return this->m_batEstimator;
     }
 
+    // Set a mask image for specifying the location of the arterial
+    // input function. S0 is always estimated for voxels under this mask.
+    void SetAIFMask(const InputMaskType* aifMaskVolume)
+    {
+      this->SetNthInput(1, const_cast<InputMaskType*>(aifMaskVolume));
+    }
+
+    // Get the mask image assigned as the arterial input function
+    const InputMaskType* GetAIFMask() const
+    {
+      return dynamic_cast<const InputMaskType*>(this->ProcessObject::GetInput(1));
+    }
+
+    // Set a mask image for specifying the location of voxels for model fit.
+    // If set, S0 is not estimated for voxels outside of it (and the AIF mask).
+    void SetROIMask(const InputMaskType* roiMaskVolume)
+    {
+      this->SetNthInput(2, const_cast<InputMaskType*>(roiMaskVolume));
+    }
+
+    // Get the mask image specifying the location of voxels for model fit.
+    const InputMaskType* GetROIMask() const
+    {
+      return dynamic_cast<const InputMaskType*>(this->ProcessObject::GetInput(2));
+    }
+
+    // Set a map of precomputed bolus arrival time indices, see
+    // SignalIntensityToBATImageFilter. If set, the BAT estimator is not used.
+    void SetBATMap(const OutputImageType* batMapVolume)
+    {
+      this->SetNthInput(3, const_cast<OutputImageType*>(batMapVolume));
+    }
+
+    const OutputImageType* GetBATMap() const
+    {
+      return dynamic_cast<const OutputImageType*>(this->ProcessObject::GetInput(3));
+    }
+
 
   protected:
     SignalIntensityToS0ImageFilter();
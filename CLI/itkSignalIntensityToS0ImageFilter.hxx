@@ -15,15 +15,15 @@
 namespace itk
 {
 
-  template <class TInputImage, class TOutputImage>
-  SignalIntensityToS0ImageFilter<TInputImage, TOutputImage>::SignalIntensityToS0ImageFilter()
+  template <class TInputImage, class TOutputImage, class TMaskImage>
+  SignalIntensityToS0ImageFilter<TInputImage, TOutputImage, TMaskImage>::SignalIntensityToS0ImageFilter()
   {
     m_S0GradThresh = 15.0f;
 
   }
 
-  template <class TInputImage, class TOutputImage>
-  void SignalIntensityToS0ImageFilter<TInputImage, TOutputImage>
+  template <class TInputImage, class TOutputImage, class TMaskImage>
+  void SignalIntensityToS0ImageFilter<TInputImage, TOutputImage, TMaskImage>
 #if ITK_VERSION_MAJOR < 4
     ::ThreadedGenerateData( const typename Superclass::OutputImageRegionType & outputRegionForThread, int itkNotUsed(
     threadId) )
@@ -37,34 +37,71 @@ namespace itk
 
     const InputImageType* inputVectorVolume = this->GetInput();
     OutputImageType* S0Volume = this->GetOutput();
+    const unsigned int timeSize = inputVectorVolume->GetNumberOfComponentsPerPixel();
 
     InputImageConstIterType  inputVectorVolumeIter(inputVectorVolume, outputRegionForThread);
     OutputImageIterType S0VolumeIter(S0Volume, outputRegionForThread);
 
-    float                   S0Temp = 0.0f;
-    InternalVectorVoxelType vectorVoxel;
-    InputPixelType inputVectorVoxel;
+    // Voxels outside of both masks are discarded by the concentration
+    // conversion, so there is no need to estimate S0 for them
+    ROIOrAIFMaskIterator<InputMaskType> needsS0Iter(this->GetROIMask(), this->GetAIFMask(), outputRegionForThread);
 
+    const OutputImageType* batMap = this->GetBATMap();
+    OutputImageConstIterType batMapVolumeIter;
+    if (batMap)
+    {
+      batMapVolumeIter = OutputImageConstIterType(batMap, outputRegionForThread);
+    }
+
+    // The curves are gathered in chunks, without a BAT map the BATs of a
+    // chunk are estimated in one call
+    CurveChunk chunk(timeSize);
     while (!inputVectorVolumeIter.IsAtEnd())
     {
-      // copy/cast input vector to floats
-      inputVectorVoxel = inputVectorVolumeIter.Get();
-      vectorVoxel.SetSize(inputVectorVoxel.GetSize());
-      vectorVoxel.Fill(0.0);
-      vectorVoxel += inputVectorVoxel; // shorthand for a copy/cast
-      S0Temp =
-        compute_s0_individual_curve((int)inputVectorVolume->GetNumberOfComponentsPerPixel(),
-        const_cast<float*>(vectorVoxel.GetDataPointer()), m_S0GradThresh, m_batEstimator);
-      S0VolumeIter.Set(static_cast<OutputPixelType>(S0Temp));
-      ++S0VolumeIter;
-      ++inputVectorVolumeIter;
+      chunk.Clear();
+      for (; !chunk.IsFull() && !inputVectorVolumeIter.IsAtEnd(); ++inputVectorVolumeIter, ++needsS0Iter)
+      {
+        if (needsS0Iter.Get())
+        {
+          const unsigned int curve = chunk.AddCurve(inputVectorVolumeIter.Get());
+          if (batMap)
+          {
+            chunk.BATIndex(curve) = static_cast<int>(batMapVolumeIter.Get());
+          }
+        }
+        else
+        {
+          chunk.Skip();
+        }
+        if (batMap)
+        {
+          ++batMapVolumeIter;
+        }
+      }
+      if (!batMap)
+      {
+        // S0 is 0 where BAT detection fails
+        chunk.EstimateBATs(m_batEstimator);
+      }
+
+      for (unsigned int i = 0; i < chunk.GetNumberOfVoxels(); ++i)
+      {
+        float S0Temp = 0.0f;
+        const int curve = chunk.GetCurveIndex(i);
+        if (curve >= 0)
+        {
+          S0Temp = compute_s0_individual_curve((int)timeSize, chunk.GetCurve(curve), m_S0GradThresh, chunk.BATIndex(curve));
+        }
+        S0VolumeIter.Set(static_cast<OutputPixelType>(S0Temp));
+        ++S0VolumeIter;
+      }
     }
 
   }
 
   /** Standard "PrintSelf" method */
-  template <class TInputImage, class TOutput>
-  void SignalIntensityToS0ImageFilter<TInputImage, TOutput>
+  template <class TInputImage, class TOutput, class TMaskImage>
+  void SignalIntensityToS0ImageFilter<TInputImage, TOutput, TMaskImage>
     ::PrintSelf(std::ostream& os, Indent indent) const
   {
     Superclass::PrintSelf(os, indent);
@@ -0,0 +1,64 @@
+/*=========================================================================
+
+  Program:   Insight Segmentation & Registration Toolkit
+  Module:    $T1PreValueMapper: itkT1PreValueMapper.h $
+  Language:  C++
+
+  =========================================================================*/
+#ifndef __itkT1PreValueMapper_h
+#define __itkT1PreValueMapper_h
+
+#include "itkImageRegionConstIterator.h"
+
+namespace itk
+{
+  /** \class T1PreValueMapper
+   * \brief Helper to get the correct T1Pre value for each voxel of a region.
+   *
+   * The T1Pre value of a voxel depends on the availability and validity of
+   * ROI/AIF mask and T1 Map at the voxel position. Each thread of a filter
+   * creates its own mapper for the region it works on and walks it like an
+   * Iterator, in lockstep with the image iterators of that region.
+   */
+  template <class TMaskImage>
+  class T1PreValueMapper
+  {
+  public:
+    typedef TMaskImage                                   MaskImageType;
+    typedef typename MaskImageType::RegionType           RegionType;
+    typedef itk::ImageRegionConstIterator<MaskImageType> MaskConstIterType;
+
+    //! Instantiate the Mapper by providing ROI mask, AIF mask, and/or T1 Map (all of which are optional and my be NULL if not available),
+    //! and the region the mapper should walk through.
+    //! Also provide default constant Tissue and Blood value (these are required inputs).
+    T1PreValueMapper(const MaskImageType* roiMask, const MaskImageType* aifMask, const MaskImageType* t1Map,
+                     const RegionType& region, float t1PreTissue, float t1PreBlood);
+    virtual ~T1PreValueMapper() {}
+
+    //! Returns the T1Pre value for the current voxel position, based on the availability and validity of ROI/AIF mask and T1 Map at this position.
+    float Get() const;
+    void GoToBegin();
+    T1PreValueMapper& operator++();
+
+    //! True if the given mask exists and has a buffer, i.e. it can be iterated.
+    static bool isValidMask(const MaskImageType* inMask);
+
+  private:
+    MaskConstIterType m_roiMaskVolumeIter;
+    MaskConstIterType m_aifMaskVolumeIter;
+    MaskConstIterType m_T1MapVolumeIter;
+    const bool m_hasRoiMask;
+    const bool m_hasAifMask;
+    const bool m_hasT1Map;
+    const float m_T1PreTissue;
+    const float m_T1PreBlood;
+
+  }; // end T1PreValueMapper class
+
+}; // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkT1PreValueMapper.hxx"
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef _itkT1PreValueMapper_hxx
+#define _itkT1PreValueMapper_hxx
+#include "itkT1PreValueMapper.h"
+
+namespace itk
+{
+
+template<class TMaskImage>
+T1PreValueMapper<TMaskImage>::T1PreValueMapper(const MaskImageType* roiMask,
+                                               const MaskImageType* aifMask,
+                                               const MaskImageType* t1Map,
+                                               const RegionType& region,
+                                               float t1PreTissue,
+                                               float t1PreBlood)
+  : m_hasRoiMask(isValidMask(roiMask)),
+    m_hasAifMask(isValidMask(aifMask)),
+    m_hasT1Map(isValidMask(t1Map)),
+    m_T1PreTissue(t1PreTissue),
+    m_T1PreBlood(t1PreBlood)
+{
+  if (m_hasRoiMask) {
+    this->m_roiMaskVolumeIter = MaskConstIterType(roiMask, region);
+  }
+  if (m_hasAifMask) {
+    this->m_aifMaskVolumeIter = MaskConstIterType(aifMask, region);
+  }
+  if (m_hasT1Map) {
+    this->m_T1MapVolumeIter = MaskConstIterType(t1Map, region);
+  }
+  this->GoToBegin();
+}
+
+
+template<class TMaskImage>
+float
+T1PreValueMapper<TMaskImage>::Get() const
+{
+  float T1Pre = m_hasT1Map ? m_T1MapVolumeIter.Get() : m_T1PreTissue;
+  if (m_hasAifMask && m_aifMaskVolumeIter.Get()) {
+    T1Pre = m_T1PreBlood;
+  }
+  else if (m_hasRoiMask && !m_roiMaskVolumeIter.Get()) {
+    T1Pre = 0;
+  }
+  return T1Pre;
+}
+
+
+template<class TMaskImage>
+void
+T1PreValueMapper<TMaskImage>::GoToBegin()
+{
+  if (m_hasRoiMask) {
+    this->m_roiMaskVolumeIter.GoToBegin();
+  }
+  if (m_hasAifMask) {
+    this->m_aifMaskVolumeIter.GoToBegin();
+  }
+  if (m_hasT1Map) {
+    this->m_T1MapVolumeIter.GoToBegin();
+  }
+}
+
+
+template<class TMaskImage>
+T1PreValueMapper<TMaskImage>&
+T1PreValueMapper<TMaskImage>::operator++()
+{
+  if (m_hasRoiMask) {
+    ++(this->m_roiMaskVolumeIter);
+  }
+  if (m_hasAifMask) {
+    ++(this->m_aifMaskVolumeIter);
+  }
+  if (m_hasT1Map) {
+    ++(this->m_T1MapVolumeIter);
+  }
+  return *this;
+}
+
+
+template<class TMaskImage>
+bool
+T1PreValueMapper<TMaskImage>::isValidMask(const MaskImageType* inMask)
+{
+  return inMask && (inMask->GetBufferedRegion().GetSize()[0] != 0);
+}
+
+
+} // end namespace itk
+#endif
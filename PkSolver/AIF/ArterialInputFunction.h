@@ -1,6 +1,8 @@
 #ifndef __ArterialInputFunction_h
 #define __ArterialInputFunction_h
 
+#include "ParkerAIFModel.h"
+
 #include <vector>
 
 class ArterialInputFunction
@@ -12,6 +14,10 @@ public:
 
   virtual std::vector<float> getSignalValues() const = 0;
   virtual unsigned int getSignalSize() const = 0;
+
+  //! Parameters of the Parker form, if the AIF is generated from it.
+  //! Returns false if it is not.
+  virtual bool getParkerParameters(ParkerAIFModel::Parameters& /*parameters*/) const { return false; }
 };
 
 #endif
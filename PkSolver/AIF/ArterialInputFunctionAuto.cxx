@@ -0,0 +1,374 @@
+#include "ArterialInputFunctionAuto.h"
+
+#include "Exceptions.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  //! Peaks below this multiple of the baseline noise are not considered
+  const double MinimumContrastToNoise = 5.0;
+
+  //! Upper bound of the k-means iterations, it converges well before on a few candidates
+  const unsigned int MaximumClusterIterations = 100;
+}
+
+ArterialInputFunctionAuto::ArterialInputFunctionAuto(const VoxelCurveSource& curveSource,
+                                                     const ReferenceVolume* referenceVolume,
+                                                     const MaskVolume* searchMask,
+                                                     const std::vector<float>& signalTime,
+                                                     unsigned int numberOfCandidates)
+                                                     : m_signalTime(signalTime),
+                                                       m_numberOfCandidates(std::max(1u, numberOfCandidates))
+{
+  if (!referenceVolume) {
+    throw ImageNullException("Input image");
+  }
+  if (m_signalTime.size() != curveSource.getCurveSize()) {
+    throw AIFDetectionFailedException("timing does not match the number of frames");
+  }
+
+  m_aifMask = MaskVolume::New();
+  m_aifMask->SetRegions(referenceVolume->GetBufferedRegion());
+  m_aifMask->SetOrigin(referenceVolume->GetOrigin());
+  m_aifMask->SetSpacing(referenceVolume->GetSpacing());
+  m_aifMask->SetDirection(referenceVolume->GetDirection());
+  m_aifMask->Allocate();
+  m_aifMask->FillBuffer(0);
+
+  std::vector<Candidate> candidates;
+  findCandidates(curveSource, searchMask, candidates);
+  candidates = rejectPartialVolume(curveSource, candidates);
+  if (candidates.empty()) {
+    throw AIFDetectionFailedException("no voxel shows an arterial first pass");
+  }
+
+  for (std::size_t i = 0; i < candidates.size(); ++i)
+  {
+    m_aifMask->SetPixel(candidates[i].index, 1);
+  }
+  m_aif = ArterialInputFunctionAverageUnderMask(curveSource, m_aifMask).getSignalValues();
+}
+
+std::vector<float> ArterialInputFunctionAuto::getSignalValues() const
+{
+  return m_aif;
+}
+
+unsigned int ArterialInputFunctionAuto::getSignalSize() const
+{
+  return m_aif.size();
+}
+
+ArterialInputFunctionAuto::MaskVolume::Pointer ArterialInputFunctionAuto::getAIFMask() const
+{
+  return m_aifMask;
+}
+
+void ArterialInputFunctionAuto::findCandidates(const VoxelCurveSource& curveSource, const MaskVolume* searchMask,
+                                               std::vector<Candidate>& candidates) const
+{
+  // The volume is split into slabs along the slowest varying axis, each thread
+  // keeps its own best candidates
+  ThreadStruct str;
+  str.curveSource = &curveSource;
+  str.searchMask = searchMask;
+  str.aifMask = m_aifMask;
+  str.signalTime = &m_signalTime;
+  str.numberOfCandidates = m_numberOfCandidates;
+
+  itk::ThreadIdType numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  const itk::SizeValueType numberOfSlabs = m_aifMask->GetBufferedRegion().GetSize(2);
+  numberOfThreads = std::max<itk::ThreadIdType>(1, std::min<itk::SizeValueType>(numberOfThreads, numberOfSlabs));
+  str.candidates.resize(numberOfThreads);
+
+  if (numberOfSlabs > 0)
+  {
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(searchThreaderCallback, &str);
+    threader->SingleMethodExecute();
+  }
+
+  // Merge, the order of the candidates does not depend on the scheduling
+  candidates.clear();
+  for (itk::ThreadIdType t = 0; t < numberOfThreads; ++t)
+  {
+    candidates.insert(candidates.end(), str.candidates[t].begin(), str.candidates[t].end());
+  }
+  std::sort(candidates.begin(), candidates.end(), isBetterCandidate);
+  if (candidates.size() > m_numberOfCandidates)
+  {
+    candidates.resize(m_numberOfCandidates);
+  }
+}
+
+std::vector<ArterialInputFunctionAuto::Candidate>
+ArterialInputFunctionAuto::rejectPartialVolume(const VoxelCurveSource& curveSource,
+                                               const std::vector<Candidate>& candidates) const
+{
+  const std::size_t numberCandidates = candidates.size();
+  if (numberCandidates < 3)
+  {
+    return candidates;
+  }
+
+  const unsigned int curveSize = curveSource.getCurveSize();
+  std::vector<std::vector<float> > curves(numberCandidates, std::vector<float>(curveSize));
+  std::vector<float> peaks(numberCandidates);
+  for (std::size_t i = 0; i < numberCandidates; ++i)
+  {
+    curveSource.getCurve(candidates[i].index, &curves[i][0]);
+    peaks[i] = *std::max_element(curves[i].begin(), curves[i].end());
+  }
+
+  // Partial volume scales the first pass down, so two clusters are seeded
+  // with the highest and the lowest peak
+  const std::size_t highest = std::max_element(peaks.begin(), peaks.end()) - peaks.begin();
+  const std::size_t lowest = std::min_element(peaks.begin(), peaks.end()) - peaks.begin();
+  if (peaks[highest] == peaks[lowest])
+  {
+    return candidates;
+  }
+
+  std::vector<std::vector<double> > centroids(2);
+  centroids[0].assign(curves[highest].begin(), curves[highest].end());
+  centroids[1].assign(curves[lowest].begin(), curves[lowest].end());
+  std::vector<int> cluster(numberCandidates, -1);
+
+  for (unsigned int iteration = 0; iteration < MaximumClusterIterations; ++iteration)
+  {
+    bool changed = false;
+    for (std::size_t i = 0; i < numberCandidates; ++i)
+    {
+      double distance[2] = { 0.0, 0.0 };
+      for (int c = 0; c < 2; ++c)
+      {
+        for (unsigned int t = 0; t < curveSize; ++t)
+        {
+          const double difference = curves[i][t] - centroids[c][t];
+          distance[c] += difference * difference;
+        }
+      }
+      const int nearest = distance[1] < distance[0] ? 1 : 0;
+      if (nearest != cluster[i])
+      {
+        cluster[i] = nearest;
+        changed = true;
+      }
+    }
+    if (!changed)
+    {
+      break;
+    }
+
+    for (int c = 0; c < 2; ++c)
+    {
+      std::vector<double> sum(curveSize, 0.0);
+      long members = 0;
+      for (std::size_t i = 0; i < numberCandidates; ++i)
+      {
+        if (cluster[i] == c)
+        {
+          for (unsigned int t = 0; t < curveSize; ++t)
+          {
+            sum[t] += curves[i][t];
+          }
+          members++;
+        }
+      }
+      // an emptied cluster keeps its last centroid
+      if (members > 0)
+      {
+        for (unsigned int t = 0; t < curveSize; ++t)
+        {
+          centroids[c][t] = sum[t] / members;
+        }
+      }
+    }
+  }
+
+  const double peak0 = *std::max_element(centroids[0].begin(), centroids[0].end());
+  const double peak1 = *std::max_element(centroids[1].begin(), centroids[1].end());
+  const int arterialCluster = peak1 > peak0 ? 1 : 0;
+
+  std::vector<Candidate> arterialCandidates;
+  for (std::size_t i = 0; i < numberCandidates; ++i)
+  {
+    if (cluster[i] == arterialCluster)
+    {
+      arterialCandidates.push_back(candidates[i]);
+    }
+  }
+  return arterialCandidates;
+}
+
+ITK_THREAD_RETURN_TYPE ArterialInputFunctionAuto::searchThreaderCallback(void* arg)
+{
+  itk::MultiThreader::ThreadInfoStruct* info = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+  ThreadStruct* str = static_cast<ThreadStruct*>(info->UserData);
+  const itk::ThreadIdType threadId = info->ThreadID;
+  const itk::ThreadIdType numberOfThreads = str->candidates.size();
+  if (threadId >= numberOfThreads)
+  {
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  // Contiguous slab of the volume for this thread
+  MaskVolume::RegionType region = str->aifMask->GetBufferedRegion();
+  const itk::SizeValueType numberOfSlabs = region.GetSize(2);
+  const itk::SizeValueType begin = numberOfSlabs * threadId / numberOfThreads;
+  const itk::SizeValueType end = numberOfSlabs * (threadId + 1) / numberOfThreads;
+  region.SetIndex(2, region.GetIndex(2) + begin);
+  region.SetSize(2, end - begin);
+  if (end == begin)
+  {
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  const unsigned int curveSize = str->curveSource->getCurveSize();
+  std::vector<float> curve(curveSize);
+  std::vector<Candidate>& candidates = str->candidates[threadId];
+  candidates.reserve(str->numberOfCandidates);
+
+  MaskVolumeConstIterator voxelIter(str->aifMask, region);
+  itk::ImageRegionConstIterator<MaskVolume> searchMaskIter;
+  if (str->searchMask)
+  {
+    searchMaskIter = itk::ImageRegionConstIterator<MaskVolume>(str->searchMask, region);
+    searchMaskIter.GoToBegin();
+  }
+  for (voxelIter.GoToBegin(); !voxelIter.IsAtEnd(); ++voxelIter)
+  {
+    bool searched = true;
+    if (str->searchMask)
+    {
+      searched = searchMaskIter.Get() != 0;
+      ++searchMaskIter;
+    }
+    if (!searched)
+    {
+      continue;
+    }
+
+    Candidate candidate;
+    candidate.index = voxelIter.GetIndex();
+    str->curveSource->getCurve(candidate.index, &curve[0]);
+    if (scoreCurve(curveSize, &curve[0], *str->signalTime, candidate.score))
+    {
+      keepBestCandidate(candidate, str->numberOfCandidates, candidates);
+    }
+  }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+bool ArterialInputFunctionAuto::scoreCurve(unsigned int curveSize, const float* curve,
+                                           const std::vector<float>& signalTime, double& score)
+{
+  unsigned int peakIndex = 0;
+  for (unsigned int i = 0; i < curveSize; ++i)
+  {
+    if (!std::isfinite(curve[i]))
+    {
+      return false;
+    }
+    if (curve[i] > curve[peakIndex])
+    {
+      peakIndex = i;
+    }
+  }
+  const double peak = curve[peakIndex];
+  if (!(peak > 0.0))
+  {
+    return false;
+  }
+
+  // Frames around the peak at or above half of it
+  const double halfPeak = 0.5 * peak;
+  unsigned int first = peakIndex;
+  while (first > 0 && curve[first - 1] >= halfPeak)
+  {
+    --first;
+  }
+  unsigned int last = peakIndex;
+  while (last + 1 < curveSize && curve[last + 1] >= halfPeak)
+  {
+    ++last;
+  }
+
+  // The bolus has to arrive and wash out within the sequence. A single frame
+  // above half of the peak is a spike rather than a first pass.
+  if (first == 0 || last + 1 >= curveSize || first == last)
+  {
+    return false;
+  }
+
+  // Full width at half maximum, between the interpolated crossings
+  const double riseTime = signalTime[first - 1] + (halfPeak - curve[first - 1])
+    / (curve[first] - curve[first - 1]) * (signalTime[first] - signalTime[first - 1]);
+  const double fallTime = signalTime[last] + (curve[last] - halfPeak)
+    / (curve[last] - curve[last + 1]) * (signalTime[last + 1] - signalTime[last]);
+  const double width = fallTime - riseTime;
+  const double timeToPeak = signalTime[peakIndex] - signalTime[0];
+  if (!(width > 0.0) || !(timeToPeak > 0.0))
+  {
+    return false;
+  }
+
+  // Standard deviation of the frames before the bolus arrives
+  double mean = 0.0;
+  for (unsigned int i = 0; i < first; ++i)
+  {
+    mean += curve[i];
+  }
+  mean /= first;
+  double variance = 0.0;
+  for (unsigned int i = 0; i < first; ++i)
+  {
+    variance += (curve[i] - mean) * (curve[i] - mean);
+  }
+  const double noise = std::sqrt(variance / first);
+  if (peak < MinimumContrastToNoise * noise)
+  {
+    return false;
+  }
+
+  score = peak / (timeToPeak * width) * peak / (peak + noise);
+  return true;
+}
+
+bool ArterialInputFunctionAuto::isBetterCandidate(const Candidate& a, const Candidate& b)
+{
+  if (a.score != b.score)
+  {
+    return a.score > b.score;
+  }
+  // equal scores are ordered by position, to keep the selection deterministic
+  for (int d = MaskVolume::ImageDimension - 1; d >= 0; --d)
+  {
+    if (a.index[d] != b.index[d])
+    {
+      return a.index[d] < b.index[d];
+    }
+  }
+  return false;
+}
+
+void ArterialInputFunctionAuto::keepBestCandidate(const Candidate& candidate, unsigned int numberOfCandidates,
+                                                  std::vector<Candidate>& candidates)
+{
+  // candidates is a heap with the worst candidate in front
+  if (candidates.size() < numberOfCandidates)
+  {
+    candidates.push_back(candidate);
+    std::push_heap(candidates.begin(), candidates.end(), isBetterCandidate);
+  }
+  else if (isBetterCandidate(candidate, candidates.front()))
+  {
+    std::pop_heap(candidates.begin(), candidates.end(), isBetterCandidate);
+    candidates.back() = candidate;
+    std::push_heap(candidates.begin(), candidates.end(), isBetterCandidate);
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef __ArterialInputFunctionAuto_h
+#define __ArterialInputFunctionAuto_h
+
+#include "ArterialInputFunctionAverageUnderMask.h"
+
+#include "itkImageBase.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkMultiThreader.h"
+
+#include <vector>
+
+
+//! Detects the AIF voxels automatically and averages their concentration curves.
+//
+//! Every voxel is scored on the features of an arterial first pass: an early
+//! and high peak, a narrow peak and a low noise before the bolus arrives. The
+//! best scoring candidates are split in two clusters, the cluster with the
+//! lower peaks is dropped as partial volume. The remaining voxels make up the
+//! AIF mask, the AIF is the average of their curves.
+class ArterialInputFunctionAuto : public ArterialInputFunction
+{
+public:
+  typedef ArterialInputFunctionAverageUnderMask::VoxelCurveSource VoxelCurveSource;
+  typedef ArterialInputFunctionAverageUnderMask::MaskVolume       MaskVolume;
+  typedef itk::ImageBase<3>                                         ReferenceVolume;
+
+  //! curveSource : provides the concentration curves of the voxels.
+  //! referenceVolume : geometry of the voxels that are searched.
+  //! searchMask : optional, restricts the search to its non-zero voxels.
+  //! signalTime : sequence time of the curves.
+  //! numberOfCandidates : number of best scoring voxels that are clustered.
+  ArterialInputFunctionAuto(const VoxelCurveSource& curveSource, const ReferenceVolume* referenceVolume,
+                            const MaskVolume* searchMask, const std::vector<float>& signalTime,
+                            unsigned int numberOfCandidates = 20);
+
+  virtual ~ArterialInputFunctionAuto() {}
+
+  virtual std::vector<float> getSignalValues() const;
+  virtual unsigned int getSignalSize() const;
+
+  //! Voxels the AIF was averaged over (1), on the grid of the reference volume.
+  MaskVolume::Pointer getAIFMask() const;
+
+private:
+  typedef itk::ImageRegionConstIteratorWithIndex<MaskVolume> MaskVolumeConstIterator;
+
+  struct Candidate
+  {
+    MaskVolume::IndexType index;
+    double score;
+  };
+
+  //! Per thread best candidates of the search.
+  struct ThreadStruct
+  {
+    const VoxelCurveSource* curveSource;
+    const MaskVolume* searchMask;
+    const MaskVolume* aifMask;
+    const std::vector<float>* signalTime;
+    unsigned int numberOfCandidates;
+    std::vector<std::vector<Candidate> > candidates;
+  };
+
+  void findCandidates(const VoxelCurveSource& curveSource, const MaskVolume* searchMask,
+                      std::vector<Candidate>& candidates) const;
+  std::vector<Candidate> rejectPartialVolume(const VoxelCurveSource& curveSource,
+                                             const std::vector<Candidate>& candidates) const;
+
+  static ITK_THREAD_RETURN_TYPE searchThreaderCallback(void* arg);
+  static bool scoreCurve(unsigned int curveSize, const float* curve, const std::vector<float>& signalTime, double& score);
+  static bool isBetterCandidate(const Candidate& a, const Candidate& b);
+  static void keepBestCandidate(const Candidate& candidate, unsigned int numberOfCandidates, std::vector<Candidate>& candidates);
+
+  const std::vector<float> m_signalTime;
+  const unsigned int m_numberOfCandidates;
+  MaskVolume::Pointer m_aifMask;
+  std::vector<float> m_aif;
+};
+
+#endif
@@ -2,10 +2,12 @@
 
 #include "Exceptions.h"
 
+#include <algorithm>
+#include <limits>
+
 ArterialInputFunctionAverageUnderMask::ArterialInputFunctionAverageUnderMask(itk::VectorImage<float, 3>* inputVectorVolume,
-                                                                             itk::Image<unsigned short, 3>* maskVolume)
-                                                                             : m_inputVectorVolume(inputVectorVolume), 
-                                                                               m_maskVolume(maskVolume)
+                                                                             itk::Image<unsigned short, 3>* maskVolume,
+                                                                             MaskVolume::PixelType label)
 {
   if (!inputVectorVolume) {
     throw ImageNullException("Input image");
@@ -13,9 +15,19 @@ ArterialInputFunctionAverageUnderMask::ArterialInputFunctionAverageUnderMask(itk
   if (!maskVolume) {
     throw ImageNullException("AIF mask");
   }
-  m_inputVectorVolume->Update();
-  m_maskVolume->Update();
-  m_aif = computeAIF();
+  inputVectorVolume->Update();
+  maskVolume->Update();
+  m_aif = computeAIF(ImageCurveSource(inputVectorVolume), maskVolume, label);
+}
+
+ArterialInputFunctionAverageUnderMask::ArterialInputFunctionAverageUnderMask(const VoxelCurveSource& curveSource,
+                                                                             const MaskVolume* maskVolume,
+                                                                             MaskVolume::PixelType label)
+{
+  if (!maskVolume) {
+    throw ImageNullException("AIF mask");
+  }
+  m_aif = computeAIF(curveSource, maskVolume, label);
 }
 
 std::vector<float> ArterialInputFunctionAverageUnderMask::getSignalValues() const
@@ -28,50 +40,163 @@ unsigned int ArterialInputFunctionAverageUnderMask::getSignalSize() const
   return m_aif.size();
 }
 
-std::vector<float> ArterialInputFunctionAverageUnderMask::computeAIF() const
+std::vector<ArterialInputFunctionAverageUnderMask::MaskVolume::PixelType>
+ArterialInputFunctionAverageUnderMask::getLabels(const MaskVolume* maskVolume)
 {
-  VectorVolumeConstIterator inputVectorVolumeIter(m_inputVectorVolume, m_inputVectorVolume->GetRequestedRegion());
-  MaskVolumeConstIterator maskVolumeIter(m_maskVolume, m_maskVolume->GetRequestedRegion());
-  inputVectorVolumeIter.GoToBegin();
-  maskVolumeIter.GoToBegin();
+  std::vector<bool> present(static_cast<std::size_t>(std::numeric_limits<MaskVolume::PixelType>::max()) + 1, false);
+  MaskVolumeConstIterator maskVolumeIter(maskVolume, maskVolume->GetBufferedRegion());
+  for (maskVolumeIter.GoToBegin(); !maskVolumeIter.IsAtEnd(); ++maskVolumeIter)
+  {
+    present[maskVolumeIter.Get()] = true;
+  }
 
-  long numberVoxels = 0;
-  std::vector<float> aif(m_inputVectorVolume->GetNumberOfComponentsPerPixel(), 0.0);
+  std::vector<MaskVolume::PixelType> labels;
+  for (std::size_t label = 1; label < present.size(); ++label)
+  {
+    if (present[label])
+    {
+      labels.push_back(static_cast<MaskVolume::PixelType>(label));
+    }
+  }
+  return labels;
+}
+
+std::vector<float> ArterialInputFunctionAverageUnderMask::computeAIF(const VoxelCurveSource& curveSource, const MaskVolume* maskVolume,
+                                                                   MaskVolume::PixelType label) const
+{
+  const unsigned int curveSize = curveSource.getCurveSize();
 
-  while (!inputVectorVolumeIter.IsAtEnd())
+  // Only the bounding box of the mask is visited, split into slabs along the
+  // slowest varying axis that are summed up in parallel
+  ThreadStruct str;
+  str.curveSource = &curveSource;
+  str.maskVolume = maskVolume;
+  str.label = label;
+  str.boundingBox = getBoundingBox(maskVolume, label);
+
+  itk::ThreadIdType numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  const itk::SizeValueType numberOfSlabs = str.boundingBox.GetSize(2);
+  numberOfThreads = std::max<itk::ThreadIdType>(1, std::min<itk::SizeValueType>(numberOfThreads, numberOfSlabs));
+  str.sums.assign(numberOfThreads, std::vector<double>(curveSize, 0.0));
+  str.numberVoxels.assign(numberOfThreads, 0);
+
+  if (numberOfSlabs > 0)
   {
-    if (maskVolumeIter.Get())
+    itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+    threader->SetNumberOfThreads(numberOfThreads);
+    threader->SetSingleMethod(accumulateThreaderCallback, &str);
+    threader->SingleMethodExecute();
+  }
+
+  // Combine in a fixed order, so the result does not depend on scheduling
+  std::vector<double> sum(curveSize, 0.0);
+  long numberVoxels = 0;
+  for (itk::ThreadIdType t = 0; t < numberOfThreads; ++t)
+  {
+    for (unsigned int i = 0; i < curveSize; ++i)
     {
-      numberVoxels++;
-      VectorVoxel vectorVoxel = inputVectorVolumeIter.Get();
-      aif = add(aif, vectorVoxel);
+      sum[i] += str.sums[t][i];
     }
-    ++maskVolumeIter;
-    ++inputVectorVolumeIter;
+    numberVoxels += str.numberVoxels[t];
   }
 
-  return divide(aif, numberVoxels);
+  std::vector<float> aif(curveSize);
+  for (unsigned int i = 0; i < curveSize; ++i)
+  {
+    aif[i] = static_cast<float>(sum[i] / numberVoxels);
+  }
+  return aif;
 }
 
-inline
-std::vector<float> ArterialInputFunctionAverageUnderMask::add(std::vector<float> vec1, const VectorVoxel& vec2) const
+ITK_THREAD_RETURN_TYPE ArterialInputFunctionAverageUnderMask::accumulateThreaderCallback(void* arg)
 {
-  for (long i = 0; i < vec1.size(); i++)
+  itk::MultiThreader::ThreadInfoStruct* info = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+  ThreadStruct* str = static_cast<ThreadStruct*>(info->UserData);
+  const itk::ThreadIdType threadId = info->ThreadID;
+  const itk::ThreadIdType numberOfThreads = str->sums.size();
+  if (threadId >= numberOfThreads)
   {
-    vec1[i] += vec2[i];
+    return ITK_THREAD_RETURN_VALUE;
   }
-  return vec1;
+
+  // Contiguous slab of the bounding box for this thread
+  MaskVolume::RegionType region = str->boundingBox;
+  const itk::SizeValueType numberOfSlabs = region.GetSize(2);
+  const itk::SizeValueType begin = numberOfSlabs * threadId / numberOfThreads;
+  const itk::SizeValueType end = numberOfSlabs * (threadId + 1) / numberOfThreads;
+  region.SetIndex(2, region.GetIndex(2) + begin);
+  region.SetSize(2, end - begin);
+  if (end == begin)
+  {
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  std::vector<double>& sum = str->sums[threadId];
+  std::vector<float> curve(sum.size());
+  long numberVoxels = 0;
+
+  MaskVolumeConstIterator maskVolumeIter(str->maskVolume, region);
+  for (maskVolumeIter.GoToBegin(); !maskVolumeIter.IsAtEnd(); ++maskVolumeIter)
+  {
+    if (isInMask(maskVolumeIter.Get(), str->label))
+    {
+      numberVoxels++;
+      str->curveSource->getCurve(maskVolumeIter.GetIndex(), &curve[0]);
+      for (unsigned int i = 0; i < curve.size(); ++i)
+      {
+        sum[i] += curve[i];
+      }
+    }
+  }
+  str->numberVoxels[threadId] = numberVoxels;
+
+  return ITK_THREAD_RETURN_VALUE;
 }
 
-inline
-std::vector<float> ArterialInputFunctionAverageUnderMask::divide(std::vector<float> vec, long div) const
+ArterialInputFunctionAverageUnderMask::MaskVolume::RegionType ArterialInputFunctionAverageUnderMask::getBoundingBox(const MaskVolume* maskVolume,
+                                                                                                                    MaskVolume::PixelType label)
 {
-  for (long i = 0; i < vec.size(); i++)
+  const MaskVolume::RegionType bufferedRegion = maskVolume->GetBufferedRegion();
+  MaskVolume::IndexType lower = bufferedRegion.GetUpperIndex();
+  MaskVolume::IndexType upper = bufferedRegion.GetIndex();
+  bool empty = true;
+
+  MaskVolumeConstIterator maskVolumeIter(maskVolume, bufferedRegion);
+  for (maskVolumeIter.GoToBegin(); !maskVolumeIter.IsAtEnd(); ++maskVolumeIter)
   {
-    vec[i] /= div;
+    if (isInMask(maskVolumeIter.Get(), label))
+    {
+      const MaskVolume::IndexType index = maskVolumeIter.GetIndex();
+      for (unsigned int d = 0; d < MaskVolume::ImageDimension; ++d)
+      {
+        lower[d] = std::min(lower[d], index[d]);
+        upper[d] = std::max(upper[d], index[d]);
+      }
+      empty = false;
+    }
   }
-  return vec;
-}
 
+  MaskVolume::RegionType boundingBox;
+  if (!empty)
+  {
+    boundingBox.SetIndex(lower);
+    boundingBox.SetUpperIndex(upper);
+  }
+  else
+  {
+    boundingBox.SetIndex(bufferedRegion.GetIndex());
+  }
+  return boundingBox;
+}
 
+unsigned int ArterialInputFunctionAverageUnderMask::ImageCurveSource::getCurveSize() const
+{
+  return m_volume->GetNumberOfComponentsPerPixel();
+}
 
+void ArterialInputFunctionAverageUnderMask::ImageCurveSource::getCurve(const MaskVolume::IndexType& index, float* curve) const
+{
+  const unsigned int curveSize = m_volume->GetNumberOfComponentsPerPixel();
+  const float* pixel = m_volume->GetBufferPointer() + m_volume->ComputeOffset(index) * curveSize;
+  std::copy(pixel, pixel + curveSize, curve);
+}
@@ -6,6 +6,7 @@
 #include "itkImage.h"
 #include "itkVectorImage.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkMultiThreader.h"
 
 
 class ArterialInputFunctionAverageUnderMask : public ArterialInputFunction
@@ -14,24 +15,71 @@ public:
   typedef itk::VectorImage<float, 3> VectorVolume;
   typedef itk::Image<unsigned short, 3> MaskVolume;
 
-  ArterialInputFunctionAverageUnderMask(VectorVolume* inputVectorVolume, MaskVolume* maskVolume);
+  //! Supplies the concentration curve of a single voxel, so only the voxels
+  //! under the mask have to be computed. Called from several threads at once.
+  class VoxelCurveSource
+  {
+  public:
+    virtual ~VoxelCurveSource() {}
+
+    virtual unsigned int getCurveSize() const = 0;
+    virtual void getCurve(const MaskVolume::IndexType& index, float* curve) const = 0;
+  };
+
+  //! Average of the curves of a concentration image under the mask.
+  //! With a label other than 0 only the voxels with this label are averaged.
+  ArterialInputFunctionAverageUnderMask(VectorVolume* inputVectorVolume, MaskVolume* maskVolume,
+                                        MaskVolume::PixelType label = 0);
+
+  //! Average of the curves curveSource provides for the voxels under the mask.
+  //! With a label other than 0 only the voxels with this label are averaged.
+  ArterialInputFunctionAverageUnderMask(const VoxelCurveSource& curveSource, const MaskVolume* maskVolume,
+                                        MaskVolume::PixelType label = 0);
 
   virtual ~ArterialInputFunctionAverageUnderMask() {}
 
   virtual std::vector<float> getSignalValues() const;
   virtual unsigned int getSignalSize() const;
 
+  //! Non-zero labels of a label map mask, in ascending order.
+  static std::vector<MaskVolume::PixelType> getLabels(const MaskVolume* maskVolume);
+
 private:
-  typedef itk::ImageRegionConstIterator<VectorVolume> VectorVolumeConstIterator;
   typedef itk::ImageRegionConstIterator<MaskVolume> MaskVolumeConstIterator;
-  typedef itk::VariableLengthVector<float> VectorVoxel;
 
-  std::vector<float> computeAIF() const;
-  inline std::vector<float> add(std::vector<float> vec1, const VectorVoxel& vec2) const;
-  inline std::vector<float> divide(std::vector<float> vec, long div) const;
+  //! Reads the curves straight from the buffer of a concentration image.
+  class ImageCurveSource : public VoxelCurveSource
+  {
+  public:
+    ImageCurveSource(const VectorVolume* volume) : m_volume(volume) {}
+
+    virtual unsigned int getCurveSize() const;
+    virtual void getCurve(const MaskVolume::IndexType& index, float* curve) const;
+
+  private:
+    const VectorVolume* const m_volume;
+  };
+
+  //! Per thread partial sums of the reduction.
+  struct ThreadStruct
+  {
+    const VoxelCurveSource* curveSource;
+    const MaskVolume* maskVolume;
+    MaskVolume::PixelType label;
+    MaskVolume::RegionType boundingBox;
+    std::vector<std::vector<double> > sums;
+    std::vector<long> numberVoxels;
+  };
+
+  std::vector<float> computeAIF(const VoxelCurveSource& curveSource, const MaskVolume* maskVolume,
+                                MaskVolume::PixelType label) const;
+  static MaskVolume::RegionType getBoundingBox(const MaskVolume* maskVolume, MaskVolume::PixelType label);
+  static bool isInMask(MaskVolume::PixelType maskValue, MaskVolume::PixelType label)
+  {
+    return label ? maskValue == label : maskValue != 0;
+  }
+  static ITK_THREAD_RETURN_TYPE accumulateThreaderCallback(void* arg);
 
-  itk::VectorImage<float, 3>* const m_inputVectorVolume;
-  itk::Image<unsigned short, 3>* const m_maskVolume;
   std::vector<float> m_aif;
 };
 
@@ -26,6 +26,22 @@ unsigned int ArterialInputFunctionPopulation::getSignalSize() const
   return m_aif.size();
 }
 
+bool ArterialInputFunctionPopulation::getParkerParameters(ParkerAIFModel::Parameters& parameters) const
+{
+  parameters = ParkerAIFModel::populationParameters(computeBolusArrivalTime() / 60.0);
+  return true;
+}
+
+float ArterialInputFunctionPopulation::computeBolusArrivalTime() const
+{
+  // Same time axis as in computeAIF()
+  const std::size_t n = m_referenceSignalTime.size() * 10;
+  const float final_time_point = m_referenceSignalTime[m_referenceSignalTime.size() - 1];
+  const float resolution = final_time_point / (n - 1);
+  const std::size_t bolus_arrival_time_idx = n * m_bolusArrivalTimeFraction;
+  return resolution * bolus_arrival_time_idx;
+}
+
 std::vector<float> ArterialInputFunctionPopulation::computeAIF() const
 {
   std::vector<float> AIF;
@@ -24,9 +24,14 @@ public:
   virtual std::vector<float> getSignalValues() const;
   virtual unsigned int getSignalSize() const;
 
+  virtual bool getParkerParameters(ParkerAIFModel::Parameters& parameters) const;
+
 private:
   std::vector<float> computeAIF() const;
 
+  //! Time of the bolus arrival on the high resolution time axis, in seconds
+  float computeBolusArrivalTime() const;
+
   const std::vector<float> m_referenceSignalTime;
   const float m_bolusArrivalTimeFraction;
   std::vector<float> m_aif;
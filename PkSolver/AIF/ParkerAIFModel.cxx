@@ -0,0 +1,367 @@
+#include "ParkerAIFModel.h"
+
+#include "itkLevenbergMarquardtOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+// work around compile error on Windows
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+namespace
+{
+  //! Panels per rise time 1/s of the sigmoid
+  const double PanelsPerRise = 8.0;
+
+  //! Upper bound of the panels per interval, reached only for absurdly steep sigmoids
+  const std::size_t MaximumPanels = 10000;
+
+  const unsigned int NumberOfParameters = 11;
+
+  ParkerAIFModel::Parameters toParameters(const itk::Array<double>& p)
+  {
+    ParkerAIFModel::Parameters parameters;
+    parameters.a1 = p[0];
+    parameters.a2 = p[1];
+    parameters.T1 = p[2];
+    parameters.T2 = p[3];
+    parameters.sigma1 = p[4];
+    parameters.sigma2 = p[5];
+    parameters.alpha = p[6];
+    parameters.beta = p[7];
+    parameters.s = p[8];
+    parameters.tau = p[9];
+    parameters.arrival = p[10];
+    return parameters;
+  }
+
+  itk::Array<double> toArray(const ParkerAIFModel::Parameters& parameters)
+  {
+    itk::Array<double> p(NumberOfParameters);
+    p[0] = parameters.a1;
+    p[1] = parameters.a2;
+    p[2] = parameters.T1;
+    p[3] = parameters.T2;
+    p[4] = parameters.sigma1;
+    p[5] = parameters.sigma2;
+    p[6] = parameters.alpha;
+    p[7] = parameters.beta;
+    p[8] = parameters.s;
+    p[9] = parameters.tau;
+    p[10] = parameters.arrival;
+    return p;
+  }
+
+  double sigmoidTerm(const ParkerAIFModel::Parameters& parameters, double t)
+  {
+    return parameters.alpha * exp(-parameters.beta * t) / (1 + exp(-parameters.s * (t - parameters.tau)));
+  }
+
+  //! Residuals of the Parker form against a sampled AIF
+  class ParkerFitCostFunction : public itk::MultipleValuedCostFunction
+  {
+  public:
+    typedef ParkerFitCostFunction           Self;
+    typedef itk::MultipleValuedCostFunction Superclass;
+    typedef itk::SmartPointer<Self>         Pointer;
+    typedef itk::SmartPointer<const Self>   ConstPointer;
+    itkNewMacro(Self);
+
+    typedef Superclass::ParametersType ParametersType;
+    typedef Superclass::DerivativeType DerivativeType;
+    typedef Superclass::MeasureType    MeasureType;
+
+    void SetData(const std::vector<float>& timeMinute, const std::vector<float>& aif)
+    {
+      m_Time = timeMinute;
+      m_AIF = aif;
+    }
+
+    MeasureType GetValue(const ParametersType& parameters) const
+    {
+      const ParkerAIFModel::Parameters parkerParameters = toParameters(parameters);
+      MeasureType measure(m_AIF.size());
+      for (std::size_t i = 0; i < m_AIF.size(); ++i)
+      {
+        measure[i] = ParkerAIFModel::evaluate(parkerParameters, m_Time[i]) - m_AIF[i];
+      }
+      return measure;
+    }
+
+    //Not going to be used
+    void GetDerivative(const ParametersType& /*parameters*/, DerivativeType& /*derivative*/) const
+    {
+    }
+
+    unsigned int GetNumberOfParameters() const
+    {
+      return NumberOfParameters;
+    }
+
+    unsigned int GetNumberOfValues() const
+    {
+      return m_AIF.size();
+    }
+
+  protected:
+    ParkerFitCostFunction() {}
+    virtual ~ParkerFitCostFunction() {}
+
+  private:
+    std::vector<float> m_Time;
+    std::vector<float> m_AIF;
+  };
+}
+
+ParkerAIFModel::Parameters ParkerAIFModel::populationParameters(double arrival)
+{
+  Parameters parameters;
+  parameters.a1 = 0.809;
+  parameters.a2 = 0.330;
+  parameters.T1 = 0.17406;
+  parameters.T2 = 0.365;
+  parameters.sigma1 = 0.0563;
+  parameters.sigma2 = 0.132;
+  parameters.alpha = 1.050;
+  parameters.beta = 0.1685;
+  parameters.s = 38.078;
+  parameters.tau = 0.483;
+  parameters.arrival = arrival;
+  return parameters;
+}
+
+ParkerAIFModel::Parameters ParkerAIFModel::fit(const std::vector<float>& timeMinute, const std::vector<float>& aif)
+{
+  // Initial guess: the population average, moved to the peak of the AIF and
+  // scaled to its height
+  const std::size_t peakIndex = std::max_element(aif.begin(), aif.end()) - aif.begin();
+  Parameters initial = populationParameters(0.0);
+  double populationPeakTime = 0.0;
+  for (double t = 0.0; t < 2.0; t += 0.001)
+  {
+    if (evaluate(initial, t) > evaluate(initial, populationPeakTime))
+    {
+      populationPeakTime = t;
+    }
+  }
+  initial.arrival = timeMinute[peakIndex] - populationPeakTime;
+  const double populationPeak = evaluate(initial, timeMinute[peakIndex]);
+  if (aif[peakIndex] > 0 && populationPeak > 0)
+  {
+    const double scale = aif[peakIndex] / populationPeak;
+    initial.a1 *= scale;
+    initial.a2 *= scale;
+    initial.alpha *= scale;
+  }
+
+  ParkerFitCostFunction::Pointer costFunction = ParkerFitCostFunction::New();
+  costFunction->SetData(timeMinute, aif);
+
+  itk::LevenbergMarquardtOptimizer::Pointer optimizer = itk::LevenbergMarquardtOptimizer::New();
+  optimizer->UseCostFunctionGradientOff();
+  optimizer->SetCostFunction(costFunction);
+  itk::LevenbergMarquardtOptimizer::InternalOptimizerType* vnlOptimizer = optimizer->GetOptimizer();
+  vnlOptimizer->set_f_tolerance(1e-6);
+  vnlOptimizer->set_g_tolerance(1e-6);
+  vnlOptimizer->set_x_tolerance(1e-8);
+  vnlOptimizer->set_epsilon_function(1e-9);
+  vnlOptimizer->set_max_function_evals(2000);
+  optimizer->SetInitialPosition(toArray(initial));
+
+  try
+  {
+    optimizer->StartOptimization();
+  }
+  catch (itk::ExceptionObject&)
+  {
+    return initial;
+  }
+
+  Parameters fitted = toParameters(optimizer->GetCurrentPosition());
+  fitted.sigma1 = std::fabs(fitted.sigma1);
+  fitted.sigma2 = std::fabs(fitted.sigma2);
+  const itk::Array<double> p = toArray(fitted);
+  for (unsigned int i = 0; i < NumberOfParameters; ++i)
+  {
+    if (!std::isfinite(p[i]))
+    {
+      return initial;
+    }
+  }
+  return fitted;
+}
+
+double ParkerAIFModel::evaluate(const Parameters& parameters, double t)
+{
+  // time since the bolus arrived
+  t -= parameters.arrival;
+  if (t < 0.0)
+  {
+    return 0.0;
+  }
+  const double sigma1 = std::fabs(parameters.sigma1);
+  const double sigma2 = std::fabs(parameters.sigma2);
+  const double A1 = parameters.a1 / (sigma1 * pow((2 * M_PI), 0.5));
+  const double A2 = parameters.a2 / (sigma2 * pow((2 * M_PI), 0.5));
+  return sigmoidTerm(parameters, t)
+    + A1 * exp(-(t - parameters.T1) * (t - parameters.T1) / (2.0 * sigma1 * sigma1))
+    + A2 * exp(-(t - parameters.T2) * (t - parameters.T2) / (2.0 * sigma2 * sigma2));
+}
+
+ParkerAIFModel::ParkerAIFModel(const Parameters& parameters, const std::vector<float>& timeMinute)
+  : m_parameters(parameters),
+    m_time(timeMinute.begin(), timeMinute.end())
+{
+  m_samples.resize(m_time.size());
+  for (std::size_t i = 0; i < m_time.size(); ++i)
+  {
+    m_samples[i] = evaluate(m_parameters, m_time[i]);
+  }
+
+  // The sigmoid rises within about 1/s, the panels have to resolve that
+  const double maximumPanelLength = 1.0 / (PanelsPerRise * std::max(std::fabs(m_parameters.s), 1e-6));
+  m_panels.resize(m_time.size());
+  m_panelLength.resize(m_time.size());
+  m_sigmoidBegin.resize(m_time.size());
+  for (std::size_t i = 0; i < m_time.size(); ++i)
+  {
+    const double intervalBegin = std::max(i > 0 ? m_time[i - 1] : std::min(m_time[0], m_parameters.arrival), m_parameters.arrival);
+    const double intervalEnd = m_time[i];
+    m_sigmoidBegin[i] = m_sigmoid.size();
+    m_panels[i] = 0;
+    m_panelLength[i] = 0.0;
+    if (intervalEnd > intervalBegin)
+    {
+      m_panels[i] = std::min(MaximumPanels,
+        std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil((intervalEnd - intervalBegin) / maximumPanelLength))));
+      m_panelLength[i] = (intervalEnd - intervalBegin) / m_panels[i];
+      for (std::size_t n = 0; n <= 2 * m_panels[i]; ++n)
+      {
+        const double u = intervalBegin + 0.5 * n * m_panelLength[i];
+        m_sigmoid.push_back(sigmoidTerm(m_parameters, u - m_parameters.arrival));
+      }
+    }
+  }
+}
+
+void ParkerAIFModel::convolveExponential(double k, double* convolved) const
+{
+  if (!std::isfinite(k))
+  {
+    // the exponential collapses to nothing
+    std::fill(convolved, convolved + m_time.size(), 0.0);
+    return;
+  }
+
+  const double sigma1 = std::fabs(m_parameters.sigma1);
+  const double sigma2 = std::fabs(m_parameters.sigma2);
+  const double A1 = m_parameters.a1 / (sigma1 * pow((2 * M_PI), 0.5));
+  const double A2 = m_parameters.a2 / (sigma2 * pow((2 * M_PI), 0.5));
+
+  // The sigmoid term carries over from one panel to the next, decayed by
+  // the exponential, so only the new panel has to be integrated
+  double sigmoid = 0.0;
+  for (std::size_t i = 0; i < m_time.size(); ++i)
+  {
+    if (m_panels[i] > 0)
+    {
+      // An interval starts at the previous time point or at the arrival,
+      // where the sigmoid term is still 0
+      double decay, weights[3];
+      panelWeights(k * m_panelLength[i], m_panelLength[i], decay, weights);
+      const double* f = &m_sigmoid[m_sigmoidBegin[i]];
+      for (std::size_t p = 0; p < m_panels[i]; ++p, f += 2)
+      {
+        sigmoid = decay * sigmoid + weights[0] * f[0] + weights[1] * f[1] + weights[2] * f[2];
+      }
+    }
+
+    double gaussians = 0.0;
+    const double t = m_time[i] - m_parameters.arrival;
+    if (t > 0.0)
+    {
+      gaussians = convolveGaussian(k, t, A1, m_parameters.T1, sigma1)
+        + convolveGaussian(k, t, A2, m_parameters.T2, sigma2);
+    }
+    convolved[i] = sigmoid + gaussians;
+  }
+}
+
+double ParkerAIFModel::convolveGaussian(double k, double t, double A, double T, double sigma)
+{
+  // Completing the square gives
+  //   A exp(a) sigma sqrt(pi/2) (erf(x1) - erf(x0))
+  // with c = T + k sigma^2, a = -k t + k T + k^2 sigma^2 / 2,
+  // x1 = (t - c) / (sigma sqrt(2)) and x0 = -c / (sigma sqrt(2)).
+  // exp(a) and the erfs over- and underflow for large k, so the difference
+  // is written with erfcx, where the exponents simplify to
+  //   a - x1^2 = -(t - T)^2 / (2 sigma^2)
+  //   a - x0^2 = -k t - T^2 / (2 sigma^2)
+  const double sqrt2Sigma = sqrt(2.0) * sigma;
+  const double c = T + k * sigma * sigma;
+  const double x0 = -c / sqrt2Sigma;
+  const double x1 = (t - c) / sqrt2Sigma;
+  const double end1 = exp(-(t - T) * (t - T) / (2.0 * sigma * sigma));
+  const double end0 = exp(-k * t - T * T / (2.0 * sigma * sigma));
+
+  double difference;
+  if (x0 >= 0.0)
+  {
+    difference = end0 * erfcx(x0) - end1 * erfcx(x1);
+  }
+  else if (x1 <= 0.0)
+  {
+    difference = end1 * erfcx(-x1) - end0 * erfcx(-x0);
+  }
+  else
+  {
+    const double a = -k * (t - T) + 0.5 * k * k * sigma * sigma;
+    difference = 2.0 * exp(a) - end1 * erfcx(x1) - end0 * erfcx(-x0);
+  }
+  return A * sigma * sqrt(0.5 * M_PI) * difference;
+}
+
+void ParkerAIFModel::panelWeights(double z, double h, double& decay, double* weights)
+{
+  // Moments m_n = Int_0^1 x^n exp(-z (1-x)) dx of the panel, scaled to [0, 1]
+  double m[3];
+  decay = exp(-z);
+  if (std::fabs(z) < 1.0)
+  {
+    // m_n = sum_j (-z)^j n! / (n+j+1)!, the recurrence below cancels here
+    for (int n = 0; n < 3; ++n)
+    {
+      double term = 1.0 / (n + 1);
+      m[n] = term;
+      for (int j = 1; j < 25; ++j)
+      {
+        term *= -z / (n + j + 1);
+        m[n] += term;
+      }
+    }
+  }
+  else
+  {
+    m[0] = (1.0 - decay) / z;
+    m[1] = (1.0 - m[0]) / z;
+    m[2] = (1.0 - 2.0 * m[1]) / z;
+  }
+
+  // Integrals of the quadratic Lagrange polynomials through 0, 1/2 and 1
+  weights[0] = h * (2.0 * m[2] - 3.0 * m[1] + m[0]);
+  weights[1] = h * (4.0 * m[1] - 4.0 * m[2]);
+  weights[2] = h * (2.0 * m[2] - m[1]);
+}
+
+double ParkerAIFModel::erfcx(double x)
+{
+  if (x < 10.0)
+  {
+    return exp(x * x) * std::erfc(x);
+  }
+  // asymptotic expansion, accurate to double precision this far out
+  const double x2 = 1.0 / (x * x);
+  return (1.0 - x2 * (0.5 - x2 * (0.75 - x2 * (1.875 - x2 * 6.5625)))) / (x * sqrt(M_PI));
+}
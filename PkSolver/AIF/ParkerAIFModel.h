@@ -0,0 +1,89 @@
+#ifndef __ParkerAIFModel_h
+#define __ParkerAIFModel_h
+
+#include <cstddef>
+#include <vector>
+
+//! Functional form of the Parker AIF and its convolution with an exponential
+//! in closed form, on a fixed time axis.
+//
+//! Cp(t) = A1 exp(-(t-T1)^2/(2 sigma1^2)) + A2 exp(-(t-T2)^2/(2 sigma2^2))
+//!         + alpha exp(-beta t) / (1 + exp(-s (t-tau)))
+//! with t in minutes since the bolus arrival and Ai = ai / (sigmai sqrt(2 pi)).
+//
+//! The Tofts model needs Int_0^t Cp(u) exp(-k (t-u)) du for every evaluation
+//! of the cost function. For the Gaussian terms this is a difference of erfs,
+//! evaluated in a form that does not overflow for large k. The sigmoid term
+//! has no elementary closed form. It is interpolated quadratically on panels
+//! much shorter than its rise, the product with the exponential is then
+//! integrated exactly. The sigmoid values only depend on the time axis and
+//! are computed once, each evaluation is linear in the number of panels.
+//
+//! See "Experimentally-Derived Functional Form for a Population-Averaged High-
+//! Temporal-Resolution Arterial Input Function for Dynamic Contrast-Enhanced
+//! MRI" - Parker et al. Magnetic Resonance in Medicine 56:993-1000 (2006)
+class ParkerAIFModel
+{
+public:
+  struct Parameters
+  {
+    double a1;
+    double a2;
+    double T1;
+    double T2;
+    double sigma1;
+    double sigma2;
+    double alpha;
+    double beta;
+    double s;
+    double tau;
+    //! Bolus arrival time on the time axis of the model, in minutes
+    double arrival;
+  };
+
+  //! Parameters of the population average, with the bolus arriving at arrival
+  static Parameters populationParameters(double arrival);
+
+  //! Least squares fit of the parameters to an AIF sampled at timeMinute.
+  //! Starts from the population average scaled to the peak of the AIF.
+  static Parameters fit(const std::vector<float>& timeMinute, const std::vector<float>& aif);
+
+  //! Value of the AIF at time t, in minutes
+  static double evaluate(const Parameters& parameters, double t);
+
+  ParkerAIFModel(const Parameters& parameters, const std::vector<float>& timeMinute);
+
+  const Parameters& getParameters() const { return m_parameters; }
+
+  //! AIF at the time points of the model
+  const std::vector<double>& getSamples() const { return m_samples; }
+
+  //! Int_0^t Cp(u) exp(-k (t-u)) du at the time points of the model.
+  //! Thread safe, writes one value per time point to convolved.
+  void convolveExponential(double k, double* convolved) const;
+
+private:
+  //! Int_0^t A exp(-(u-T)^2/(2 sigma^2)) exp(-k (t-u)) du
+  static double convolveGaussian(double k, double t, double A, double T, double sigma);
+
+  //! Integration weights of the values at the start, center and end of a
+  //! panel of length h against exp(-k (end-u)), with z = k h. decay is exp(-z).
+  static void panelWeights(double z, double h, double& decay, double* weights);
+
+  //! exp(x^2) erfc(x) for x >= 0
+  static double erfcx(double x);
+
+  Parameters m_parameters;
+  std::vector<double> m_time;
+  std::vector<double> m_samples;
+
+  // The sigmoid term on [t_{i-1}, t_i] (from the arrival, if later) is split
+  // into m_panels[i] panels of length m_panelLength[i]. m_sigmoid holds its
+  // values at the ends and centers of the panels, from m_sigmoidBegin[i] on.
+  std::vector<std::size_t> m_panels;
+  std::vector<double> m_panelLength;
+  std::vector<std::size_t> m_sigmoidBegin;
+  std::vector<double> m_sigmoid;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "SignalToConcentrationCurveSource.h"
+
+#include "Exceptions.h"
+
+#include <algorithm>
+
+namespace
+{
+  template <typename T>
+  void copySignal(const T* signal, unsigned int curveSize, float* curve)
+  {
+    for (unsigned int i = 0; i < curveSize; ++i) {
+      curve[i] = static_cast<float>(signal[i]);
+    }
+  }
+
+  template <typename TVolume>
+  const void* bufferOrNull(const TVolume* volume)
+  {
+    return volume ? volume->GetBufferPointer() : NULL;
+  }
+}
+
+SignalToConcentrationCurveSource::SignalToConcentrationCurveSource(const VectorVolume* signalVolume,
+                                                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                                                   float S0GradThresh,
+                                                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
+  : SignalToConcentrationCurveSource(signalVolume, bufferOrNull(signalVolume), FLOAT_SIGNAL,
+                                     T1PreBlood, TR, FA, relaxivity, S0GradThresh, batEstimator)
+{}
+
+SignalToConcentrationCurveSource::SignalToConcentrationCurveSource(const ShortVectorVolume* signalVolume,
+                                                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                                                   float S0GradThresh,
+                                                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
+  : SignalToConcentrationCurveSource(signalVolume, bufferOrNull(signalVolume), SHORT_SIGNAL,
+                                     T1PreBlood, TR, FA, relaxivity, S0GradThresh, batEstimator)
+{}
+
+SignalToConcentrationCurveSource::SignalToConcentrationCurveSource(const UShortVectorVolume* signalVolume,
+                                                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                                                   float S0GradThresh,
+                                                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
+  : SignalToConcentrationCurveSource(signalVolume, bufferOrNull(signalVolume), USHORT_SIGNAL,
+                                     T1PreBlood, TR, FA, relaxivity, S0GradThresh, batEstimator)
+{}
+
+SignalToConcentrationCurveSource::SignalToConcentrationCurveSource(const itk::ImageBase<3>* signalVolume,
+                                                                   const void* signalBuffer, SignalType signalType,
+                                                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                                                   float S0GradThresh,
+                                                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
+                                                                   : m_signalVolume(signalVolume),
+                                                                     m_signalBuffer(signalBuffer),
+                                                                     m_signalType(signalType),
+                                                                     m_converter(T1PreBlood, TR, FA, relaxivity),
+                                                                     m_S0GradThresh(S0GradThresh),
+                                                                     m_batEstimator(batEstimator)
+{
+  if (!signalVolume) {
+    throw ImageNullException("Input image");
+  }
+}
+
+unsigned int SignalToConcentrationCurveSource::getCurveSize() const
+{
+  return m_signalVolume->GetNumberOfComponentsPerPixel();
+}
+
+void SignalToConcentrationCurveSource::getCurve(const MaskVolume::IndexType& index, float* curve) const
+{
+  const unsigned int curveSize = m_signalVolume->GetNumberOfComponentsPerPixel();
+  const std::size_t offset = m_signalVolume->ComputeOffset(index) * curveSize;
+  switch (m_signalType) {
+    case FLOAT_SIGNAL:
+      copySignal(static_cast<const float*>(m_signalBuffer) + offset, curveSize, curve);
+      break;
+    case SHORT_SIGNAL:
+      copySignal(static_cast<const short*>(m_signalBuffer) + offset, curveSize, curve);
+      break;
+    case USHORT_SIGNAL:
+      copySignal(static_cast<const unsigned short*>(m_signalBuffer) + offset, curveSize, curve);
+      break;
+  }
+
+  int BATIndex = -1;
+  try {
+    BATIndex = m_batEstimator->getBATIndex(curveSize, curve);
+  }
+  catch (...)
+  {
+  }
+  const float S0 = itk::compute_s0_individual_curve(curveSize, curve, m_S0GradThresh, BATIndex);
+
+  // the conversion works point by point, so it can be done in place
+  m_converter.convert(curveSize, curve, S0, curve);
+}
@@ -0,0 +1,55 @@
+#ifndef __SignalToConcentrationCurveSource_h
+#define __SignalToConcentrationCurveSource_h
+
+#include "ArterialInputFunctionAverageUnderMask.h"
+#include "PkSolver.h"
+
+
+//! Converts the signal intensity curves of single voxels to concentrations,
+//! using the blood T1Pre. Lets ArterialInputFunctionAverageUnderMask
+//! compute the AIF without the whole 4D concentration image.
+class SignalToConcentrationCurveSource : public ArterialInputFunctionAverageUnderMask::VoxelCurveSource
+{
+public:
+  typedef ArterialInputFunctionAverageUnderMask::VectorVolume VectorVolume;
+  typedef ArterialInputFunctionAverageUnderMask::MaskVolume   MaskVolume;
+  typedef itk::VectorImage<short, 3>                          ShortVectorVolume;
+  typedef itk::VectorImage<unsigned short, 3>                 UShortVectorVolume;
+
+  SignalToConcentrationCurveSource(const VectorVolume* signalVolume,
+                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                   float S0GradThresh,
+                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator);
+
+  //! Signal intensities stored as integers
+  SignalToConcentrationCurveSource(const ShortVectorVolume* signalVolume,
+                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                   float S0GradThresh,
+                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator);
+  SignalToConcentrationCurveSource(const UShortVectorVolume* signalVolume,
+                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                   float S0GradThresh,
+                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator);
+
+  virtual ~SignalToConcentrationCurveSource() {}
+
+  virtual unsigned int getCurveSize() const;
+  virtual void getCurve(const MaskVolume::IndexType& index, float* curve) const;
+
+private:
+  enum SignalType { FLOAT_SIGNAL, SHORT_SIGNAL, USHORT_SIGNAL };
+
+  SignalToConcentrationCurveSource(const itk::ImageBase<3>* signalVolume, const void* signalBuffer, SignalType signalType,
+                                   float T1PreBlood, float TR, float FA, float relaxivity,
+                                   float S0GradThresh,
+                                   const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator);
+
+  const itk::ImageBase<3>* const m_signalVolume;
+  const void* const m_signalBuffer;
+  const SignalType m_signalType;
+  const itk::SignalToConcentrationConverter m_converter;
+  const float m_S0GradThresh;
+  const BolusArrivalTime::BolusArrivalTimeEstimator* const m_batEstimator;
+};
+
+#endif
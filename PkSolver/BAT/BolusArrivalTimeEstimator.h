@@ -15,6 +15,66 @@ namespace BolusArrivalTime
     
     virtual int getBATIndex(int signalSize, const float* signal, float* optRet_maxSlope = NULL) const = 0;
 
+    //! Max slope as returned by getBATIndex, for callers that already know the BAT.
+    virtual float getMaxSlope(int signalSize, const float* signal) const
+    {
+      float maxSlope = 0.0f;
+      getBATIndex(signalSize, signal, &maxSlope);
+      return maxSlope;
+    }
+
+    //! getBATIndex for count curves of signalSize values, the curve i starting
+    //! at curves + i * stride. Writes one index (and max slope) per curve,
+    //! -1 (and 0) for the curves the detection fails on.
+    virtual void getBATIndices(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                               int* outIdx, float* outMaxSlope = NULL) const
+    {
+      for (int i = 0; i < count; ++i)
+      {
+        try {
+          outIdx[i] = getBATIndex(signalSize, curves + i * stride, outMaxSlope ? &outMaxSlope[i] : NULL);
+        }
+        catch (...)
+        {
+          outIdx[i] = -1;
+          if (outMaxSlope) {
+            outMaxSlope[i] = 0.0f;
+          }
+        }
+      }
+    }
+
+    //! Same as getBATIndex, also returns the arrival as a fractional frame
+    //! position. Estimators that only resolve whole frames return the index.
+    virtual int getBATPosition(int signalSize, const float* signal, float& position, float* optRet_maxSlope = NULL) const
+    {
+      const int BATIndex = getBATIndex(signalSize, signal, optRet_maxSlope);
+      position = static_cast<float>(BATIndex);
+      return BATIndex;
+    }
+
+    //! getBATPosition for count curves, laid out as for getBATIndices. Writes
+    //! one index and position (and max slope) per curve, -1 (and 0) for the
+    //! curves the detection fails on.
+    virtual void getBATPositions(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                                 int* outIdx, float* outPosition, float* outMaxSlope = NULL) const
+    {
+      for (int i = 0; i < count; ++i)
+      {
+        try {
+          outIdx[i] = getBATPosition(signalSize, curves + i * stride, outPosition[i], outMaxSlope ? &outMaxSlope[i] : NULL);
+        }
+        catch (...)
+        {
+          outIdx[i] = -1;
+          outPosition[i] = -1.0f;
+          if (outMaxSlope) {
+            outMaxSlope[i] = 0.0f;
+          }
+        }
+      }
+    }
+
   };
 
 }
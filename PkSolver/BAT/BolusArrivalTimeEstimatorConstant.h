@@ -21,6 +21,11 @@ namespace BolusArrivalTime
       return m_defaultBATIndex;
     }
 
+    virtual float getMaxSlope(int signalSize, const float* signal) const
+    {
+      return 0.0f;
+    }
+
   private:
     const int m_defaultBATIndex;
 
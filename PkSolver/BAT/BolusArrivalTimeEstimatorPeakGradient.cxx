@@ -2,10 +2,30 @@
 #include "PkSolver.h"
 #include "SignalComputationUtils.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace BolusArrivalTime
 {
   using namespace SignalUtils;
 
+  namespace
+  {
+    // Number of curves processed together by getBATIndices
+    const int BlockSize = 16;
+
+    // Derivative buffer of the calling thread. It only grows, so the per
+    // voxel calls of the filters do not allocate.
+    float* getScratch(std::size_t size)
+    {
+      static thread_local std::vector<float> scratch;
+      if (scratch.size() < size) {
+        scratch.resize(size);
+      }
+      return &scratch[0];
+    }
+  }
+
   int BolusArrivalTimeEstimatorPeakGradient::getBATIndex(int signalSize, const float* signal, float* optRet_maxSlope /*= NULL*/) const
   {
     if (signalSize <= 0) {
@@ -15,8 +35,7 @@ namespace BolusArrivalTime
     int skipFront = 0;                  // Leading points to ignore
     int skipBack = 2;                   // Trailing points to ignore
     
-    float* signalDerivative = new float[signalSize];
-    memcpy(signalDerivative, signal, signalSize * sizeof(float));
+    float* signalDerivative = getScratch(signalSize);
     itk::compute_derivative(signalSize, signal, signalDerivative);
 
     int maxSlopeIdx = getMaxPositionInRange(skipFront, signalSize - skipBack, signalDerivative);
@@ -25,7 +44,172 @@ namespace BolusArrivalTime
     if (optRet_maxSlope) {
       *optRet_maxSlope = signalDerivative[maxSlopeIdx];
     }
-    delete[] signalDerivative;
+    return arrivalIdx;
+  }
+
+  float BolusArrivalTimeEstimatorPeakGradient::getMaxSlope(int signalSize, const float* signal) const
+  {
+    if (signalSize <= 0) {
+      throw NoSignalException();
+    }
+
+    int skipFront = 0;                  // Leading points to ignore
+    int skipBack = 2;                   // Trailing points to ignore
+
+    float* signalDerivative = getScratch(signalSize);
+    itk::compute_derivative(signalSize, signal, signalDerivative);
+
+    int maxSlopeIdx = getMaxPositionInRange(skipFront, signalSize - skipBack, signalDerivative);
+    float maxSlope = signalDerivative[maxSlopeIdx];
+    return maxSlope;
+  }
+
+  void BolusArrivalTimeEstimatorPeakGradient::getBATIndices(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                                                             int* outIdx, float* outMaxSlope /*= NULL*/) const
+  {
+    if (signalSize <= 0) {
+      throw NoSignalException();
+    }
+    if (signalSize < 3) {
+      // too short for the three point derivative
+      BolusArrivalTimeEstimator::getBATIndices(signalSize, count, stride, curves, outIdx, outMaxSlope);
+      return;
+    }
+    estimateBlocks(signalSize, count, stride, curves, outIdx, NULL, outMaxSlope);
+  }
+
+  void BolusArrivalTimeEstimatorPeakGradient::getBATPositions(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                                                               int* outIdx, float* outPosition, float* outMaxSlope /*= NULL*/) const
+  {
+    if (signalSize <= 0) {
+      throw NoSignalException();
+    }
+    if (signalSize < 3) {
+      // too short for the three point derivative
+      BolusArrivalTimeEstimator::getBATPositions(signalSize, count, stride, curves, outIdx, outPosition, outMaxSlope);
+      return;
+    }
+    estimateBlocks(signalSize, count, stride, curves, outIdx, outPosition, outMaxSlope);
+  }
+
+  void BolusArrivalTimeEstimatorPeakGradient::estimateBlocks(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                                                              int* outIdx, float* outPosition, float* outMaxSlope) const
+  {
+    int skipFront = 0;                  // Leading points to ignore
+    int skipBack = 2;                   // Trailing points to ignore
+    const int stop = signalSize - skipBack;
+
+    // derivative[t * BlockSize + v] is the derivative of the curve v of the
+    // block at time point t, the lanes past the end of the last block are unused
+    float* derivative = getScratch(signalSize * BlockSize);
+    float maxSlope[BlockSize];
+    int maxSlopeIdx[BlockSize];
+    float thresh[BlockSize];
+    int lastBelow[BlockSize];
+
+    for (int first = 0; first < count; first += BlockSize)
+    {
+      const int lanes = std::min(BlockSize, count - first);
+
+      // Same arithmetic as compute_derivative()
+      for (int v = 0; v < lanes; ++v)
+      {
+        const float* signal = curves + (first + v) * stride;
+        derivative[v] = (float)((-3.0*signal[0] + 4.0*signal[1] - signal[2]) / 2.0);
+        derivative[(signalSize - 1) * BlockSize + v] =
+          (float)((3.0*signal[signalSize - 1] - 4.0*signal[signalSize - 2] + signal[signalSize - 3]) / 2.0);
+        for (int i = 1; i < signalSize - 1; i++)
+        {
+          derivative[i * BlockSize + v] = (float)((signal[i + 1] - signal[i - 1]) / 2.0);
+        }
+      }
+
+      // Max slope, first position of the maximum as in getMaxPositionInRange()
+      const float* row = &derivative[skipFront * BlockSize];
+      for (int v = 0; v < BlockSize; ++v)
+      {
+        maxSlope[v] = row[v];
+        maxSlopeIdx[v] = skipFront;
+      }
+      for (int t = skipFront + 1; t < stop; ++t)
+      {
+        row = &derivative[t * BlockSize];
+        for (int v = 0; v < BlockSize; ++v)
+        {
+          const bool larger = row[v] > maxSlope[v];
+          maxSlope[v] = larger ? row[v] : maxSlope[v];
+          maxSlopeIdx[v] = larger ? t : maxSlopeIdx[v];
+        }
+      }
+
+      // The arrival follows the last point below the threshold before the
+      // max slope, as found by the backward search of getArrivalIndex()
+      int searchEnd = skipFront;
+      for (int v = 0; v < BlockSize; ++v)
+      {
+        thresh[v] = maxSlope[v] / 10.0;
+        lastBelow[v] = skipFront - 1;
+        searchEnd = std::max(searchEnd, maxSlopeIdx[v]);
+      }
+      for (int t = skipFront; t <= searchEnd; ++t)
+      {
+        row = &derivative[t * BlockSize];
+        for (int v = 0; v < BlockSize; ++v)
+        {
+          const bool below = t <= maxSlopeIdx[v] && row[v] < thresh[v];
+          lastBelow[v] = below ? t : lastBelow[v];
+        }
+      }
+
+      for (int v = 0; v < lanes; ++v)
+      {
+        const int arrivalIdx = lastBelow[v] + 1;
+        outIdx[first + v] = arrivalIdx;
+        if (outPosition) {
+          // Interpolated as in getBATPosition()
+          outPosition[first + v] = static_cast<float>(arrivalIdx);
+          if (arrivalIdx > skipFront && arrivalIdx <= maxSlopeIdx[v])
+          {
+            const float before = derivative[(arrivalIdx - 1) * BlockSize + v];
+            const float at = derivative[arrivalIdx * BlockSize + v];
+            outPosition[first + v] = (arrivalIdx - 1) + (thresh[v] - before) / (at - before);
+          }
+        }
+        if (outMaxSlope) {
+          outMaxSlope[first + v] = maxSlope[v];
+        }
+      }
+    }
+  }
+
+  int BolusArrivalTimeEstimatorPeakGradient::getBATPosition(int signalSize, const float* signal, float& position, float* optRet_maxSlope /*= NULL*/) const
+  {
+    if (signalSize <= 0) {
+      throw NoSignalException();
+    }
+
+    int skipFront = 0;                  // Leading points to ignore
+    int skipBack = 2;                   // Trailing points to ignore
+
+    float* signalDerivative = getScratch(signalSize);
+    itk::compute_derivative(signalSize, signal, signalDerivative);
+
+    int maxSlopeIdx = getMaxPositionInRange(skipFront, signalSize - skipBack, signalDerivative);
+    int arrivalIdx = getArrivalIndex(skipFront, maxSlopeIdx, signalDerivative);
+
+    position = static_cast<float>(arrivalIdx);
+    if (arrivalIdx > skipFront && arrivalIdx <= maxSlopeIdx)
+    {
+      // signalDerivative[arrivalIdx - 1] < thresh <= signalDerivative[arrivalIdx]
+      const float thresh = signalDerivative[maxSlopeIdx] / 10.0;
+      const float before = signalDerivative[arrivalIdx - 1];
+      const float at = signalDerivative[arrivalIdx];
+      position = (arrivalIdx - 1) + (thresh - before) / (at - before);
+    }
+
+    if (optRet_maxSlope) {
+      *optRet_maxSlope = signalDerivative[maxSlopeIdx];
+    }
     return arrivalIdx;
   }
 
@@ -14,8 +14,27 @@ namespace BolusArrivalTime
     virtual ~BolusArrivalTimeEstimatorPeakGradient() {}
 
     virtual int getBATIndex(int signalSize, const float* signal, float* optRet_maxSlope = NULL) const;
+    virtual float getMaxSlope(int signalSize, const float* signal) const;
+
+    //! Processes the curves in blocks, with the derivatives of a block stored
+    //! time point by time point so that the max slope and threshold searches
+    //! run over all curves of the block at once. Same results as getBATIndex.
+    virtual void getBATIndices(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                               int* outIdx, float* outMaxSlope = NULL) const;
+
+    //! The position is where the derivative crosses the arrival threshold,
+    //! interpolated linearly between the frames before and at the BAT index.
+    virtual int getBATPosition(int signalSize, const float* signal, float& position, float* optRet_maxSlope = NULL) const;
+
+    //! Blocked like getBATIndices. Same results as getBATPosition.
+    virtual void getBATPositions(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                                 int* outIdx, float* outPosition, float* outMaxSlope = NULL) const;
 
   private:
+    //! Common implementation of getBATIndices and getBATPositions, outPosition may be NULL
+    void estimateBlocks(int signalSize, int count, ptrdiff_t stride, const float* curves,
+                        int* outIdx, float* outPosition, float* outMaxSlope) const;
+
     virtual int getArrivalIndex(int start, int maxSlopeIdx, const float* signal) const;
 
   };
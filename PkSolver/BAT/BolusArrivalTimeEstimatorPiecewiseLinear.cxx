@@ -0,0 +1,85 @@
+#include "BolusArrivalTimeEstimatorPiecewiseLinear.h"
+#include "PkSolver.h"
+#include "SignalComputationUtils.h"
+#include "Exceptions.h"
+
+#include <limits>
+#include <vector>
+
+namespace BolusArrivalTime
+{
+  using namespace SignalUtils;
+
+  int BolusArrivalTimeEstimatorPiecewiseLinear::getBATIndex(int signalSize, const float* signal, float* optRet_maxSlope /*= NULL*/) const
+  {
+    if (signalSize <= 0) {
+      throw NoSignalException();
+    }
+
+    // Only the baseline and the rise are fitted, up to the peak
+    const int peakIdx = getMaxPositionInRange(0, signalSize, signal);
+    const int n = peakIdx + 1;
+    if (n < 4) {
+      throw BATDetectionFailedException("peak too close to the first frame");
+    }
+
+    // Prefix sums over the frames [0, i), with t the frame index
+    std::vector<double> sumT(n + 1, 0.0), sumY(n + 1, 0.0), sumTY(n + 1, 0.0), sumTT(n + 1, 0.0);
+    double sumYY = 0.0;
+    for (int i = 0; i < n; ++i)
+    {
+      const double t = i;
+      const double y = signal[i];
+      sumT[i + 1] = sumT[i] + t;
+      sumY[i + 1] = sumY[i] + y;
+      sumTY[i + 1] = sumTY[i] + t * y;
+      sumTT[i + 1] = sumTT[i] + t * t;
+      sumYY += y * y;
+    }
+
+    // The model is y = c + s * x with x = max(0, t - b). x is 0 up to the
+    // breakpoint b, so its sums only run over the frames [b, n).
+    // At least one frame before the breakpoint, and the breakpoint and at
+    // least two more frames up to the peak.
+    const double meanY = sumY[n] / n;
+    const double SSyy = sumYY - sumY[n] * meanY;
+    double bestError = std::numeric_limits<double>::max();
+    double bestSlope = 0.0;
+    int bestBreakpoint = -1;
+    for (int b = 1; b <= n - 3; ++b)
+    {
+      const double count = n - b;
+      const double sT = sumT[n] - sumT[b];
+      const double sY = sumY[n] - sumY[b];
+      const double sTY = sumTY[n] - sumTY[b];
+      const double sTT = sumTT[n] - sumTT[b];
+
+      const double sumX = sT - b * count;
+      const double sumXX = sTT - 2.0 * b * sT + (double)b * b * count;
+      const double sumXY = sTY - b * sY;
+
+      const double SSxx = sumXX - sumX * sumX / n;
+      const double SSxy = sumXY - sumX * meanY;
+      if (SSxx <= 0.0) {
+        continue;
+      }
+      const double slope = SSxy / SSxx;
+      const double error = SSyy - slope * SSxy;
+      if (slope > 0.0 && error < bestError)
+      {
+        bestError = error;
+        bestSlope = slope;
+        bestBreakpoint = b;
+      }
+    }
+
+    if (bestBreakpoint < 0) {
+      throw BATDetectionFailedException("no rise before the peak");
+    }
+    if (optRet_maxSlope) {
+      *optRet_maxSlope = static_cast<float>(bestSlope);
+    }
+    return bestBreakpoint;
+  }
+
+}
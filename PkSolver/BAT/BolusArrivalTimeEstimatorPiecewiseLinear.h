@@ -0,0 +1,37 @@
+#ifndef __BolusArrivalTimeEstimatorPiecewiseLinear_h
+#define __BolusArrivalTimeEstimatorPiecewiseLinear_h
+
+#include "BolusArrivalTimeEstimator.h"
+
+namespace BolusArrivalTime
+{
+
+  //! Fits a constant baseline followed by a linear rise to the curve up to
+  //! its peak, the BAT is the breakpoint with the smallest squared error.
+  //
+  //! Every frame from the second to the second last before the peak is tried
+  //! as breakpoint, leaving at least one baseline frame before it and three
+  //! frames from it on, the peak included. With prefix sums of t, y, t*y and
+  //! t^2 each candidate is fitted in constant time, so the search is linear
+  //! in the number of frames. Less sensitive
+  //! to noise than the peak gradient, which only looks at single derivatives.
+  //
+  //! See "An automatic approach for estimating bolus arrival time in dynamic
+  //! contrast MRI using piecewise continuous regression models" - Cheong,
+  //! Koh, Hou. Physics in Medicine and Biology 48 (2003), here with the
+  //! piecewise linear model.
+  class BolusArrivalTimeEstimatorPiecewiseLinear : public BolusArrivalTimeEstimator
+  {
+  public:
+    BolusArrivalTimeEstimatorPiecewiseLinear() {}
+
+    virtual ~BolusArrivalTimeEstimatorPiecewiseLinear() {}
+
+    //! The max slope returned is the slope of the fitted rise, per frame.
+    //! Throws BATDetectionFailedException if no rise fits before the peak.
+    virtual int getBATIndex(int signalSize, const float* signal, float* optRet_maxSlope = NULL) const;
+
+  };
+
+}
+#endif
@@ -37,4 +37,20 @@ public:
   {}
 };
 
+class AIFDetectionFailedException : public std::runtime_error
+{
+public:
+  AIFDetectionFailedException(const std::string& reason)
+    : std::runtime_error("Automatic AIF detection failed: " + reason + ".")
+  {}
+};
+
+class BATDetectionFailedException : public std::runtime_error
+{
+public:
+  BATDetectionFailedException(const std::string& reason)
+    : std::runtime_error("Bolus arrival time detection failed: " + reason + ".")
+  {}
+};
+
 #endif
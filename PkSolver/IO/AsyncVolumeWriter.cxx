@@ -0,0 +1,122 @@
+#include "AsyncVolumeWriter.h"
+
+#include "itkConfigure.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+AsyncVolumeWriter::AsyncVolumeWriter(unsigned int numberOfThreads, Compression compression, const std::string& compressor)
+  : m_numberOfThreads(numberOfThreads > 0 ? numberOfThreads : 1),
+    m_compression(compression),
+    m_compressor(compressor),
+    m_finishing(false)
+{
+#if ITK_VERSION_MAJOR < 5 || (ITK_VERSION_MAJOR == 5 && ITK_VERSION_MINOR < 1)
+  if (!m_compressor.empty() || m_compression == FastCompression || m_compression == BestCompression) {
+    std::cerr << "Compression codecs and levels need ITK 5.1, using the default compression." << std::endl;
+  }
+#endif
+}
+
+AsyncVolumeWriter::~AsyncVolumeWriter()
+{
+  joinThreads();
+}
+
+void AsyncVolumeWriter::wait()
+{
+  joinThreads();
+
+  std::vector<std::string> errors;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    errors.swap(m_errors);
+    // ready for the next volumes
+    m_finishing = false;
+  }
+  if (!errors.empty()) {
+    std::ostringstream message;
+    for (std::size_t i = 0; i < errors.size(); ++i) {
+      message << (i ? "\n" : "") << errors[i];
+    }
+    throw std::runtime_error(message.str());
+  }
+}
+
+void AsyncVolumeWriter::configureImageIO(itk::ImageIOBase* imageIO) const
+{
+  imageIO->SetUseCompression(m_compression != NoCompression);
+#if ITK_VERSION_MAJOR > 5 || (ITK_VERSION_MAJOR == 5 && ITK_VERSION_MINOR >= 1)
+  if (m_compression == NoCompression) {
+    return;
+  }
+  if (!m_compressor.empty()) {
+    imageIO->SetCompressor(m_compressor);
+  }
+  if (m_compression == FastCompression) {
+    imageIO->SetCompressionLevel(1);
+  }
+  else if (m_compression == BestCompression) {
+    imageIO->SetCompressionLevel(imageIO->GetMaximumCompressionLevel());
+  }
+#endif
+}
+
+void AsyncVolumeWriter::enqueue(Job* job)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_jobs.push_back(std::unique_ptr<Job>(job));
+  // one more thread as long as there are more volumes than threads
+  if (m_threads.size() < m_numberOfThreads) {
+    m_threads.push_back(std::thread(&AsyncVolumeWriter::run, this));
+  }
+  m_jobAvailable.notify_one();
+}
+
+void AsyncVolumeWriter::addError(const std::string& error)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_errors.push_back(error);
+}
+
+void AsyncVolumeWriter::joinThreads()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_finishing = true;
+  }
+  m_jobAvailable.notify_all();
+  for (std::size_t i = 0; i < m_threads.size(); ++i) {
+    m_threads[i].join();
+  }
+  m_threads.clear();
+}
+
+void AsyncVolumeWriter::run()
+{
+  for (;;) {
+    std::unique_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (m_jobs.empty() && !m_finishing) {
+        m_jobAvailable.wait(lock);
+      }
+      if (m_jobs.empty()) {
+        return;
+      }
+      job.reset(m_jobs.front().release());
+      m_jobs.pop_front();
+    }
+
+    try {
+      job->write();
+    }
+    catch (const std::exception& e) {
+      addError("Writing \"" + job->fileName + "\" failed: " + e.what());
+    }
+    catch (...) {
+      addError("Writing \"" + job->fileName + "\" failed.");
+    }
+  }
+}
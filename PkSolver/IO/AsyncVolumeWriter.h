@@ -0,0 +1,114 @@
+#ifndef __AsyncVolumeWriter_h
+#define __AsyncVolumeWriter_h
+
+#include "itkImageFileWriter.h"
+#include "itkImageIOBase.h"
+#include "itkImageIOFactory.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! Writes volumes on a pool of threads while the caller goes on. Each
+//! volume is written from a graft of the one passed in, so the writers
+//! never update the pipeline that produced it. Failed writes are reported
+//! by wait().
+class AsyncVolumeWriter
+{
+public:
+  enum Compression
+  {
+    DefaultCompression, // the default codec and level of the file format
+    NoCompression,
+    FastCompression,    // lowest level, levels need ITK 5.1
+    BestCompression     // highest level, levels need ITK 5.1
+  };
+
+  //! compressor is the ITK codec name (ITK 5.1), empty for the default one
+  AsyncVolumeWriter(unsigned int numberOfThreads, Compression compression, const std::string& compressor = "");
+
+  //! Waits for the queued volumes, without reporting failures
+  virtual ~AsyncVolumeWriter();
+
+  //! Queues volume for writing to fileName, does nothing if fileName is
+  //! empty. The pixels of volume must not change until wait() returns.
+  template <class TVolume>
+  void write(const std::string& fileName, const TVolume* volume)
+  {
+    if (fileName.empty() || !volume) {
+      return;
+    }
+    // the image IO is created here as the object factories are not safe
+    // to use from several threads
+    itk::ImageIOBase::Pointer imageIO =
+      itk::ImageIOFactory::CreateImageIO(fileName.c_str(), itk::ImageIOFactory::WriteMode);
+    if (imageIO.IsNull()) {
+      addError("No image IO to write \"" + fileName + "\".");
+      return;
+    }
+    configureImageIO(imageIO);
+
+    typename TVolume::Pointer graft = TVolume::New();
+    graft->Graft(volume);
+    graft->SetMetaDataDictionary(volume->GetMetaDataDictionary());
+
+    enqueue(new VolumeJob<TVolume>(fileName, graft, imageIO));
+  }
+
+  //! Waits until all queued volumes are written. Throws a std::runtime_error
+  //! listing the volumes that could not be written.
+  void wait();
+
+private:
+  struct Job
+  {
+    Job(const std::string& fileName) : fileName(fileName) {}
+    virtual ~Job() {}
+    virtual void write() = 0;
+    std::string fileName;
+  };
+
+  template <class TVolume>
+  struct VolumeJob : public Job
+  {
+    VolumeJob(const std::string& fileName, TVolume* volume, itk::ImageIOBase* imageIO)
+      : Job(fileName), volume(volume), imageIO(imageIO)
+    {}
+
+    virtual void write()
+    {
+      typename itk::ImageFileWriter<TVolume>::Pointer writer = itk::ImageFileWriter<TVolume>::New();
+      writer->SetFileName(fileName.c_str());
+      writer->SetImageIO(imageIO);
+      writer->SetUseCompression(imageIO->GetUseCompression());
+      writer->SetInput(volume);
+      writer->Update();
+    }
+
+    typename TVolume::Pointer volume;
+    itk::ImageIOBase::Pointer imageIO;
+  };
+
+  void configureImageIO(itk::ImageIOBase* imageIO) const;
+  void enqueue(Job* job);
+  void addError(const std::string& error);
+  void joinThreads();
+  void run();
+
+  const unsigned int m_numberOfThreads;
+  const Compression m_compression;
+  const std::string m_compressor;
+
+  std::mutex m_mutex;
+  std::condition_variable m_jobAvailable;
+  std::deque<std::unique_ptr<Job> > m_jobs;
+  bool m_finishing;
+  std::vector<std::thread> m_threads;
+  std::vector<std::string> m_errors;
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "BIDSSidecarReader.h"
+
+#include "Exceptions.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+  //! Reads the top level fields of a JSON object that have a number or an
+  //! array of numbers as value, other values are skipped. Throws
+  //! WrongFileFormatException on malformed JSON.
+  class JSONNumberParser
+  {
+  public:
+    JSONNumberParser(const std::string& text, const std::string& fileName)
+      : m_text(text), m_fileName(fileName), m_position(0)
+    {}
+
+    void parse(std::map<std::string, std::vector<double> >& values)
+    {
+      expect('{');
+      if (!accept('}')) {
+        do {
+          const std::string key = string();
+          expect(':');
+          std::vector<double> numbers;
+          if (value(numbers)) {
+            values[key] = numbers;
+          }
+        } while (accept(','));
+        expect('}');
+      }
+      skipWhitespace();
+      if (m_position != m_text.size()) {
+        fail();
+      }
+    }
+
+  private:
+    //! Returns whether the value is a number or an array of numbers only
+    bool value(std::vector<double>& numbers)
+    {
+      skipWhitespace();
+      const char c = peek();
+      if (c == '{') {
+        skipObject();
+        return false;
+      }
+      if (c == '[') {
+        ++m_position;
+        bool numeric = true;
+        if (!accept(']')) {
+          do {
+            skipWhitespace();
+            const bool isNumber = isNumberStart(peek());
+            std::vector<double> element;
+            value(element);
+            numeric = numeric && isNumber;
+            if (isNumber) {
+              numbers.push_back(element[0]);
+            }
+          } while (accept(','));
+          expect(']');
+        }
+        return numeric;
+      }
+      if (c == '"') {
+        string();
+        return false;
+      }
+      if (isNumberStart(c)) {
+        numbers.push_back(number());
+        return true;
+      }
+      literal();
+      return false;
+    }
+
+    static bool isNumberStart(char c)
+    {
+      return c == '-' || std::isdigit(static_cast<unsigned char>(c));
+    }
+
+    void skipObject()
+    {
+      expect('{');
+      if (!accept('}')) {
+        do {
+          string();
+          expect(':');
+          std::vector<double> ignored;
+          value(ignored);
+        } while (accept(','));
+        expect('}');
+      }
+    }
+
+    std::string string()
+    {
+      expect('"');
+      std::string result;
+      for (;;) {
+        const char c = next();
+        if (c == '"') {
+          return result;
+        }
+        if (c != '\\') {
+          result += c;
+          continue;
+        }
+        const char escaped = next();
+        switch (escaped) {
+        case 'b': result += '\b'; break;
+        case 'f': result += '\f'; break;
+        case 'n': result += '\n'; break;
+        case 'r': result += '\r'; break;
+        case 't': result += '\t'; break;
+        case 'u':
+          // only needed for keys and values that are not read
+          for (int i = 0; i < 4; ++i) {
+            if (!std::isxdigit(static_cast<unsigned char>(next()))) {
+              fail();
+            }
+          }
+          result += '?';
+          break;
+        default: result += escaped; break;
+        }
+      }
+    }
+
+    double number()
+    {
+      const char* begin = m_text.c_str() + m_position;
+      char* end = NULL;
+      const double result = std::strtod(begin, &end);
+      if (end == begin) {
+        fail();
+      }
+      m_position += end - begin;
+      return result;
+    }
+
+    void literal()
+    {
+      const char* literals[] = { "true", "false", "null" };
+      for (std::size_t i = 0; i < 3; ++i) {
+        const std::string word = literals[i];
+        if (m_text.compare(m_position, word.size(), word) == 0) {
+          m_position += word.size();
+          return;
+        }
+      }
+      fail();
+    }
+
+    void skipWhitespace()
+    {
+      while (m_position < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_position]))) {
+        ++m_position;
+      }
+    }
+
+    char peek()
+    {
+      if (m_position >= m_text.size()) {
+        fail();
+      }
+      return m_text[m_position];
+    }
+
+    char next()
+    {
+      const char c = peek();
+      ++m_position;
+      return c;
+    }
+
+    bool accept(char c)
+    {
+      skipWhitespace();
+      if (m_position < m_text.size() && m_text[m_position] == c) {
+        ++m_position;
+        return true;
+      }
+      return false;
+    }
+
+    void expect(char c)
+    {
+      if (!accept(c)) {
+        fail();
+      }
+    }
+
+    void fail()
+    {
+      throw WrongFileFormatException(m_fileName);
+    }
+
+    const std::string& m_text;
+    const std::string& m_fileName;
+    std::size_t m_position;
+  };
+
+  bool endsWith(const std::string& s, const std::string& suffix)
+  {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+}
+
+BIDSSidecarReader::BIDSSidecarReader(const std::string& fileName, unsigned int numberOfFrames)
+  : m_fileName(fileName), m_numberOfFrames(numberOfFrames)
+{
+  std::ifstream in(fileName.c_str());
+  if (in.fail()) {
+    throw FileNotFoundException(fileName);
+  }
+  const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  JSONNumberParser(text, fileName).parse(m_values);
+}
+
+std::string BIDSSidecarReader::getSidecarFileName(const std::string& niftiFileName)
+{
+  const char* extensions[] = { ".nii.gz", ".nii" };
+  for (std::size_t i = 0; i < 2; ++i) {
+    const std::string extension = extensions[i];
+    if (endsWith(niftiFileName, extension)) {
+      return niftiFileName.substr(0, niftiFileName.size() - extension.size()) + ".json";
+    }
+  }
+  return "";
+}
+
+float BIDSSidecarReader::getRepetitionTime() const
+{
+  // seconds to ms
+  if (has("RepetitionTimeExcitation")) {
+    return static_cast<float>(get("RepetitionTimeExcitation") * 1000.0);
+  }
+  return static_cast<float>(get("RepetitionTime") * 1000.0);
+}
+
+float BIDSSidecarReader::getFlipAngle() const
+{
+  return static_cast<float>(get("FlipAngle"));
+}
+
+std::vector<float> BIDSSidecarReader::getTiming() const
+{
+  std::vector<double> times;
+  if (has("VolumeTiming")) {
+    times = m_values.find("VolumeTiming")->second;
+  }
+  else if (has("FrameTimesStart")) {
+    times = m_values.find("FrameTimesStart")->second;
+  }
+  else if (has("RepetitionTimeExcitation") && has("RepetitionTime")) {
+    // RepetitionTime is the time between the volumes then
+    const double volumeRepetitionTime = get("RepetitionTime");
+    for (unsigned int i = 0; i < m_numberOfFrames; ++i) {
+      times.push_back(i * volumeRepetitionTime);
+    }
+  }
+  else {
+    throw FailedDictionaryLookup("VolumeTiming");
+  }
+
+  if (times.size() != m_numberOfFrames) {
+    std::ostringstream message;
+    message << "\"" << m_fileName << "\" has " << times.size() << " frame times for "
+            << m_numberOfFrames << " frames.";
+    throw std::runtime_error(message.str());
+  }
+
+  std::vector<float> timing(times.size());
+  for (std::size_t i = 0; i < times.size(); ++i) {
+    timing[i] = static_cast<float>(times[i] - times[0]);
+  }
+  return timing;
+}
+
+bool BIDSSidecarReader::has(const std::string& key) const
+{
+  std::map<std::string, std::vector<double> >::const_iterator it = m_values.find(key);
+  return it != m_values.end() && !it->second.empty();
+}
+
+double BIDSSidecarReader::get(const std::string& key) const
+{
+  if (!has(key)) {
+    throw FailedDictionaryLookup(key);
+  }
+  return m_values.find(key)->second[0];
+}
@@ -0,0 +1,44 @@
+#ifndef __BIDSSidecarReader_h
+#define __BIDSSidecarReader_h
+
+#include "MultiVolumeMetaDataProvider.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+//! Acquisition parameters of a NIfTI-4D series from its BIDS JSON sidecar.
+//! BIDS stores times in seconds and the repetition time of the sequence as
+//! RepetitionTimeExcitation, or as RepetitionTime if the volume timing is
+//! not given by it. The frame times are read from VolumeTiming or
+//! FrameTimesStart; without them, RepetitionTime is the time between frames.
+class BIDSSidecarReader : public MultiVolumeMetaDataProvider
+{
+public:
+  //! numberOfFrames is the number of volumes of the series, to check the
+  //! frame times against. Throws FileNotFoundException if the file cannot
+  //! be opened, WrongFileFormatException if it is not a JSON object.
+  BIDSSidecarReader(const std::string& fileName, unsigned int numberOfFrames);
+
+  virtual ~BIDSSidecarReader() {}
+
+  //! The sidecar of a NIfTI file, "sub-01_dce.nii.gz" has "sub-01_dce.json".
+  //! Empty if fileName is not a NIfTI file.
+  static std::string getSidecarFileName(const std::string& niftiFileName);
+
+  virtual float getRepetitionTime() const;
+  virtual float getFlipAngle() const;
+  virtual std::vector<float> getTiming() const;
+
+private:
+  bool has(const std::string& key) const;
+  //! First value of a number or array field
+  double get(const std::string& key) const;
+
+  const std::string m_fileName;
+  const unsigned int m_numberOfFrames;
+  //! Fields with a number or an array of numbers as value
+  std::map<std::string, std::vector<double> > m_values;
+};
+
+#endif
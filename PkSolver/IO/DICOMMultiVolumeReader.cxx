@@ -0,0 +1,392 @@
+#include "DICOMMultiVolumeReader.h"
+
+#include "Exceptions.h"
+
+#include "itkGDCMImageIO.h"
+#include "itkGDCMSeriesFileNames.h"
+#include "itkMetaDataObject.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+  std::string trim(const std::string& s)
+  {
+    const std::string::size_type first = s.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+      return "";
+    }
+    return s.substr(first, s.find_last_not_of(" \t\r\n") - first + 1);
+  }
+
+  std::string getTag(const itk::MetaDataDictionary& dictionary, const std::string& tag)
+  {
+    std::string value;
+    itk::ExposeMetaData<std::string>(dictionary, tag, value);
+    return trim(value);
+  }
+
+  //! DICOM time (hhmmss.frac) in milliseconds since midnight
+  double timeInMilliseconds(const std::string& time)
+  {
+    if (time.size() < 6) {
+      return std::atof(time.c_str());
+    }
+    const double hours = std::atof(time.substr(0, 2).c_str());
+    const double minutes = std::atof(time.substr(2, 2).c_str());
+    const double seconds = std::atof(time.substr(4).c_str());
+    return ((hours * 60.0 + minutes) * 60.0 + seconds) * 1000.0;
+  }
+
+  template <typename TIn, typename TOut>
+  void scatterSlice(const TIn* slice, std::size_t sliceSize, unsigned int numberOfFrames, unsigned int frame,
+                    TOut* volumeSlice)
+  {
+    for (std::size_t i = 0; i < sliceSize; ++i) {
+      volumeSlice[i * numberOfFrames + frame] = static_cast<TOut>(slice[i]);
+    }
+  }
+
+  //! Scatters a slice of any stored type into the component frame of a volume of TOut
+  template <typename TOut>
+  void scatter(const char* slice, itk::ImageIOBase::IOComponentType componentType,
+               std::size_t sliceSize, unsigned int numberOfFrames, unsigned int frame,
+               std::size_t sliceIndex, void* volume)
+  {
+    TOut* volumeSlice = static_cast<TOut*>(volume) + sliceIndex * sliceSize * numberOfFrames;
+    switch (componentType) {
+      case itk::ImageIOBase::CHAR:
+        scatterSlice(reinterpret_cast<const char*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      case itk::ImageIOBase::UCHAR:
+        scatterSlice(reinterpret_cast<const unsigned char*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      case itk::ImageIOBase::SHORT:
+        scatterSlice(reinterpret_cast<const short*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      case itk::ImageIOBase::USHORT:
+        scatterSlice(reinterpret_cast<const unsigned short*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      case itk::ImageIOBase::INT:
+        scatterSlice(reinterpret_cast<const int*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      case itk::ImageIOBase::UINT:
+        scatterSlice(reinterpret_cast<const unsigned int*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      case itk::ImageIOBase::FLOAT:
+        scatterSlice(reinterpret_cast<const float*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      case itk::ImageIOBase::DOUBLE:
+        scatterSlice(reinterpret_cast<const double*>(slice), sliceSize, numberOfFrames, frame, volumeSlice); break;
+      default:
+        throw std::runtime_error("Unsupported DICOM pixel type.");
+    }
+  }
+}
+
+DICOMMultiVolumeReader::DICOMMultiVolumeReader(const std::string& directory)
+  : m_directory(directory), m_sliceSpacing(1.0), m_componentType(itk::ImageIOBase::UNKNOWNCOMPONENTTYPE)
+{
+  const std::vector<std::string> fileNames = getSeriesFileNames(directory);
+  if (fileNames.empty()) {
+    throw FileNotFoundException(directory);
+  }
+  m_slices.resize(fileNames.size());
+  for (std::size_t i = 0; i < fileNames.size(); ++i) {
+    m_slices[i].fileName = fileNames[i];
+  }
+
+  ThreadStruct str;
+  str.reader = this;
+  str.slices = &m_slices;
+  str.numberOfItems = m_slices.size();
+  str.buffer = NULL;
+  str.scatter = NULL;
+  str.bufferType = itk::ImageIOBase::UNKNOWNCOMPONENTTYPE;
+  readInParallel(str);
+
+  // Rescaled files may be stored as floats next to integer ones
+  m_componentType = m_slices[0].componentType;
+  for (std::size_t i = 1; i < m_slices.size(); ++i) {
+    if (m_slices[i].componentType != m_componentType) {
+      m_componentType = itk::ImageIOBase::FLOAT;
+      break;
+    }
+  }
+
+  // Frames are identified by the trigger time, unless it is the same for
+  // all files
+  std::map<std::string, std::vector<std::size_t> > triggerTimes;
+  for (std::size_t i = 0; i < m_slices.size(); ++i) {
+    triggerTimes[m_slices[i].triggerTime].push_back(i);
+  }
+  std::map<double, std::vector<std::size_t> > frames;
+  if (triggerTimes.size() > 1 && !triggerTimes.count("")) {
+    m_frameTagName = "TriggerTime";
+    for (std::size_t i = 0; i < m_slices.size(); ++i) {
+      frames[std::atof(m_slices[i].triggerTime.c_str())].push_back(i);
+    }
+  }
+  else {
+    m_frameTagName = "AcquisitionTime";
+    for (std::size_t i = 0; i < m_slices.size(); ++i) {
+      frames[timeInMilliseconds(m_slices[i].acquisitionTime)].push_back(i);
+    }
+  }
+  if (frames.size() < 2) {
+    throw WrongFileFormatException(directory);
+  }
+
+  // Slices of a frame in the order of their position along the normal
+  const Slice& first = m_slices[0];
+  std::map<double, std::vector<std::size_t> >::const_iterator it;
+  for (it = frames.begin(); it != frames.end(); ++it) {
+    if (it->second.size() != frames.begin()->second.size()) {
+      throw WrongFileFormatException(directory);
+    }
+    std::vector<std::pair<double, std::size_t> > positions;
+    for (std::size_t i = 0; i < it->second.size(); ++i) {
+      const Slice& slice = m_slices[it->second[i]];
+      if (slice.size[0] != first.size[0] || slice.size[1] != first.size[1]) {
+        throw WrongFileFormatException(slice.fileName);
+      }
+      double position = 0.0;
+      for (unsigned int d = 0; d < 3; ++d) {
+        position += slice.origin[d] * first.direction[2][d];
+      }
+      positions.push_back(std::make_pair(position, it->second[i]));
+    }
+    std::sort(positions.begin(), positions.end());
+
+    std::vector<std::size_t> frame;
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      frame.push_back(positions[i].second);
+    }
+    m_frames.push_back(frame);
+    m_frameTimes.push_back(it->first);
+  }
+
+  // A single slice per frame has only the spacing given in its file
+  const std::vector<std::size_t>& firstFrame = m_frames[0];
+  m_sliceSpacing = m_slices[firstFrame[0]].spacing[2];
+  if (firstFrame.size() > 1) {
+    double distance = 0.0;
+    for (unsigned int d = 0; d < 3; ++d) {
+      const double difference = m_slices[firstFrame[1]].origin[d] - m_slices[firstFrame[0]].origin[d];
+      distance += difference * difference;
+    }
+    m_sliceSpacing = std::sqrt(distance);
+  }
+}
+
+std::vector<std::string> DICOMMultiVolumeReader::getSeriesFileNames(const std::string& directory)
+{
+  itk::GDCMSeriesFileNames::Pointer seriesFileNames = itk::GDCMSeriesFileNames::New();
+  seriesFileNames->SetDirectory(directory);
+  const std::vector<std::string> seriesUIDs = seriesFileNames->GetSeriesUIDs();
+
+  std::vector<std::string> fileNames;
+  for (std::size_t i = 0; i < seriesUIDs.size(); ++i) {
+    const std::vector<std::string> seriesFiles = seriesFileNames->GetFileNames(seriesUIDs[i]);
+    if (seriesFiles.size() > fileNames.size()) {
+      fileNames = seriesFiles;
+    }
+  }
+  return fileNames;
+}
+
+void DICOMMultiVolumeReader::copyInformation(VolumeBase* volume) const
+{
+  const std::vector<std::size_t>& firstFrame = m_frames[0];
+  const Slice& first = m_slices[firstFrame[0]];
+
+  VolumeBase::RegionType region;
+  region.SetSize(0, first.size[0]);
+  region.SetSize(1, first.size[1]);
+  region.SetSize(2, firstFrame.size());
+  volume->SetRegions(region);
+  volume->SetNumberOfComponentsPerPixel(getNumberOfFrames());
+
+  VolumeBase::SpacingType spacing;
+  spacing[0] = first.spacing[0];
+  spacing[1] = first.spacing[1];
+  spacing[2] = m_sliceSpacing;
+  volume->SetSpacing(spacing);
+
+  VolumeBase::PointType origin;
+  VolumeBase::DirectionType direction;
+  for (unsigned int i = 0; i < 3; ++i) {
+    origin[i] = first.origin[i];
+    for (unsigned int j = 0; j < 3; ++j) {
+      direction[i][j] = first.direction[j][i];
+    }
+  }
+  volume->SetOrigin(origin);
+  volume->SetDirection(direction);
+
+  // The keys of a Slicer MultiVolume, so the timing and acquisition
+  // parameters are found as for NRRD input
+  std::ostringstream frameLabels;
+  frameLabels.precision(12);
+  for (std::size_t i = 0; i < m_frameTimes.size(); ++i) {
+    // acquisition times relative to the first frame, for precision
+    const double time = m_frameTagName == "AcquisitionTime" ? m_frameTimes[i] - m_frameTimes[0] : m_frameTimes[i];
+    frameLabels << (i ? "," : "") << time;
+  }
+  std::ostringstream numberOfFrames;
+  numberOfFrames << getNumberOfFrames();
+
+  itk::MetaDataDictionary& dictionary = volume->GetMetaDataDictionary();
+  itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameIdentifyingDICOMTagName", m_frameTagName);
+  itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameIdentifyingDICOMTagUnits", "ms");
+  itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameLabels", frameLabels.str());
+  itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.NumberOfFrames", numberOfFrames.str());
+  itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.DICOM.RepetitionTime", first.repetitionTime);
+  itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.DICOM.FlipAngle", first.flipAngle);
+  itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.DICOM.EchoTime", first.echoTime);
+}
+
+void DICOMMultiVolumeReader::read(itk::VectorImage<float, 3>* volume) const
+{
+  readPixels(volume->GetBufferPointer(), scatter<float>, itk::ImageIOBase::FLOAT);
+}
+
+void DICOMMultiVolumeReader::read(itk::VectorImage<short, 3>* volume) const
+{
+  readPixels(volume->GetBufferPointer(), scatter<short>, itk::ImageIOBase::SHORT);
+}
+
+void DICOMMultiVolumeReader::read(itk::VectorImage<unsigned short, 3>* volume) const
+{
+  readPixels(volume->GetBufferPointer(), scatter<unsigned short>, itk::ImageIOBase::USHORT);
+}
+
+void DICOMMultiVolumeReader::readPixels(void* buffer, ScatterFunction scatter,
+                                        itk::ImageIOBase::IOComponentType bufferType) const
+{
+  if (bufferType != itk::ImageIOBase::FLOAT && bufferType != m_componentType) {
+    throw std::runtime_error("The DICOM files of \"" + m_directory + "\" are not stored as " +
+                             itk::ImageIOBase::GetComponentTypeAsString(bufferType) + ".");
+  }
+  ThreadStruct str;
+  str.reader = this;
+  str.slices = NULL;
+  str.numberOfItems = m_slices.size();
+  str.buffer = buffer;
+  str.scatter = scatter;
+  str.bufferType = bufferType;
+  readInParallel(str);
+}
+
+void DICOMMultiVolumeReader::readInParallel(ThreadStruct& str) const
+{
+  itk::ThreadIdType numberOfThreads = itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+  numberOfThreads = std::max<itk::ThreadIdType>(1, std::min<std::size_t>(numberOfThreads, str.numberOfItems));
+  str.errors.assign(numberOfThreads, "");
+
+  itk::MultiThreader::Pointer threader = itk::MultiThreader::New();
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(readThreaderCallback, &str);
+  threader->SingleMethodExecute();
+
+  // The first error of the threads, in a fixed order
+  for (itk::ThreadIdType t = 0; t < numberOfThreads; ++t) {
+    if (!str.errors[t].empty()) {
+      throw std::runtime_error(str.errors[t]);
+    }
+  }
+}
+
+ITK_THREAD_RETURN_TYPE DICOMMultiVolumeReader::readThreaderCallback(void* arg)
+{
+  itk::MultiThreader::ThreadInfoStruct* info = static_cast<itk::MultiThreader::ThreadInfoStruct*>(arg);
+  ThreadStruct* str = static_cast<ThreadStruct*>(info->UserData);
+  const itk::ThreadIdType threadId = info->ThreadID;
+  const itk::ThreadIdType numberOfThreads = str->errors.size();
+  if (threadId >= numberOfThreads)
+  {
+    return ITK_THREAD_RETURN_VALUE;
+  }
+
+  // Contiguous range of files for this thread
+  const std::size_t begin = str->numberOfItems * threadId / numberOfThreads;
+  const std::size_t end = str->numberOfItems * (threadId + 1) / numberOfThreads;
+  try
+  {
+    for (std::size_t i = begin; i < end; ++i)
+    {
+      if (str->buffer)
+      {
+        str->reader->readSlice(i, str->buffer, str->scatter, str->bufferType);
+      }
+      else
+      {
+        readHeader((*str->slices)[i]);
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    str->errors[threadId] = e.what();
+  }
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+void DICOMMultiVolumeReader::readHeader(Slice& slice)
+{
+  itk::GDCMImageIO::Pointer imageIO = itk::GDCMImageIO::New();
+  imageIO->SetFileName(slice.fileName);
+  imageIO->ReadImageInformation();
+  if (imageIO->GetNumberOfDimensions() < 2 || imageIO->GetNumberOfComponents() != 1 ||
+      (imageIO->GetNumberOfDimensions() > 2 && imageIO->GetDimensions(2) > 1)) {
+    throw WrongFileFormatException(slice.fileName);
+  }
+
+  for (unsigned int i = 0; i < 3; ++i) {
+    slice.origin[i] = imageIO->GetOrigin(i);
+    const std::vector<double> direction = imageIO->GetDirection(i);
+    for (unsigned int j = 0; j < 3; ++j) {
+      slice.direction[i][j] = direction[j];
+    }
+  }
+  for (unsigned int i = 0; i < 2; ++i) {
+    slice.spacing[i] = imageIO->GetSpacing(i);
+    slice.size[i] = imageIO->GetDimensions(i);
+  }
+  slice.spacing[2] = 1.0;
+  if (imageIO->GetNumberOfDimensions() > 2 && imageIO->GetSpacing(2) > 0.0) {
+    slice.spacing[2] = imageIO->GetSpacing(2);
+  }
+  slice.componentType = imageIO->GetComponentType();
+
+  const itk::MetaDataDictionary& dictionary = imageIO->GetMetaDataDictionary();
+  slice.triggerTime = getTag(dictionary, "0018|1060");
+  slice.acquisitionTime = getTag(dictionary, "0008|0032");
+  slice.repetitionTime = getTag(dictionary, "0018|0080");
+  slice.flipAngle = getTag(dictionary, "0018|1314");
+  slice.echoTime = getTag(dictionary, "0018|0081");
+}
+
+void DICOMMultiVolumeReader::readSlice(std::size_t item, void* buffer, ScatterFunction scatter,
+                                       itk::ImageIOBase::IOComponentType bufferType) const
+{
+  const std::size_t slicesPerFrame = m_frames[0].size();
+  const unsigned int frame = static_cast<unsigned int>(item / slicesPerFrame);
+  const std::size_t sliceIndex = item % slicesPerFrame;
+  const Slice& slice = m_slices[m_frames[frame][sliceIndex]];
+
+  itk::GDCMImageIO::Pointer imageIO = itk::GDCMImageIO::New();
+  imageIO->SetFileName(slice.fileName);
+  imageIO->ReadImageInformation();
+  // Only the float buffer takes every type without truncation
+  const itk::ImageIOBase::IOComponentType componentType = imageIO->GetComponentType();
+  if (componentType != slice.componentType ||
+      (bufferType != itk::ImageIOBase::FLOAT && componentType != bufferType)) {
+    throw std::runtime_error("\"" + slice.fileName + "\" is stored as " +
+                             itk::ImageIOBase::GetComponentTypeAsString(componentType) + ", not as " +
+                             itk::ImageIOBase::GetComponentTypeAsString(bufferType) + ".");
+  }
+  std::vector<char> pixels(imageIO->GetImageSizeInBytes());
+  imageIO->Read(&pixels[0]);
+
+  scatter(&pixels[0], componentType, static_cast<std::size_t>(slice.size[0]) * slice.size[1],
+          getNumberOfFrames(), frame, sliceIndex, buffer);
+}
@@ -0,0 +1,102 @@
+#ifndef __DICOMMultiVolumeReader_h
+#define __DICOMMultiVolumeReader_h
+
+#include "itkImageBase.h"
+#include "itkVectorImage.h"
+#include "itkImageIOBase.h"
+#include "itkMultiThreader.h"
+
+#include <string>
+#include <vector>
+
+//! Reads a DCE series of single slice DICOM files as a multi-volume, one
+//! component per time point. The files are grouped into frames by trigger
+//! time, by acquisition time if the trigger time does not change, and the
+//! slices of a frame are ordered along the slice normal. Headers and pixel
+//! data are read in parallel.
+class DICOMMultiVolumeReader
+{
+public:
+  typedef itk::ImageBase<3> VolumeBase;
+
+  //! Reads the headers of the largest series in directory.
+  //! Throws FileNotFoundException if there are no DICOM files, and
+  //! WrongFileFormatException if the files do not form a multi-volume.
+  DICOMMultiVolumeReader(const std::string& directory);
+
+  virtual ~DICOMMultiVolumeReader() {}
+
+  //! Files of the largest series in directory, empty if there is none.
+  static std::vector<std::string> getSeriesFileNames(const std::string& directory);
+
+  unsigned int getNumberOfFrames() const { return m_frameTimes.size(); }
+
+  //! Pixel type of the files, FLOAT if it is not the same for all of them,
+  //! e.g. when the rescale slope differs between files
+  itk::ImageIOBase::IOComponentType getComponentType() const { return m_componentType; }
+
+  //! Sets geometry, number of components and the meta data of a Slicer
+  //! MultiVolume (frame labels, repetition time, flip angle, echo time).
+  void copyInformation(VolumeBase* volume) const;
+
+  //! Decodes all slices into the buffer of a volume set up with
+  //! copyInformation() and allocated. Integer volumes must have the type of
+  //! getComponentType(), else a std::runtime_error is thrown.
+  void read(itk::VectorImage<float, 3>* volume) const;
+  void read(itk::VectorImage<short, 3>* volume) const;
+  void read(itk::VectorImage<unsigned short, 3>* volume) const;
+
+private:
+  //! Header values of one file
+  struct Slice
+  {
+    std::string fileName;
+    double origin[3];
+    double direction[3][3];
+    // in plane, and the slice spacing of the file
+    double spacing[3];
+    unsigned int size[2];
+    itk::ImageIOBase::IOComponentType componentType;
+    std::string triggerTime;
+    std::string acquisitionTime;
+    std::string repetitionTime;
+    std::string flipAngle;
+    std::string echoTime;
+  };
+
+  //! Converts the pixels of one slice into slice sliceIndex, component
+  //! frame, of the volume buffer
+  typedef void (*ScatterFunction)(const char* slice, itk::ImageIOBase::IOComponentType componentType,
+                                  std::size_t sliceSize, unsigned int numberOfFrames, unsigned int frame,
+                                  std::size_t sliceIndex, void* volume);
+
+  struct ThreadStruct
+  {
+    const DICOMMultiVolumeReader* reader;
+    std::vector<Slice>* slices;
+    std::size_t numberOfItems;
+    // pixel data is read when set, else the headers
+    void* buffer;
+    ScatterFunction scatter;
+    itk::ImageIOBase::IOComponentType bufferType;
+    std::vector<std::string> errors;
+  };
+
+  void readInParallel(ThreadStruct& str) const;
+  void readPixels(void* buffer, ScatterFunction scatter, itk::ImageIOBase::IOComponentType bufferType) const;
+  static ITK_THREAD_RETURN_TYPE readThreaderCallback(void* arg);
+  static void readHeader(Slice& slice);
+  void readSlice(std::size_t item, void* buffer, ScatterFunction scatter,
+                 itk::ImageIOBase::IOComponentType bufferType) const;
+
+  std::string m_directory;
+  std::vector<Slice> m_slices;
+  // m_frames[frame][slice] indexes m_slices
+  std::vector<std::vector<std::size_t> > m_frames;
+  std::vector<double> m_frameTimes;
+  std::string m_frameTagName;
+  double m_sliceSpacing;
+  itk::ImageIOBase::IOComponentType m_componentType;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "HDF5CurveWriter.h"
+
+#include "Exceptions.h"
+
+#include <algorithm>
+
+const unsigned int HDF5CurveWriter::ChunkSize[3] = { 8, 8, 4 };
+
+namespace
+{
+  //! Closes an HDF5 identifier when it goes out of scope, throws if it is
+  //! not valid
+  class Identifier
+  {
+  public:
+    typedef herr_t (*CloseFunction)(hid_t);
+
+    Identifier(hid_t id, CloseFunction close, const std::string& error) : m_id(id), m_close(close)
+    {
+      if (m_id < 0) {
+        throw std::runtime_error(error);
+      }
+    }
+    ~Identifier() { m_close(m_id); }
+
+    operator hid_t() const { return m_id; }
+
+  private:
+    Identifier(const Identifier&); // purposely not implemented
+    void operator=(const Identifier&);  // purposely not implemented
+
+    hid_t m_id;
+    CloseFunction m_close;
+  };
+
+  void check(herr_t status, const std::string& error)
+  {
+    if (status < 0) {
+      throw std::runtime_error(error);
+    }
+  }
+}
+
+HDF5CurveWriter::HDF5CurveWriter(const std::string& fileName, const unsigned int size[3], const double spacing[3],
+                                 const double origin[3], const double direction[3][3], int compressionLevel)
+  : m_fileName(fileName),
+    m_compressionLevel(compressionLevel)
+{
+  std::copy(size, size + 3, m_size);
+  m_file = H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (m_file < 0) {
+    throw FileNotFoundException(fileName);
+  }
+  try {
+    writeAttribute("spacing", spacing, 3);
+    writeAttribute("origin", origin, 3);
+    writeAttribute("direction", &direction[0][0], 9);
+  }
+  catch (...) {
+    H5Fclose(m_file);
+    throw;
+  }
+}
+
+HDF5CurveWriter::~HDF5CurveWriter()
+{
+  H5Fclose(m_file);
+}
+
+void HDF5CurveWriter::writeAttribute(const std::string& name, const std::string& value)
+{
+  const std::string error = "Writing attribute \"" + name + "\" to \"" + m_fileName + "\" failed.";
+  Identifier type(H5Tcopy(H5T_C_S1), H5Tclose, error);
+  check(H5Tset_size(type, std::max<std::size_t>(value.size(), 1)), error);
+  Identifier space(H5Screate(H5S_SCALAR), H5Sclose, error);
+  Identifier attribute(H5Acreate2(m_file, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose, error);
+  check(H5Awrite(attribute, type, value.c_str()), error);
+}
+
+void HDF5CurveWriter::writeAttribute(const std::string& name, const double* values, hsize_t count)
+{
+  const std::string error = "Writing attribute \"" + name + "\" to \"" + m_fileName + "\" failed.";
+  Identifier space(H5Screate_simple(1, &count, NULL), H5Sclose, error);
+  Identifier attribute(H5Acreate2(m_file, name.c_str(), H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, H5P_DEFAULT),
+                       H5Aclose, error);
+  check(H5Awrite(attribute, H5T_NATIVE_DOUBLE, values), error);
+}
+
+void HDF5CurveWriter::write(const std::string& name, const float* buffer, unsigned int numberOfComponents)
+{
+  write(name, buffer, H5T_NATIVE_FLOAT, numberOfComponents);
+}
+
+void HDF5CurveWriter::write(const std::string& name, const short* buffer, unsigned int numberOfComponents)
+{
+  write(name, buffer, H5T_NATIVE_SHORT, numberOfComponents);
+}
+
+void HDF5CurveWriter::write(const std::string& name, const unsigned short* buffer, unsigned int numberOfComponents)
+{
+  write(name, buffer, H5T_NATIVE_USHORT, numberOfComponents);
+}
+
+void HDF5CurveWriter::write(const std::string& name, const void* buffer, hid_t type, unsigned int numberOfComponents)
+{
+  const std::string error = "Writing \"" + name + "\" to \"" + m_fileName + "\" failed.";
+
+  // slowest varying first
+  const hsize_t dimensions[4] = { m_size[2], m_size[1], m_size[0], numberOfComponents };
+  hsize_t chunk[4] = { ChunkSize[2], ChunkSize[1], ChunkSize[0], numberOfComponents };
+  for (unsigned int i = 0; i < 4; ++i) {
+    chunk[i] = std::max<hsize_t>(std::min(chunk[i], dimensions[i]), 1);
+  }
+
+  Identifier properties(H5Pcreate(H5P_DATASET_CREATE), H5Pclose, error);
+  check(H5Pset_chunk(properties, 4, chunk), error);
+  if (m_compressionLevel > 0) {
+    // grouping the bytes of the values by significance compresses better
+    check(H5Pset_shuffle(properties), error);
+    check(H5Pset_deflate(properties, std::min(m_compressionLevel, 9)), error);
+  }
+
+  Identifier space(H5Screate_simple(4, dimensions, NULL), H5Sclose, error);
+  Identifier dataset(H5Dcreate2(m_file, name.c_str(), type, space, H5P_DEFAULT, properties, H5P_DEFAULT),
+                     H5Dclose, error);
+  check(H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer), error);
+}
@@ -0,0 +1,55 @@
+#ifndef __HDF5CurveWriter_h
+#define __HDF5CurveWriter_h
+
+#include "itk_hdf5.h"
+
+#include <string>
+
+//! Writes curve volumes, e.g. the concentrations and the fitted curves, to
+//! one HDF5 file for random access to the curves of single voxels or slabs.
+//! Each volume is a dataset of size z x y x x x time (time varying fastest,
+//! as in the buffer of an itk::VectorImage) stored in chunks of a few
+//! neighbouring voxels with all their time points, each chunk compressed on
+//! its own. Reading a curve then only decompresses the chunk it is in.
+//!
+//! The geometry is stored in the root attributes "spacing", "origin" (x, y,
+//! z) and "direction" (row major). The HDF5 library bundled with ITK is not
+//! thread safe, no other HDF5 file may be written at the same time.
+class HDF5CurveWriter
+{
+public:
+  //! Voxels of a chunk along x, y and z, fewer along smaller axes
+  static const unsigned int ChunkSize[3];
+
+  //! Creates fileName for a volume of size x, y and z voxels, replacing an
+  //! existing file. compressionLevel is the deflate level, 0 for none.
+  //! Throws FileNotFoundException if the file cannot be created.
+  HDF5CurveWriter(const std::string& fileName, const unsigned int size[3], const double spacing[3],
+                  const double origin[3], const double direction[3][3], int compressionLevel);
+
+  //! Closes the file
+  virtual ~HDF5CurveWriter();
+
+  //! Adds a string attribute to the root group, e.g. the MultiVolume meta data
+  void writeAttribute(const std::string& name, const std::string& value);
+
+  //! Writes the numberOfComponents values of every voxel of buffer to the
+  //! dataset name, in their own type. Throws a std::runtime_error on failure.
+  void write(const std::string& name, const float* buffer, unsigned int numberOfComponents);
+  void write(const std::string& name, const short* buffer, unsigned int numberOfComponents);
+  void write(const std::string& name, const unsigned short* buffer, unsigned int numberOfComponents);
+
+private:
+  HDF5CurveWriter(const HDF5CurveWriter&); // purposely not implemented
+  void operator=(const HDF5CurveWriter&);  // purposely not implemented
+
+  void write(const std::string& name, const void* buffer, hid_t type, unsigned int numberOfComponents);
+  void writeAttribute(const std::string& name, const double* values, hsize_t count);
+
+  const std::string m_fileName;
+  const int m_compressionLevel;
+  unsigned int m_size[3];
+  hid_t m_file;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "MappedFile.h"
+
+#include "Exceptions.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& fileName)
+  : m_data(NULL), m_size(0), m_fileName(fileName), m_mappingHandle(NULL)
+{
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw FileNotFoundException(fileName);
+  }
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    throw FileNotFoundException(fileName);
+  }
+  // the mapping keeps the file open
+  m_mappingHandle = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!m_mappingHandle) {
+    throw FileNotFoundException(fileName);
+  }
+  m_data = static_cast<char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_COPY, 0, 0, 0));
+  if (!m_data) {
+    CloseHandle(m_mappingHandle);
+    throw FileNotFoundException(fileName);
+  }
+  m_size = static_cast<std::size_t>(fileSize.QuadPart);
+}
+
+MappedFile::MappedFile(const std::string& fileName, std::size_t size)
+  : m_data(NULL), m_size(0), m_fileName(fileName), m_mappingHandle(NULL)
+{
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE || size == 0) {
+    if (file != INVALID_HANDLE_VALUE) {
+      CloseHandle(file);
+    }
+    throw FileNotFoundException(fileName);
+  }
+  // mapping more than the file holds extends it
+  const unsigned long long mappingSize = size;
+  m_mappingHandle = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+                                       static_cast<DWORD>(mappingSize >> 32), static_cast<DWORD>(mappingSize), NULL);
+  CloseHandle(file);
+  if (!m_mappingHandle) {
+    throw FileNotFoundException(fileName);
+  }
+  m_data = static_cast<char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_WRITE, 0, 0, 0));
+  if (!m_data) {
+    CloseHandle(m_mappingHandle);
+    throw FileNotFoundException(fileName);
+  }
+  m_size = size;
+}
+
+MappedFile::~MappedFile()
+{
+  UnmapViewOfFile(m_data);
+  CloseHandle(m_mappingHandle);
+}
+
+void MappedFile::flush() const
+{
+  if (!FlushViewOfFile(m_data, 0)) {
+    throw std::runtime_error("Writing \"" + m_fileName + "\" failed.");
+  }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& fileName)
+  : m_data(NULL), m_size(0), m_fileName(fileName)
+{
+  const int file = open(fileName.c_str(), O_RDONLY);
+  if (file < 0) {
+    throw FileNotFoundException(fileName);
+  }
+  struct stat fileStatus;
+  if (fstat(file, &fileStatus) != 0 || fileStatus.st_size == 0) {
+    close(file);
+    throw FileNotFoundException(fileName);
+  }
+  // the mapping keeps the file open
+  void* data = mmap(NULL, static_cast<std::size_t>(fileStatus.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+  close(file);
+  if (data == MAP_FAILED) {
+    throw FileNotFoundException(fileName);
+  }
+  m_data = static_cast<char*>(data);
+  m_size = static_cast<std::size_t>(fileStatus.st_size);
+}
+
+MappedFile::MappedFile(const std::string& fileName, std::size_t size)
+  : m_data(NULL), m_size(0), m_fileName(fileName)
+{
+  const int file = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (file < 0) {
+    throw FileNotFoundException(fileName);
+  }
+  // the file is extended with zeros, without writing them
+  if (size == 0 || ftruncate(file, static_cast<off_t>(size)) != 0) {
+    close(file);
+    throw FileNotFoundException(fileName);
+  }
+  void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  close(file);
+  if (data == MAP_FAILED) {
+    throw FileNotFoundException(fileName);
+  }
+  m_data = static_cast<char*>(data);
+  m_size = size;
+}
+
+MappedFile::~MappedFile()
+{
+  munmap(m_data, m_size);
+}
+
+void MappedFile::flush() const
+{
+  if (msync(m_data, m_size, MS_SYNC) != 0) {
+    throw std::runtime_error("Writing \"" + m_fileName + "\" failed.");
+  }
+}
+
+#endif
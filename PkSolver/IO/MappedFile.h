@@ -0,0 +1,45 @@
+#ifndef __MappedFile_h
+#define __MappedFile_h
+
+#include <cstddef>
+#include <string>
+
+//! A whole file mapped into memory. The pages of an existing file are
+//! private copy-on-write pages, so the data can serve as an image buffer
+//! without ever changing the file. The pages of a created file are shared
+//! with the file, the data written to them ends up in the file. The mapping
+//! is released with the object.
+class MappedFile
+{
+public:
+  //! Maps the file.
+  //! Throws FileNotFoundException if the file cannot be opened or mapped.
+  MappedFile(const std::string& fileName);
+
+  //! Creates the file with size zero bytes, replacing an existing one, and
+  //! maps it for writing.
+  //! Throws FileNotFoundException if the file cannot be created or mapped.
+  MappedFile(const std::string& fileName, std::size_t size);
+
+  virtual ~MappedFile();
+
+  char* data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+
+  //! Writes the changed pages of a created file to the file and waits for
+  //! it. Throws a std::runtime_error if they could not be written.
+  void flush() const;
+
+private:
+  MappedFile(const MappedFile&); // purposely not implemented
+  void operator=(const MappedFile&); // purposely not implemented
+
+  char* m_data;
+  std::size_t m_size;
+  std::string m_fileName;
+#ifdef _WIN32
+  void* m_mappingHandle;
+#endif
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "MappedNrrdVolume.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+  bool isLittleEndian()
+  {
+    const unsigned short one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 1;
+  }
+
+  std::string vector3(const double* values, std::size_t stride = 1)
+  {
+    std::ostringstream out;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << "(" << values[0] << "," << values[stride] << "," << values[2 * stride] << ")";
+    return out.str();
+  }
+}
+
+bool MappedNrrdVolume::canMap(const std::string& fileName)
+{
+  const std::string extension = ".nrrd";
+  return fileName.size() > extension.size() &&
+         fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+MappedNrrdVolume::MappedNrrdVolume(const std::string& fileName, const unsigned int size[3],
+                                   unsigned int numberOfComponents, const double spacing[3], const double origin[3],
+                                   const double direction[3][3], const std::map<std::string, std::string>& metaData)
+  : m_data(NULL),
+    m_numberOfValues(static_cast<std::size_t>(size[0]) * size[1] * size[2] * numberOfComponents)
+{
+  std::ostringstream header;
+  header << "NRRD0004" << "\n"
+         << "# Complete NRRD file format specification at:" << "\n"
+         << "# http://teem.sourceforge.net/nrrd/format.html" << "\n"
+         << "type: float" << "\n"
+         << "dimension: 4" << "\n"
+         << "space: left-posterior-superior" << "\n"
+         << "sizes: " << numberOfComponents << " " << size[0] << " " << size[1] << " " << size[2] << "\n";
+
+  // the axes scaled by their spacing
+  double axes[3][3];
+  for (unsigned int axis = 0; axis < 3; ++axis) {
+    for (unsigned int i = 0; i < 3; ++i) {
+      axes[axis][i] = direction[i][axis] * spacing[axis];
+    }
+  }
+  header << "space directions: none " << vector3(axes[0]) << " " << vector3(axes[1]) << " " << vector3(axes[2]) << "\n"
+         << "kinds: list domain domain domain" << "\n"
+         << "endian: " << (isLittleEndian() ? "little" : "big") << "\n"
+         << "encoding: raw" << "\n"
+         << "space origin: " << vector3(origin) << "\n";
+
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = metaData.begin(); it != metaData.end(); ++it) {
+    // a line break would end the field
+    if (it->first.find_first_of("\n:") == std::string::npos && it->second.find('\n') == std::string::npos) {
+      header << it->first << ":=" << it->second << "\n";
+    }
+  }
+
+  // a comment pads the header so that the voxels are aligned for floats
+  std::string text = header.str();
+  const std::size_t alignment = 16;
+  const std::size_t length = text.size() + 2 + 1;
+  const std::size_t padding = (alignment - length % alignment) % alignment;
+  text += "#" + std::string(padding, ' ') + "\n" + "\n";
+
+  m_file.reset(new MappedFile(fileName, text.size() + m_numberOfValues * sizeof(float)));
+  std::copy(text.begin(), text.end(), m_file->data());
+  m_data = reinterpret_cast<float*>(m_file->data() + text.size());
+}
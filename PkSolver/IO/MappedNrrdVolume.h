@@ -0,0 +1,43 @@
+#ifndef __MappedNrrdVolume_h
+#define __MappedNrrdVolume_h
+
+#include "MappedFile.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+//! An uncompressed float multi-volume NRRD file created before the volume
+//! is computed, with its voxels mapped into memory. Used as the buffer of
+//! the volume, the voxels are written straight into the file and writing
+//! the volume is a flush of the mapping. The header is the one
+//! itk::NrrdImageIO writes for an itk::VectorImage.
+class MappedNrrdVolume
+{
+public:
+  //! Whether fileName is a file type that can be mapped (.nrrd)
+  static bool canMap(const std::string& fileName);
+
+  //! Creates fileName for size x, y and z voxels of numberOfComponents
+  //! values. The geometry is in LPS, direction row major with the axes as
+  //! columns, metaData holds the key/value pairs of the header.
+  //! Throws FileNotFoundException if the file cannot be created or mapped.
+  MappedNrrdVolume(const std::string& fileName, const unsigned int size[3], unsigned int numberOfComponents,
+                   const double spacing[3], const double origin[3], const double direction[3][3],
+                   const std::map<std::string, std::string>& metaData);
+
+  //! The components of a voxel next to each other, x fastest; all zero
+  //! until they are written
+  float* data() const { return m_data; }
+  std::size_t numberOfValues() const { return m_numberOfValues; }
+
+  //! Writes the voxels to the file, throws a std::runtime_error on failure
+  void flush() const { m_file->flush(); }
+
+private:
+  std::unique_ptr<MappedFile> m_file;
+  float* m_data;
+  std::size_t m_numberOfValues;
+};
+
+#endif
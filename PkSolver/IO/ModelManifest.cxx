@@ -0,0 +1,167 @@
+#include "ModelManifest.h"
+
+#include "CSVReader.h"
+#include "Exceptions.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+  const int Version = 1;
+  const unsigned int NumberOfParkerParameters = 11;
+
+  double* parkerValues(ParkerAIFModel::Parameters& parameters, double* values)
+  {
+    double* fields[NumberOfParkerParameters] = {
+      &parameters.a1, &parameters.a2, &parameters.T1, &parameters.T2, &parameters.sigma1, &parameters.sigma2,
+      &parameters.alpha, &parameters.beta, &parameters.s, &parameters.tau, &parameters.arrival };
+    for (unsigned int i = 0; i < NumberOfParkerParameters; ++i) {
+      values[i] = *fields[i];
+    }
+    return values;
+  }
+
+  void setParkerValues(const std::vector<std::string>& row, std::size_t first, ParkerAIFModel::Parameters& parameters)
+  {
+    double* fields[NumberOfParkerParameters] = {
+      &parameters.a1, &parameters.a2, &parameters.T1, &parameters.T2, &parameters.sigma1, &parameters.sigma2,
+      &parameters.alpha, &parameters.beta, &parameters.s, &parameters.tau, &parameters.arrival };
+    for (unsigned int i = 0; i < NumberOfParkerParameters; ++i) {
+      *fields[i] = std::atof(row[first + i].c_str());
+    }
+  }
+
+  //! Writes each value after a comma, with enough digits to be read back
+  //! exactly
+  template <typename T>
+  void writeValues(std::ostream& out, const T* values, std::size_t count)
+  {
+    out.precision(std::numeric_limits<T>::max_digits10);
+    for (std::size_t i = 0; i < count; ++i) {
+      out << "," << values[i];
+    }
+  }
+
+  //! AIF rows: <name>[,label],BATIndex,BATPosition,curve... and
+  //! <name>Parker[,label],parameters...
+  void writeAIF(std::ostream& out, const std::string& name, const std::string& label, const ModelManifest::AIF& aif)
+  {
+    out << name << label << "," << aif.BATIndex;
+    writeValues(out, &aif.BATPosition, 1);
+    writeValues(out, aif.curve.empty() ? NULL : &aif.curve[0], aif.curve.size());
+    out << std::endl;
+    if (aif.hasParkerParameters) {
+      ParkerAIFModel::Parameters parameters = aif.parkerParameters;
+      double values[NumberOfParkerParameters];
+      out << name << "Parker" << label;
+      writeValues(out, parkerValues(parameters, values), NumberOfParkerParameters);
+      out << std::endl;
+    }
+  }
+
+  void readAIF(const std::vector<std::string>& row, std::size_t first, ModelManifest::AIF& aif)
+  {
+    aif.BATIndex = std::atoi(row[first].c_str());
+    aif.BATPosition = static_cast<float>(std::atof(row[first + 1].c_str()));
+    aif.curve.clear();
+    for (std::size_t i = first + 2; i < row.size(); ++i) {
+      aif.curve.push_back(static_cast<float>(std::atof(row[i].c_str())));
+    }
+  }
+}
+
+void writeModelManifest(const std::string& fileName, const ModelManifest& manifest)
+{
+  std::ofstream out(fileName.c_str());
+  if (!out) {
+    throw FileNotFoundException(fileName);
+  }
+  out << "# PkModeling model manifest" << std::endl;
+  out << "Version," << Version << std::endl;
+  out << "ModelType," << manifest.modelType << std::endl;
+  out << "Hematocrit";
+  writeValues(out, &manifest.hematocrit, 1);
+  out << std::endl;
+  out << "AIFShiftsPerFrame," << manifest.aifShiftsPerFrame << std::endl;
+  out << "Timing";
+  writeValues(out, manifest.timing.empty() ? NULL : &manifest.timing[0], manifest.timing.size());
+  out << std::endl;
+
+  writeAIF(out, "AIF", "", manifest.aif);
+  std::map<unsigned int, ModelManifest::AIF>::const_iterator it;
+  for (it = manifest.regionalAIFs.begin(); it != manifest.regionalAIFs.end(); ++it) {
+    std::ostringstream label;
+    label << "," << it->first;
+    writeAIF(out, "RegionalAIF", label.str(), it->second);
+  }
+
+  if (!out.flush()) {
+    throw FileNotFoundException(fileName);
+  }
+}
+
+void readModelManifest(const std::string& fileName, ModelManifest& manifest)
+{
+  manifest = ModelManifest();
+  bool hasVersion = false;
+  bool hasAIF = false;
+
+  CSVReader reader(fileName);
+  while (reader.hasMoreRows()) {
+    const std::vector<std::string> row = reader.nextRow();
+    if (row.empty()) {
+      continue;
+    }
+    const std::string& key = row[0];
+    if (key == "Version" && row.size() == 2) {
+      hasVersion = std::atoi(row[1].c_str()) == Version;
+    }
+    else if (key == "ModelType" && row.size() == 2) {
+      manifest.modelType = std::atoi(row[1].c_str());
+    }
+    else if (key == "Hematocrit" && row.size() == 2) {
+      manifest.hematocrit = static_cast<float>(std::atof(row[1].c_str()));
+    }
+    else if (key == "AIFShiftsPerFrame" && row.size() == 2) {
+      manifest.aifShiftsPerFrame = std::atoi(row[1].c_str());
+    }
+    else if (key == "Timing") {
+      manifest.timing.clear();
+      for (std::size_t i = 1; i < row.size(); ++i) {
+        manifest.timing.push_back(static_cast<float>(std::atof(row[i].c_str())));
+      }
+    }
+    else if (key == "AIF" && row.size() >= 3) {
+      readAIF(row, 1, manifest.aif);
+      hasAIF = true;
+    }
+    else if (key == "AIFParker" && row.size() == NumberOfParkerParameters + 1) {
+      setParkerValues(row, 1, manifest.aif.parkerParameters);
+      manifest.aif.hasParkerParameters = true;
+    }
+    else if (key == "RegionalAIF" && row.size() >= 4) {
+      readAIF(row, 2, manifest.regionalAIFs[std::atoi(row[1].c_str())]);
+    }
+    else if (key == "RegionalAIFParker" && row.size() == NumberOfParkerParameters + 2) {
+      ModelManifest::AIF& aif = manifest.regionalAIFs[std::atoi(row[1].c_str())];
+      setParkerValues(row, 2, aif.parkerParameters);
+      aif.hasParkerParameters = true;
+    }
+    else {
+      throw WrongFileFormatException(fileName);
+    }
+  }
+
+  if (!hasVersion || !hasAIF || manifest.timing.size() < 2 || manifest.aif.curve.size() != manifest.timing.size()) {
+    throw WrongFileFormatException(fileName);
+  }
+  std::map<unsigned int, ModelManifest::AIF>::const_iterator it;
+  for (it = manifest.regionalAIFs.begin(); it != manifest.regionalAIFs.end(); ++it) {
+    if (it->second.curve.size() != manifest.timing.size()) {
+      throw WrongFileFormatException(fileName);
+    }
+  }
+}
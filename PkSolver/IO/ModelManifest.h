@@ -0,0 +1,53 @@
+#ifndef __ModelManifest_h
+#define __ModelManifest_h
+
+#include "AIF/ParkerAIFModel.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+//! Everything besides the parameter maps the fitted curves of a run depend
+//! on: model, time axis and the AIFs as used by the fit. The fitted curves
+//! can be regenerated from it with a ModelCurveGenerator instead of storing
+//! them.
+struct ModelManifest
+{
+  //! An AIF with its bolus arrival time
+  struct AIF
+  {
+    AIF() : BATIndex(0), BATPosition(0.0f), hasParkerParameters(false) {}
+
+    std::vector<float> curve;
+    int BATIndex;
+    //! BAT in fractional frames, BATIndex unless AIF shifts were enabled
+    float BATPosition;
+    //! The functional form, if the convolution was evaluated analytically
+    bool hasParkerParameters;
+    ParkerAIFModel::Parameters parkerParameters;
+  };
+
+  ModelManifest() : modelType(1), hematocrit(0.4f), aifShiftsPerFrame(0) {}
+
+  //! LMCostFunction::ModelType
+  int modelType;
+  float hematocrit;
+  unsigned int aifShiftsPerFrame;
+  //! Time points in seconds
+  std::vector<float> timing;
+  AIF aif;
+  //! AIFs of the regions of the AIF region map, by label
+  std::map<unsigned int, AIF> regionalAIFs;
+};
+
+//! Writes the manifest as rows of comma separated values, the first value
+//! of a row names it. Throws FileNotFoundException if the file cannot be
+//! written.
+void writeModelManifest(const std::string& fileName, const ModelManifest& manifest);
+
+//! Reads a manifest written by writeModelManifest(). Throws
+//! FileNotFoundException if the file cannot be opened and
+//! WrongFileFormatException if it is not a complete manifest.
+void readModelManifest(const std::string& fileName, ModelManifest& manifest);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef __MultiVolumeMetaDataProvider_h
+#define __MultiVolumeMetaDataProvider_h
+
+#include <vector>
+
+//! Acquisition parameters of a multi-volume, independent of where they are
+//! stored, e.g. the MultiVolume meta data of the volume or a sidecar file.
+//! Throws FailedDictionaryLookup if a parameter is not given.
+class MultiVolumeMetaDataProvider
+{
+public:
+  virtual ~MultiVolumeMetaDataProvider() {}
+
+  //! Repetition time of the sequence in ms
+  virtual float getRepetitionTime() const = 0;
+  //! Flip angle in degrees
+  virtual float getFlipAngle() const = 0;
+  //! Time of each frame in seconds, relative to the first frame
+  virtual std::vector<float> getTiming() const = 0;
+};
+
+#endif
@@ -8,7 +8,7 @@ MultiVolumeMetaDictReader::MultiVolumeMetaDictReader(const itk::MetaDataDictiona
   : m_dictionary(dictionary) 
 {}
 
-float MultiVolumeMetaDictReader::get(const std::string& key)
+float MultiVolumeMetaDictReader::get(const std::string& key) const
 {
   std::string valueString = "";
   bool readSuccess = itk::ExposeMetaData(m_dictionary, key, valueString);
@@ -19,11 +19,21 @@ float MultiVolumeMetaDictReader::get(const std::string& key)
     }
     catch (const std::invalid_argument& ia)
     {}
-    throw FailedDictionaryLookup(key);
   }
+  throw FailedDictionaryLookup(key);
 }
 
-std::vector<float> MultiVolumeMetaDictReader::getTiming()
+float MultiVolumeMetaDictReader::getRepetitionTime() const
+{
+  return get("MultiVolume.DICOM.RepetitionTime");
+}
+
+float MultiVolumeMetaDictReader::getFlipAngle() const
+{
+  return get("MultiVolume.DICOM.FlipAngle");
+}
+
+std::vector<float> MultiVolumeMetaDictReader::getTiming() const
 {
   std::vector<float> triggerTimes;
 
@@ -1,17 +1,24 @@
 #ifndef __MultiVolumeMetaDictReader_h
 #define __MultiVolumeMetaDictReader_h
 
+#include "MultiVolumeMetaDataProvider.h"
+
 #include "itkMetaDataDictionary.h"
 
-class MultiVolumeMetaDictReader
+//! Acquisition parameters from the MultiVolume meta data Slicer stores with
+//! a multi-volume, e.g. in the header of a NRRD file
+class MultiVolumeMetaDictReader : public MultiVolumeMetaDataProvider
 {
 public:
   MultiVolumeMetaDictReader(const itk::MetaDataDictionary& dictionary);
 
   virtual ~MultiVolumeMetaDictReader() {}
 
-  float get(const std::string& key);
-  std::vector<float> getTiming();
+  float get(const std::string& key) const;
+
+  virtual float getRepetitionTime() const;
+  virtual float getFlipAngle() const;
+  virtual std::vector<float> getTiming() const;
 
 private:
   const itk::MetaDataDictionary& m_dictionary;
@@ -0,0 +1,276 @@
+#include "RawVolumeLayout.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+
+namespace
+{
+  bool isLittleEndian()
+  {
+    const unsigned short one = 1;
+    return *reinterpret_cast<const unsigned char*>(&one) == 1;
+  }
+
+  bool endsWith(const std::string& s, const std::string& suffix)
+  {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  std::string trim(const std::string& s)
+  {
+    const std::string::size_type first = s.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+      return "";
+    }
+    return s.substr(first, s.find_last_not_of(" \t\r") - first + 1);
+  }
+
+  bool nrrdComponentType(const std::string& type, RawVolumeLayout::ComponentType& componentType)
+  {
+    static std::map<std::string, RawVolumeLayout::ComponentType> types;
+    if (types.empty()) {
+      types["signed char"] = types["int8"] = types["int8_t"] = RawVolumeLayout::INT8;
+      types["uchar"] = types["unsigned char"] = types["uint8"] = types["uint8_t"] = RawVolumeLayout::UINT8;
+      types["short"] = types["short int"] = types["signed short"] = types["signed short int"] =
+        types["int16"] = types["int16_t"] = RawVolumeLayout::INT16;
+      types["ushort"] = types["unsigned short"] = types["unsigned short int"] =
+        types["uint16"] = types["uint16_t"] = RawVolumeLayout::UINT16;
+      types["int"] = types["signed int"] = types["int32"] = types["int32_t"] = RawVolumeLayout::INT32;
+      types["uint"] = types["unsigned int"] = types["uint32"] = types["uint32_t"] = RawVolumeLayout::UINT32;
+      types["float"] = RawVolumeLayout::FLOAT;
+      types["double"] = RawVolumeLayout::DOUBLE;
+    }
+    std::map<std::string, RawVolumeLayout::ComponentType>::const_iterator it = types.find(type);
+    if (it == types.end()) {
+      return false;
+    }
+    componentType = it->second;
+    return true;
+  }
+
+  bool readNrrdLayout(const std::string& fileName, RawVolumeLayout& layout)
+  {
+    std::ifstream header(fileName.c_str(), std::ios::binary);
+    std::string line;
+    if (!std::getline(header, line) || line.compare(0, 7, "NRRD000") != 0) {
+      return false;
+    }
+
+    std::map<std::string, std::string> fields;
+    bool attached = false;
+    while (std::getline(header, line)) {
+      line = trim(line);
+      if (line.empty()) {
+        // the data follows the blank line after the header
+        attached = true;
+        break;
+      }
+      const std::string::size_type separator = line.find(": ");
+      if (line[0] == '#' || separator == std::string::npos) {
+        // comments and key/value pairs
+        continue;
+      }
+      fields[line.substr(0, separator)] = trim(line.substr(separator + 2));
+    }
+
+    if (fields["dimension"] != "4" || fields["encoding"] != "raw" ||
+        !nrrdComponentType(fields["type"], layout.componentType)) {
+      return false;
+    }
+    if (layout.componentSize() > 1 && fields["endian"] != (isLittleEndian() ? "little" : "big")) {
+      return false;
+    }
+    const std::string lineSkip = fields.count("line skip") ? fields["line skip"] : fields["lineskip"];
+    if (!lineSkip.empty() && lineSkip != "0") {
+      return false;
+    }
+
+    // The list axis must come first for the components to be interleaved
+    std::istringstream kinds(fields["kinds"]);
+    std::string kind;
+    if (!(kinds >> kind) || kind == "domain" || kind == "space" || kind == "time") {
+      return false;
+    }
+    std::istringstream sizes(fields["sizes"]);
+    std::size_t size[4];
+    if (!(sizes >> size[0] >> size[1] >> size[2] >> size[3])) {
+      return false;
+    }
+    layout.numberOfComponents = static_cast<unsigned int>(size[0]);
+    layout.numberOfVoxels = size[1] * size[2] * size[3];
+    layout.interleaved = true;
+
+    long byteSkip = 0;
+    const std::string byteSkipField = fields.count("byte skip") ? fields["byte skip"] : fields["byteskip"];
+    if (!byteSkipField.empty()) {
+      std::istringstream byteSkipStream(byteSkipField);
+      if (!(byteSkipStream >> byteSkip) || byteSkip < 0) {
+        return false;
+      }
+    }
+
+    const std::string dataFile = fields.count("data file") ? fields["data file"] : fields["datafile"];
+    if (!dataFile.empty()) {
+      // a single detached data file, relative to the header
+      if (dataFile.find(' ') != std::string::npos) {
+        return false;
+      }
+      const std::string::size_type directoryEnd = fileName.find_last_of("/\\");
+      layout.dataFileName = (dataFile[0] == '/' || directoryEnd == std::string::npos) ?
+        dataFile : fileName.substr(0, directoryEnd + 1) + dataFile;
+      layout.dataOffset = static_cast<std::size_t>(byteSkip);
+    }
+    else if (attached) {
+      layout.dataFileName = fileName;
+      layout.dataOffset = static_cast<std::size_t>(header.tellg()) + static_cast<std::size_t>(byteSkip);
+    }
+    else {
+      return false;
+    }
+    return true;
+  }
+
+  bool readNiftiLayout(const std::string& fileName, RawVolumeLayout& layout)
+  {
+    std::ifstream header(fileName.c_str(), std::ios::binary);
+    char buffer[348];
+    if (!header.read(buffer, sizeof(buffer))) {
+      return false;
+    }
+    int headerSize;
+    std::memcpy(&headerSize, buffer, sizeof(headerSize));
+    // a different byte order shows as a different header size
+    if (headerSize != 348 || std::strcmp(buffer + 344, "n+1") != 0) {
+      return false;
+    }
+    short dim[8];
+    short datatype;
+    float voxOffset, sclSlope, sclInter;
+    std::memcpy(dim, buffer + 40, sizeof(dim));
+    std::memcpy(&datatype, buffer + 70, sizeof(datatype));
+    std::memcpy(&voxOffset, buffer + 108, sizeof(voxOffset));
+    std::memcpy(&sclSlope, buffer + 112, sizeof(sclSlope));
+    std::memcpy(&sclInter, buffer + 116, sizeof(sclInter));
+    if ((sclSlope != 0.0f && sclSlope != 1.0f) || (sclSlope != 0.0f && sclInter != 0.0f)) {
+      return false;
+    }
+
+    switch (datatype) {
+      case 2:   layout.componentType = RawVolumeLayout::UINT8; break;
+      case 4:   layout.componentType = RawVolumeLayout::INT16; break;
+      case 8:   layout.componentType = RawVolumeLayout::INT32; break;
+      case 16:  layout.componentType = RawVolumeLayout::FLOAT; break;
+      case 64:  layout.componentType = RawVolumeLayout::DOUBLE; break;
+      case 256: layout.componentType = RawVolumeLayout::INT8; break;
+      case 512: layout.componentType = RawVolumeLayout::UINT16; break;
+      case 768: layout.componentType = RawVolumeLayout::UINT32; break;
+      default: return false;
+    }
+
+    // The frames are either the fourth or, as vector components, the fifth dimension
+    if (dim[0] == 4) {
+      layout.numberOfComponents = dim[4];
+    }
+    else if (dim[0] == 5 && dim[4] == 1) {
+      layout.numberOfComponents = dim[5];
+    }
+    else {
+      return false;
+    }
+    if (dim[1] < 1 || dim[2] < 1 || dim[3] < 1 || layout.numberOfComponents < 1 || voxOffset < 348.0f) {
+      return false;
+    }
+    layout.numberOfVoxels = static_cast<std::size_t>(dim[1]) * dim[2] * dim[3];
+    layout.interleaved = false;
+    layout.dataFileName = fileName;
+    layout.dataOffset = static_cast<std::size_t>(voxOffset);
+    return true;
+  }
+
+  template <typename T, typename TOut>
+  void convertVoxels(const RawVolumeLayout& layout, const char* data,
+                     std::size_t firstVoxel, std::size_t count, TOut* out)
+  {
+    // memcpy, the data of an attached header is not necessarily aligned
+    const std::size_t components = layout.numberOfComponents;
+    T value;
+    if (layout.interleaved) {
+      const char* in = data + firstVoxel * components * sizeof(T);
+      for (std::size_t i = 0; i < count * components; ++i) {
+        std::memcpy(&value, in + i * sizeof(T), sizeof(T));
+        out[i] = static_cast<TOut>(value);
+      }
+    }
+    else {
+      for (std::size_t c = 0; c < components; ++c) {
+        const char* in = data + (c * layout.numberOfVoxels + firstVoxel) * sizeof(T);
+        for (std::size_t i = 0; i < count; ++i) {
+          std::memcpy(&value, in + i * sizeof(T), sizeof(T));
+          out[i * components + c] = static_cast<TOut>(value);
+        }
+      }
+    }
+  }
+}
+
+std::size_t RawVolumeLayout::componentSize() const
+{
+  switch (componentType) {
+    case INT8: case UINT8: return 1;
+    case INT16: case UINT16: return 2;
+    case INT32: case UINT32: case FLOAT: return 4;
+    case DOUBLE: return 8;
+  }
+  return 0;
+}
+
+bool readRawVolumeLayout(const std::string& fileName, RawVolumeLayout& layout)
+{
+  if (endsWith(fileName, ".nrrd") || endsWith(fileName, ".nhdr")) {
+    return readNrrdLayout(fileName, layout);
+  }
+  if (endsWith(fileName, ".nii")) {
+    return readNiftiLayout(fileName, layout);
+  }
+  return false;
+}
+
+namespace
+{
+  template <typename TOut>
+  void convertRawVoxelsTo(const RawVolumeLayout& layout, const char* data,
+                          std::size_t firstVoxel, std::size_t count, TOut* out)
+  {
+    switch (layout.componentType) {
+      case RawVolumeLayout::INT8:   convertVoxels<signed char>(layout, data, firstVoxel, count, out); break;
+      case RawVolumeLayout::UINT8:  convertVoxels<unsigned char>(layout, data, firstVoxel, count, out); break;
+      case RawVolumeLayout::INT16:  convertVoxels<short>(layout, data, firstVoxel, count, out); break;
+      case RawVolumeLayout::UINT16: convertVoxels<unsigned short>(layout, data, firstVoxel, count, out); break;
+      case RawVolumeLayout::INT32:  convertVoxels<int>(layout, data, firstVoxel, count, out); break;
+      case RawVolumeLayout::UINT32: convertVoxels<unsigned int>(layout, data, firstVoxel, count, out); break;
+      case RawVolumeLayout::FLOAT:  convertVoxels<float>(layout, data, firstVoxel, count, out); break;
+      case RawVolumeLayout::DOUBLE: convertVoxels<double>(layout, data, firstVoxel, count, out); break;
+    }
+  }
+}
+
+void convertRawVoxels(const RawVolumeLayout& layout, const char* data,
+                      std::size_t firstVoxel, std::size_t count, float* out)
+{
+  convertRawVoxelsTo(layout, data, firstVoxel, count, out);
+}
+
+void convertRawVoxels(const RawVolumeLayout& layout, const char* data,
+                      std::size_t firstVoxel, std::size_t count, short* out)
+{
+  convertRawVoxelsTo(layout, data, firstVoxel, count, out);
+}
+
+void convertRawVoxels(const RawVolumeLayout& layout, const char* data,
+                      std::size_t firstVoxel, std::size_t count, unsigned short* out)
+{
+  convertRawVoxelsTo(layout, data, firstVoxel, count, out);
+}
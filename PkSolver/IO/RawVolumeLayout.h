@@ -0,0 +1,65 @@
+#ifndef __RawVolumeLayout_h
+#define __RawVolumeLayout_h
+
+#include <cstddef>
+#include <string>
+
+//! Where and how the voxels of an uncompressed multi-volume are stored in
+//! its file, so that they can be read from a mapping of the file.
+struct RawVolumeLayout
+{
+  enum ComponentType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT, DOUBLE };
+
+  RawVolumeLayout()
+    : dataOffset(0), componentType(FLOAT), numberOfComponents(0), numberOfVoxels(0), interleaved(true)
+  {}
+
+  //! Bytes of one component
+  std::size_t componentSize() const;
+  //! Bytes of all voxels
+  std::size_t dataSize() const { return numberOfVoxels * numberOfComponents * componentSize(); }
+
+  //! File the voxels are in, the header file itself unless the header is detached
+  std::string dataFileName;
+  std::size_t dataOffset;
+  ComponentType componentType;
+  unsigned int numberOfComponents;
+  //! Voxels of one volume
+  std::size_t numberOfVoxels;
+  //! The components of a voxel are next to each other (NRRD with the list
+  //! axis first), else each component is a volume of its own (NIfTI)
+  bool interleaved;
+};
+
+//! Reads the layout from the header of a NRRD (.nrrd, .nhdr) or NIfTI-1
+//! (.nii) file. Returns false if the voxels cannot be read directly, e.g.
+//! compressed data, a byte order other than the one of this machine, or
+//! scaled values.
+bool readRawVolumeLayout(const std::string& fileName, RawVolumeLayout& layout);
+
+//! Converts count voxels from firstVoxel on to the type of out, the
+//! components of a voxel next to each other. data points to the first byte
+//! of the voxels.
+void convertRawVoxels(const RawVolumeLayout& layout, const char* data,
+                      std::size_t firstVoxel, std::size_t count, float* out);
+void convertRawVoxels(const RawVolumeLayout& layout, const char* data,
+                      std::size_t firstVoxel, std::size_t count, short* out);
+void convertRawVoxels(const RawVolumeLayout& layout, const char* data,
+                      std::size_t firstVoxel, std::size_t count, unsigned short* out);
+
+//! Component type of the voxel types above
+template <typename T> struct RawVolumeComponentType;
+template <> struct RawVolumeComponentType<float>
+{
+  static const RawVolumeLayout::ComponentType value = RawVolumeLayout::FLOAT;
+};
+template <> struct RawVolumeComponentType<short>
+{
+  static const RawVolumeLayout::ComponentType value = RawVolumeLayout::INT16;
+};
+template <> struct RawVolumeComponentType<unsigned short>
+{
+  static const RawVolumeLayout::ComponentType value = RawVolumeLayout::UINT16;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "SparseVolume.h"
+
+#include "Exceptions.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+  const char Magic[8] = { 'P', 'K', 'S', 'P', 'A', 'R', 'S', 'E' };
+  const unsigned int Version = 1;
+  // reads as a different value in the other byte order
+  const unsigned int ByteOrderMark = 0x01020304;
+
+  template <typename T>
+  void writeValue(std::ostream& out, const T& value)
+  {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  void writeArray(std::ostream& out, const T* values, std::size_t count)
+  {
+    if (count > 0) {
+      out.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+  }
+
+  void writeString(std::ostream& out, const std::string& value)
+  {
+    writeValue(out, static_cast<unsigned int>(value.size()));
+    out.write(value.data(), value.size());
+  }
+
+  //! Reading throws on a truncated file
+  class Reader
+  {
+  public:
+    Reader(std::istream& in, const std::string& fileName) : m_in(in), m_fileName(fileName) {}
+
+    template <typename T>
+    T value()
+    {
+      T value;
+      read(reinterpret_cast<char*>(&value), sizeof(T));
+      return value;
+    }
+
+    template <typename T>
+    void array(std::vector<T>& values, std::size_t count)
+    {
+      values.resize(count);
+      if (count > 0) {
+        read(reinterpret_cast<char*>(&values[0]), count * sizeof(T));
+      }
+    }
+
+    std::string string()
+    {
+      const unsigned int length = value<unsigned int>();
+      std::string value(length, '\0');
+      if (length > 0) {
+        read(&value[0], length);
+      }
+      return value;
+    }
+
+  private:
+    void read(char* data, std::size_t count)
+    {
+      if (!m_in.read(data, count)) {
+        throw WrongFileFormatException(m_fileName);
+      }
+    }
+
+    std::istream& m_in;
+    const std::string& m_fileName;
+  };
+}
+
+SparseVolume::SparseVolume()
+{
+  for (unsigned int i = 0; i < 3; ++i) {
+    size[i] = 0;
+    spacing[i] = 1.0;
+    origin[i] = 0.0;
+    for (unsigned int j = 0; j < 3; ++j) {
+      direction[i][j] = i == j ? 1.0 : 0.0;
+    }
+  }
+}
+
+void writeSparseVolume(const std::string& fileName, const SparseVolume& volume)
+{
+  std::ofstream out(fileName.c_str(), std::ios::binary);
+  if (!out) {
+    throw FileNotFoundException(fileName);
+  }
+
+  out.write(Magic, sizeof(Magic));
+  writeValue(out, Version);
+  writeValue(out, ByteOrderMark);
+  writeArray(out, volume.size, 3);
+  writeArray(out, volume.spacing, 3);
+  writeArray(out, volume.origin, 3);
+  writeArray(out, &volume.direction[0][0], 9);
+
+  writeValue(out, static_cast<unsigned int>(volume.metaData.size()));
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = volume.metaData.begin(); it != volume.metaData.end(); ++it) {
+    writeString(out, it->first);
+    writeString(out, it->second);
+  }
+
+  const unsigned long long numberOfVoxels = volume.indices.size();
+  writeValue(out, numberOfVoxels);
+  writeValue(out, static_cast<unsigned int>(volume.channels.size()));
+  for (std::size_t i = 0; i < volume.channels.size(); ++i) {
+    writeString(out, volume.channels[i].name);
+    writeValue(out, volume.channels[i].numberOfComponents);
+  }
+
+  // the indices, then the records of each channel as one block
+  writeArray(out, volume.indices.empty() ? NULL : &volume.indices[0], volume.indices.size());
+  for (std::size_t i = 0; i < volume.channels.size(); ++i) {
+    const SparseVolume::Channel& channel = volume.channels[i];
+    if (channel.values.size() != numberOfVoxels * channel.numberOfComponents) {
+      throw std::runtime_error("Sparse volume channel \"" + channel.name + "\" does not match the number of voxels.");
+    }
+    writeArray(out, channel.values.empty() ? NULL : &channel.values[0], channel.values.size());
+  }
+
+  if (!out.flush()) {
+    throw FileNotFoundException(fileName);
+  }
+}
+
+void readSparseVolume(const std::string& fileName, SparseVolume& volume)
+{
+  std::ifstream in(fileName.c_str(), std::ios::binary);
+  if (!in) {
+    throw FileNotFoundException(fileName);
+  }
+  Reader reader(in, fileName);
+
+  char magic[sizeof(Magic)];
+  for (std::size_t i = 0; i < sizeof(Magic); ++i) {
+    magic[i] = reader.value<char>();
+  }
+  if (std::memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+      reader.value<unsigned int>() != Version ||
+      reader.value<unsigned int>() != ByteOrderMark) {
+    throw WrongFileFormatException(fileName);
+  }
+
+  for (unsigned int i = 0; i < 3; ++i) {
+    volume.size[i] = reader.value<unsigned int>();
+  }
+  for (unsigned int i = 0; i < 3; ++i) {
+    volume.spacing[i] = reader.value<double>();
+  }
+  for (unsigned int i = 0; i < 3; ++i) {
+    volume.origin[i] = reader.value<double>();
+  }
+  for (unsigned int i = 0; i < 3; ++i) {
+    for (unsigned int j = 0; j < 3; ++j) {
+      volume.direction[i][j] = reader.value<double>();
+    }
+  }
+
+  volume.metaData.clear();
+  const unsigned int numberOfKeys = reader.value<unsigned int>();
+  for (unsigned int i = 0; i < numberOfKeys; ++i) {
+    const std::string key = reader.string();
+    volume.metaData[key] = reader.string();
+  }
+
+  const unsigned long long numberOfVoxels = reader.value<unsigned long long>();
+  if (numberOfVoxels > volume.numberOfVoxels()) {
+    throw WrongFileFormatException(fileName);
+  }
+  volume.channels.resize(reader.value<unsigned int>());
+  for (std::size_t i = 0; i < volume.channels.size(); ++i) {
+    volume.channels[i].name = reader.string();
+    volume.channels[i].numberOfComponents = reader.value<unsigned int>();
+  }
+
+  reader.array(volume.indices, numberOfVoxels);
+  for (std::size_t i = 0; i < volume.indices.size(); ++i) {
+    if (volume.indices[i] >= volume.numberOfVoxels()) {
+      throw WrongFileFormatException(fileName);
+    }
+  }
+  for (std::size_t i = 0; i < volume.channels.size(); ++i) {
+    SparseVolume::Channel& channel = volume.channels[i];
+    reader.array(channel.values, numberOfVoxels * channel.numberOfComponents);
+  }
+}
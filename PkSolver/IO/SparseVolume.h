@@ -0,0 +1,55 @@
+#ifndef __SparseVolume_h
+#define __SparseVolume_h
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+//! Values of the voxels of a region of interest only, with the geometry of
+//! the full volume they are scattered back into. Each channel holds one
+//! record of numberOfComponents values per voxel, e.g. a parameter map with
+//! one component or a curve with one component per time point.
+struct SparseVolume
+{
+  struct Channel
+  {
+    Channel() : numberOfComponents(1) {}
+    Channel(const std::string& name, unsigned int numberOfComponents)
+      : name(name), numberOfComponents(numberOfComponents)
+    {}
+
+    std::string name;
+    unsigned int numberOfComponents;
+    //! numberOfComponents values per voxel, in the order of the indices
+    std::vector<float> values;
+  };
+
+  SparseVolume();
+
+  //! Voxels of the full volume
+  std::size_t numberOfVoxels() const { return static_cast<std::size_t>(size[0]) * size[1] * size[2]; }
+
+  unsigned int size[3];
+  double spacing[3];
+  double origin[3];
+  //! Row major, the columns are the directions of the axes
+  double direction[3][3];
+  //! Meta data of the full volume, e.g. the MultiVolume keys of the curves
+  std::map<std::string, std::string> metaData;
+  //! Linear indices of the voxels in the full volume, x fastest
+  std::vector<unsigned long long> indices;
+  std::vector<Channel> channels;
+};
+
+//! Writes the volume in the binary sparse volume format (.pksparse).
+//! Values are stored in the byte order of this machine, which is recorded
+//! in the header. Throws FileNotFoundException if the file cannot be written.
+void writeSparseVolume(const std::string& fileName, const SparseVolume& volume);
+
+//! Reads a file written by writeSparseVolume(). Throws FileNotFoundException
+//! if the file cannot be opened, WrongFileFormatException if it is not a
+//! sparse volume of this machine's byte order or is truncated.
+void readSparseVolume(const std::string& fileName, SparseVolume& volume);
+
+#endif
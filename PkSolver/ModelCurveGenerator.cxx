@@ -0,0 +1,146 @@
+#include "ModelCurveGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+ModelCurveGenerator::ModelCurveGenerator(const ModelManifest& manifest)
+  : m_manifest(manifest),
+    m_timeMinute(manifest.timing.size()),
+    m_shiftStep(0.0),
+    m_costFunction(itk::LMCostFunction::New())
+{
+  if (m_timeMinute.size() < 2) {
+    throw std::runtime_error("The model manifest has less than two time points.");
+  }
+
+  // the model is fitted on a time axis in minutes
+  for (std::size_t i = 0; i < m_timeMinute.size(); ++i) {
+    m_timeMinute[i] = m_manifest.timing[i] / 60.0;
+  }
+
+  const int timeSize = static_cast<int>(m_timeMinute.size());
+  if (m_manifest.aifShiftsPerFrame > 0) {
+    m_shiftStep = (m_timeMinute[timeSize - 1] - m_timeMinute[0]) / ((timeSize - 1) * m_manifest.aifShiftsPerFrame);
+  }
+  const std::vector<float> zeros(timeSize, 0.0f);
+  m_costFunction->SetNumberOfValues(timeSize);
+  m_costFunction->SetCv(&zeros[0], timeSize);
+  m_costFunction->SetTime(&m_timeMinute[0], timeSize);
+  m_costFunction->SetHematocrit(m_manifest.hematocrit);
+  m_costFunction->SetModelType(m_manifest.modelType);
+}
+
+const ModelManifest::AIF& ModelCurveGenerator::getAIF(unsigned int regionLabel) const
+{
+  std::map<unsigned int, ModelManifest::AIF>::const_iterator it = m_manifest.regionalAIFs.find(regionLabel);
+  return it != m_manifest.regionalAIFs.end() ? it->second : m_manifest.aif;
+}
+
+double ModelCurveGenerator::getTimeMinuteAt(double position) const
+{
+  const int last = static_cast<int>(m_timeMinute.size()) - 1;
+  if (position <= 0.0) {
+    return m_timeMinute[0];
+  }
+  if (position >= last) {
+    return m_timeMinute[last];
+  }
+  const int before = static_cast<int>(std::floor(position));
+  const double fraction = position - before;
+  return (1.0 - fraction)*m_timeMinute[before] + fraction*m_timeMinute[before + 1];
+}
+
+itk::LMCostFunction::MeasureType ModelCurveGenerator::modelCurve(const ModelManifest::AIF& aif, double delay,
+                                                                 float ktrans, float ve, float fpv) const
+{
+  const int timeSize = static_cast<int>(m_timeMinute.size());
+
+  // the AIF delayed on the time axis by linear interpolation, as in the
+  // bank of the fit
+  std::vector<float> aifCurve(aif.curve);
+  if (delay > 0.0) {
+    int before = 0;
+    for (int i = 0; i < timeSize; ++i) {
+      aifCurve[i] = 0.0f;
+      if (m_timeMinute[i] - delay < m_timeMinute[0] - 1e-3 * m_shiftStep) {
+        continue;
+      }
+      const double time = std::max(m_timeMinute[i] - delay, static_cast<double>(m_timeMinute[0]));
+      while (before + 1 < timeSize && m_timeMinute[before + 1] <= time) {
+        ++before;
+      }
+      const int after = std::min(before + 1, timeSize - 1);
+      const double interval = m_timeMinute[after] - m_timeMinute[before];
+      const double fraction = interval > 0.0 ? (time - m_timeMinute[before]) / interval : 0.0;
+      aifCurve[i] = (1.0 - fraction)*aif.curve[before] + fraction*aif.curve[after];
+    }
+  }
+  m_costFunction->SetCb(&aifCurve[0], timeSize);
+
+  std::unique_ptr<ParkerAIFModel> analyticAIF;
+  if (aif.hasParkerParameters) {
+    ParkerAIFModel::Parameters parameters = aif.parkerParameters;
+    parameters.arrival += delay;
+    analyticAIF.reset(new ParkerAIFModel(parameters, m_timeMinute));
+  }
+  m_costFunction->SetAnalyticAIF(analyticAIF.get());
+
+  itk::LMCostFunction::ParametersType param(3);
+  param[0] = ktrans;
+  param[1] = ve;
+  param[2] = m_manifest.modelType == itk::LMCostFunction::TOFTS_3_PARAMETER ? fpv : 0.0f;
+  itk::LMCostFunction::MeasureType measure = m_costFunction->GetFittedFunction(param);
+  m_costFunction->SetAnalyticAIF(NULL);
+  return measure;
+}
+
+bool ModelCurveGenerator::fittedCurve(float ktrans, float ve, float fpv, float BAT, float* curve,
+                                      unsigned int regionLabel) const
+{
+  const int timeSize = static_cast<int>(m_timeMinute.size());
+  std::fill(curve, curve + timeSize, 0.0f);
+  if (BAT < 0.0f) {
+    return false;
+  }
+
+  const ModelManifest::AIF& aif = this->getAIF(regionLabel);
+  if (m_manifest.aifShiftsPerFrame > 0) {
+    // the AIF of the bank the voxel was fitted with, from the fractional
+    // BAT of the voxel
+    const double delay = this->getTimeMinuteAt(BAT) - this->getTimeMinuteAt(aif.BATPosition);
+    const int bankIndex = static_cast<int>(std::floor(delay / m_shiftStep + 0.5));
+    if (bankIndex < 0) {
+      return false;
+    }
+    const int bankSize = (timeSize - 1) * static_cast<int>(m_manifest.aifShiftsPerFrame) + 1;
+    const int shift = std::min(bankIndex, bankSize - 1);
+    const itk::LMCostFunction::MeasureType measure = this->modelCurve(aif, shift * m_shiftStep, ktrans, ve, fpv);
+    for (int i = 0; i < timeSize; ++i) {
+      curve[i] = measure[i];
+    }
+    return true;
+  }
+
+  // fitted aligned with the BAT of the AIF, shifted back to the one of the
+  // voxel (note the sense of the shift)
+  const int shift = aif.BATIndex - static_cast<int>(BAT);
+  if (shift > 0) {
+    return false;
+  }
+  const itk::LMCostFunction::MeasureType measure = this->modelCurve(aif, 0.0, ktrans, ve, fpv);
+  for (int i = -shift; i < timeSize; ++i) {
+    curve[i] = measure[i + shift];
+  }
+  return true;
+}
+
+bool ModelCurveGenerator::residualCurve(const float* concentration, float ktrans, float ve, float fpv, float BAT,
+                                        float* residual, unsigned int regionLabel) const
+{
+  const bool fitted = this->fittedCurve(ktrans, ve, fpv, BAT, residual, regionLabel);
+  for (unsigned int i = 0; i < this->getNumberOfTimePoints(); ++i) {
+    residual[i] = concentration[i] - residual[i];
+  }
+  return fitted;
+}
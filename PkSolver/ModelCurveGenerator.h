@@ -0,0 +1,51 @@
+#ifndef __ModelCurveGenerator_h
+#define __ModelCurveGenerator_h
+
+#include "PkSolver.h"
+#include "IO/ModelManifest.h"
+
+#include <memory>
+#include <vector>
+
+//! Regenerates the fitted curves of voxels from their parameter maps and
+//! the model manifest of the run that fitted them, the same way the fit
+//! computes its fitted data output. Not safe to use from several threads,
+//! each thread needs its own generator.
+class ModelCurveGenerator
+{
+public:
+  //! Throws std::runtime_error if the manifest has less than two time points.
+  explicit ModelCurveGenerator(const ModelManifest& manifest);
+
+  unsigned int getNumberOfTimePoints() const { return static_cast<unsigned int>(m_manifest.timing.size()); }
+
+  //! Writes the fitted curve of a voxel to curve, aligned with its
+  //! concentration curve. BAT is the value of the BAT map, the fractional
+  //! BAT with AIF shifts enabled. regionLabel selects the regional AIF the
+  //! voxel was fitted with, the AIF is used if there is none for the label.
+  //! Returns false and a curve of zeros for voxels that were not fitted,
+  //! i.e. with an undetected BAT or a BAT before the one of the AIF.
+  bool fittedCurve(float ktrans, float ve, float fpv, float BAT, float* curve, unsigned int regionLabel = 0) const;
+
+  //! Same as above, writing the concentration minus the fitted curve
+  bool residualCurve(const float* concentration, float ktrans, float ve, float fpv, float BAT, float* residual,
+                     unsigned int regionLabel = 0) const;
+
+private:
+  const ModelManifest::AIF& getAIF(unsigned int regionLabel) const;
+
+  //! Time in minutes at a fractional frame position, as in the fit
+  double getTimeMinuteAt(double position) const;
+
+  //! Model curve of the parameters for aif delayed by delay minutes
+  itk::LMCostFunction::MeasureType modelCurve(const ModelManifest::AIF& aif, double delay,
+                                              float ktrans, float ve, float fpv) const;
+
+  ModelManifest m_manifest;
+  std::vector<float> m_timeMinute;
+  //! Delay between the AIFs of the bank of the fit, in minutes
+  double m_shiftStep;
+  itk::LMCostFunction::Pointer m_costFunction;
+};
+
+#endif
@@ -20,6 +20,8 @@
 #include "SignalComputationUtils.h"
 #include "itkTimeProbesCollectorBase.h"
 #include <string>
+#include <algorithm>
+#include <vector>
 
 namespace itk
 {
@@ -47,7 +49,8 @@ namespace itk
     itk::LevenbergMarquardtOptimizer* optimizer,
     LMCostFunction* costFunction,
     int modelType,
-    const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
+    const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator,
+    const ParkerAIFModel* analyticAIF)
   {
     //std::cout << "in pk solver" << std::endl;
     // probe.Start("pk_solver");
@@ -84,8 +87,9 @@ namespace itk
     costFunction->SetCv(PixelConcentrationCurve, signalSize); //Signal Y
     costFunction->SetTime(timeAxis, signalSize); //Signal X
     costFunction->SetHematocrit(hematocrit);
-    costFunction->GetValue(initialValue); //...
     costFunction->SetModelType(modelType);
+    costFunction->SetAnalyticAIF(analyticAIF);
+    costFunction->GetValue(initialValue); //...
 
     optimizer->UseCostFunctionGradientOff();
 
@@ -199,80 +203,102 @@ namespace itk
     float RGd_relaxivity,
     float s0,
     float S0GradThresh)
+  {
+    if (s0 == -1.0f)
+      s0 = compute_s0_individual_curve(signalSize, SignalIntensityCurve, S0GradThresh, m_batEstimator);
+
+    SignalToConcentrationConverter(T1Pre, TR, FA, RGd_relaxivity).convert(signalSize, SignalIntensityCurve, s0, concentration);
+    return true;
+  }
+
+  SignalToConcentrationConverter::SignalToConcentrationConverter()
+    : m_T1Pre(0.0f), m_InvT1Pre(0.0f), m_NegInvTR(0.0f), m_Relaxivity(4.9E-3f), m_CosAlpha(1.0), m_ConstB(0.0)
+  {
+  }
+
+  SignalToConcentrationConverter::SignalToConcentrationConverter(float T1Pre, float TR, float FA, float RGd_relaxivity)
+    : m_T1Pre(T1Pre), m_Relaxivity(RGd_relaxivity)
   {
     const double exp_TR_BloodT1 = exp(-TR / T1Pre);
     const float alpha = FA * PI / 180;
-    const double cos_alpha = cos(alpha);
-    const double constB = (1 - exp_TR_BloodT1) / (1 - cos_alpha*exp_TR_BloodT1);
+    m_CosAlpha = cos(alpha);
+    m_ConstB = (1 - exp_TR_BloodT1) / (1 - m_CosAlpha*exp_TR_BloodT1);
+    m_NegInvTR = -1 / TR;
+    m_InvT1Pre = (T1Pre != 0) ? 1 / T1Pre : 0.0f;
+  }
 
-    if (s0 == -1.0f)
-      s0 = compute_s0_individual_curve(signalSize, SignalIntensityCurve, S0GradThresh, m_batEstimator);
+  void SignalToConcentrationConverter::convert(unsigned int signalSize,
+    const float* SignalIntensityCurve,
+    float s0,
+    float* concentration) const
+  {
+    if (m_T1Pre == 0)
+    {
+      std::fill(concentration, concentration + signalSize, 0.0f);
+      return;
+    }
 
+    // No branches on the computation itself, zero signal and NaN are only
+    // masked out at the end, so the loop is friendly to vectorisation
     for (unsigned int t = 0; t < signalSize; ++t)
     {
       const float tSignal = SignalIntensityCurve[t];
-      if (tSignal == 0)
-      {
-        concentration[t] = 0;
-        continue;
-      }
-
       const double constA = tSignal / s0;
-      double value = (1 - constA * constB) / (1 - constA * constB * cos_alpha);
-      double log_value = log(value);
-      if (IS_NAN(log_value))
-      {
-        concentration[t] = 0;
-      }
-      else {
-        const float ROft = (-1 / TR) * log_value;
-        if (T1Pre != 0)
-        {
-          double Cb = (ROft - (1 / T1Pre)) / RGd_relaxivity;
-          assert(IS_NAN(Cb) == false);
-          if (Cb < 0)
-            Cb = 0;
-          concentration[t] = float(Cb);
-        }
-        else
-          concentration[t] = 0;
-      }
+      const double value = (1 - constA * m_ConstB) / (1 - constA * m_ConstB * m_CosAlpha);
+      const double log_value = log(value);
+      const float ROft = m_NegInvTR * log_value;
+      const float Cb = (ROft - m_InvT1Pre) / m_Relaxivity;
+      const bool valid = (tSignal != 0) & !IS_NAN(log_value);
+      concentration[t] = (valid & !(Cb < 0)) ? Cb : 0.0f;
     }
+  }
 
-    return true;
+  float area_under_curve(int signalSize,
+    const float* timeAxis,
+    const float* concentration,
+    int BATIndex,
+    float aucTimeInterval)
+  {
+    std::vector<double> cumulativeArea(signalSize);
+    cumulative_area_under_curve(signalSize, timeAxis, concentration, &cumulativeArea[0]);
+    return area_under_curve(signalSize, timeAxis, concentration, &cumulativeArea[0], BATIndex, aucTimeInterval);
+  }
+
+  void cumulative_area_under_curve(int signalSize,
+    const float* timeAxis,
+    const float* concentration,
+    double* cumulativeArea)
+  {
+    if (signalSize <= 0) return;
+    cumulativeArea[0] = 0.0;
+    for (int i = 1; i < signalSize; ++i)
+    {
+      cumulativeArea[i] = cumulativeArea[i - 1] + (timeAxis[i] - timeAxis[i - 1])*(concentration[i] + concentration[i - 1]) / 2.0;
+    }
   }
 
   float area_under_curve(int signalSize,
     const float* timeAxis,
     const float* concentration,
+    const double* cumulativeArea,
     int BATIndex,
     float aucTimeInterval)
   {
     float auc = 0.0f;
-    if (BATIndex >= signalSize) return auc;
-    //std::cerr << std::endl << "BATIndex:"<<BATIndex << std::endl;
+    if (BATIndex < 0 || BATIndex >= signalSize) return auc;
 
-    int lastIndex = BATIndex;
-    //std::cerr << std::endl << "timeAxis[0]:"<< timeAxis[0] << std::endl;
+    // find the last index, the last time point before the end of the
+    // interval but at most the second to last time point
     float targetTime = timeAxis[BATIndex] + aucTimeInterval;
-    //std::cerr << std::endl << "targetTime:"<< targetTime << std::endl;
-    float tempTime = timeAxis[BATIndex + 1];
-    //std::cerr << std::endl << "tempTime:"<< tempTime << std::endl;
-
-    //find the last index
-    while ((tempTime < targetTime) && (lastIndex < (signalSize - 2)))
+    int lastIndex = BATIndex;
+    if (BATIndex < signalSize - 2 && timeAxis[BATIndex + 1] < targetTime)
     {
-      lastIndex += 1;
-      tempTime = timeAxis[lastIndex + 1];
-      //std::cerr << std::endl << "tempTime"<<tempTime << std::endl;
+      const float* end = std::lower_bound(timeAxis + BATIndex + 2, timeAxis + signalSize, targetTime);
+      lastIndex = std::min(static_cast<int>(end - timeAxis) - 1, signalSize - 2);
     }
 
     if ((lastIndex - BATIndex) == 0) return auc = aucTimeInterval*concentration[BATIndex];
 
-    //extract time and concentration
-    float * concentrationValues = new float[lastIndex - BATIndex + 2]();
-    float * timeValues = new float[lastIndex - BATIndex + 2]();
-
     //find the extra time and concentration value for auc
     float y1, y2, x1, x2, slope, b, targetX, targetY;
     y2 = concentration[lastIndex + 1];
@@ -281,30 +307,66 @@ namespace itk
     x1 = timeAxis[lastIndex];
     slope = (y2 - y1) / (x2 - x1);
     b = y1 - slope*x1;
-    targetX = timeAxis[BATIndex] + aucTimeInterval;
+    targetX = targetTime;
     targetY = slope*targetX + b;
     if (targetX > timeAxis[signalSize - 1])
     {
       targetX = timeAxis[lastIndex + 1];
       targetY = concentration[lastIndex + 1];
     }
-    concentrationValues[lastIndex - BATIndex + 1] = targetY; //put the extra value at the end
-    timeValues[lastIndex - BATIndex + 1] = targetX; //put the extra time value at the end
 
-    //	printf("lastIndex is %f\n", (float)lastIndex);
-    for (int i = 0; i < (lastIndex - BATIndex + 1); ++i)
+    //get auc
+    auc = static_cast<float>(cumulativeArea[lastIndex] - cumulativeArea[BATIndex]
+      + (targetX - x1)*(targetY + y1) / 2.0);
+    return auc;
+  }
+
+  void compute_curve_shape(int signalSize,
+    const float* timeAxis,
+    const float* concentration,
+    int BATIndex,
+    float& timeToPeak,
+    float& peakEnhancement,
+    float& washoutSlope)
+  {
+    int peak = BATIndex;
+    for (int i = BATIndex + 1; i < signalSize; ++i)
     {
-      concentrationValues[i] = concentration[i + BATIndex];
-      timeValues[i] = timeAxis[i + BATIndex];
-      //printf("lastIndex is %f,%f\n", (float) concentrationValues[i],(float)timeValues[i]);
+      if (concentration[i] > concentration[peak])
+      {
+        peak = i;
+      }
     }
+    timeToPeak = timeAxis[peak] - timeAxis[BATIndex];
+    peakEnhancement = concentration[peak];
+    washoutSlope = 0.0f;
 
-    //get auc
-    auc = intergrate(concentrationValues, timeValues, (lastIndex - BATIndex + 2));
-
-    delete[] concentrationValues;
-    delete[] timeValues;
-    return auc;
+    // Least squares slope of the curve from the peak to the end
+    const int count = signalSize - peak;
+    if (count < 2)
+    {
+      return;
+    }
+    double meanTime = 0.0;
+    double meanValue = 0.0;
+    for (int i = peak; i < signalSize; ++i)
+    {
+      meanTime += timeAxis[i];
+      meanValue += concentration[i];
+    }
+    meanTime /= count;
+    meanValue /= count;
+    double timeVariance = 0.0;
+    double covariance = 0.0;
+    for (int i = peak; i < signalSize; ++i)
+    {
+      timeVariance += (timeAxis[i] - meanTime) * (timeAxis[i] - meanTime);
+      covariance += (timeAxis[i] - meanTime) * (concentration[i] - meanValue);
+    }
+    if (timeVariance > 0.0)
+    {
+      washoutSlope = static_cast<float>(covariance / timeVariance);
+    }
   }
 
   float intergrate(float* yValues, float * xValues, int size)
@@ -441,9 +503,7 @@ namespace itk
 
   float compute_s0_individual_curve(int signalSize, const float* SignalY, float S0GradThresh, const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator)
   {
-    double S0 = 0;
     int ArrivalTime;
-    bool result;
 
     try {
       ArrivalTime = batEstimator->getBATIndex(signalSize, SignalY);
@@ -454,6 +514,18 @@ namespace itk
       return 0;
     }
 
+    return compute_s0_individual_curve(signalSize, SignalY, S0GradThresh, ArrivalTime);
+  }
+
+  float compute_s0_individual_curve(int signalSize, const float* SignalY, float S0GradThresh, int ArrivalTime)
+  {
+    double S0 = 0;
+
+    if (ArrivalTime < 0)
+    {
+      return 0;
+    }
+
     float* SignalGradient = new float[signalSize];
     //above: same
     compute_gradient(signalSize, SignalY, SignalGradient);
@@ -22,6 +22,7 @@
 #include <string>
 #include <exception>
 #include "BAT/BolusArrivalTimeEstimator.h"
+#include "AIF/ParkerAIFModel.h"
 
 
 // work around compile error on Win
@@ -106,6 +107,7 @@ namespace itk
 
     LMCostFunction()
     {
+      m_AnalyticAIF = NULL;
     }
 
     void SetHematocrit(float hematocrit)
@@ -118,6 +120,13 @@ namespace itk
       m_ModelType = model;
     }
 
+    // When set, the convolution with the AIF is evaluated on this functional
+    // form instead of discretely on Cb. Its time axis has to be Time.
+    void SetAnalyticAIF(const ParkerAIFModel* analyticAIF)
+    {
+      m_AnalyticAIF = analyticAIF;
+    }
+
     void SetNumberOfValues(unsigned int NumberOfValues)
     {
       RangeDimension = NumberOfValues;
@@ -151,49 +160,13 @@ namespace itk
     MeasureType GetValue(const ParametersType & parameters) const
     {
       MeasureType measure(RangeDimension);
-
-      ValueType Ktrans = parameters[0];
-      ValueType Ve = parameters[1];
-
-      ArrayType VeTerm;
-      VeTerm = -Ktrans / Ve*Time;
-      ValueType deltaT = Time(1) - Time(0);
-
-      if (m_ModelType == TOFTS_3_PARAMETER)
-      {
-        ValueType f_pv = parameters[2];
-        measure = Cv - (1 / (1.0 - m_Hematocrit)*(Ktrans*deltaT*Convolution(Cb, Exponential(VeTerm)) + f_pv*Cb));
-      }
-      else if (m_ModelType == TOFTS_2_PARAMETER)
-      {
-        measure = Cv - (1 / (1.0 - m_Hematocrit)*(Ktrans*deltaT*Convolution(Cb, Exponential(VeTerm))));
-      }
-
+      measure = Cv - Model(parameters);
       return measure;
     }
 
     MeasureType GetFittedFunction(const ParametersType & parameters) const
     {
-      MeasureType measure(RangeDimension);
-
-      ValueType Ktrans = parameters[0];
-      ValueType Ve = parameters[1];
-
-      ArrayType VeTerm;
-      VeTerm = -Ktrans / Ve*Time;
-      ValueType deltaT = Time(1) - Time(0);
-
-      if (m_ModelType == TOFTS_3_PARAMETER)
-      {
-        ValueType f_pv = parameters[2];
-        measure = 1 / (1.0 - m_Hematocrit)*(Ktrans*deltaT*Convolution(Cb, Exponential(VeTerm)) + f_pv*Cb);
-      }
-      else if (m_ModelType == TOFTS_2_PARAMETER)
-      {
-        measure = 1 / (1.0 - m_Hematocrit)*(Ktrans*deltaT*Convolution(Cb, Exponential(VeTerm)));
-      }
-
-      return measure;
+      return Model(parameters);
     }
 
     //Not going to be used
@@ -224,6 +197,43 @@ namespace itk
   private:
 
     ArrayType Cv, Cb, Time;
+    const ParkerAIFModel* m_AnalyticAIF;
+
+    MeasureType Model(const ParametersType & parameters) const
+    {
+      MeasureType measure(RangeDimension);
+
+      ValueType Ktrans = parameters[0];
+      ValueType Ve = parameters[1];
+
+      if (m_AnalyticAIF)
+      {
+        m_AnalyticAIF->convolveExponential(Ktrans / Ve, measure.data_block());
+        const std::vector<double>& samples = m_AnalyticAIF->getSamples();
+        ValueType f_pv = (m_ModelType == TOFTS_3_PARAMETER) ? parameters[2] : 0.0;
+        for (unsigned int i = 0; i < measure.size(); i++)
+        {
+          measure[i] = 1 / (1.0 - m_Hematocrit)*(Ktrans*measure[i] + f_pv*samples[i]);
+        }
+        return measure;
+      }
+
+      ArrayType VeTerm;
+      VeTerm = -Ktrans / Ve*Time;
+      ValueType deltaT = Time(1) - Time(0);
+
+      if (m_ModelType == TOFTS_3_PARAMETER)
+      {
+        ValueType f_pv = parameters[2];
+        measure = 1 / (1.0 - m_Hematocrit)*(Ktrans*deltaT*Convolution(Cb, Exponential(VeTerm)) + f_pv*Cb);
+      }
+      else if (m_ModelType == TOFTS_2_PARAMETER)
+      {
+        measure = 1 / (1.0 - m_Hematocrit)*(Ktrans*deltaT*Convolution(Cb, Exponential(VeTerm)));
+      }
+
+      return measure;
+    }
 
     ArrayType Convolution(ArrayType X, ArrayType Y) const
     {
@@ -311,7 +321,8 @@ namespace itk
     itk::LevenbergMarquardtOptimizer* optimizer,
     LMCostFunction* costFunction,
     int modelType = itk::LMCostFunction::TOFTS_2_PARAMETER,
-    const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator = NULL);
+    const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator = NULL,
+    const ParkerAIFModel* analyticAIF = NULL);
 
   void pk_report();
   void pk_clear();
@@ -324,8 +335,48 @@ namespace itk
     float s0 = -1.0f,
     float S0GradThresh = 15.0f);
 
+  // Signal intensity to concentration conversion with the constants that
+  // only depend on T1Pre and the acquisition computed once. Instances are
+  // meant to be created once per distinct T1Pre value and shared by all
+  // voxels that use it (read-only, so also between threads).
+  class SignalToConcentrationConverter
+  {
+  public:
+    SignalToConcentrationConverter();
+    SignalToConcentrationConverter(float T1Pre, float TR, float FA, float relaxivity = 4.9E-3f);
+
+    float getT1Pre() const { return m_T1Pre; }
+
+    // Same result as convert_signal_to_concentration() with the given s0
+    void convert(unsigned int signalSize, const float* SignalIntensityCurve, float s0, float* concentration) const;
+
+  private:
+    float  m_T1Pre;
+    float  m_InvT1Pre;
+    float  m_NegInvTR;
+    float  m_Relaxivity;
+    double m_CosAlpha;
+    double m_ConstB;
+  };
+
   float area_under_curve(int signalSize, const float* timeAxis, const float* concentration, int BATIndex, float aucTimeInterval);
 
+  // Trapezoidal integral of the concentration from the first time point to
+  // each time point, cumulativeArea[0] is 0. Computed once per curve, every
+  // area_under_curve below is then evaluated in constant time (plus a
+  // binary search for the end of the interval).
+  void cumulative_area_under_curve(int signalSize, const float* timeAxis, const float* concentration, double* cumulativeArea);
+
+  // Same result as above, from the output of cumulative_area_under_curve()
+  float area_under_curve(int signalSize, const float* timeAxis, const float* concentration, const double* cumulativeArea,
+    int BATIndex, float aucTimeInterval);
+
+  // Curve shape after the bolus arrival: the time from the BAT to the peak of
+  // the concentration after it, the peak value, and the least squares slope
+  // from the peak to the end. The slope is 0 if the peak is the last point.
+  void compute_curve_shape(int signalSize, const float* timeAxis, const float* concentration, int BATIndex,
+    float& timeToPeak, float& peakEnhancement, float& washoutSlope);
+
   float intergrate(float* yValues, float * xValues, int size);
 
   void compute_derivative(int signalSize, const float* SingnalY, float* YDeriv);
@@ -345,6 +396,10 @@ namespace itk
 
   float compute_s0_individual_curve(int signalSize, const float* SignalY, float S0GradThresh, const BolusArrivalTime::BolusArrivalTimeEstimator* batEstimator);
 
+  // Same as above, for a bolus arrival time index that is already known.
+  // A negative index means BAT detection failed and S0 is 0.
+  float compute_s0_individual_curve(int signalSize, const float* SignalY, float S0GradThresh, int ArrivalTime);
+
 };
 
 #endif
@@ -18,4 +18,21 @@ namespace StringUtils
     return elems;
   }
 
-}
\ No newline at end of file
+  std::string insertBeforeExtension(const std::string &fileName, const std::string &suffix) {
+    const std::string::size_type nameStart = fileName.find_last_of("/\\");
+    const std::string::size_type searchStart = nameStart == std::string::npos ? 0 : nameStart + 1;
+    std::string::size_type extension = fileName.find_last_of('.');
+    if (extension == std::string::npos || extension <= searchStart) {
+      return fileName + suffix;
+    }
+    // compressed files keep both extensions, e.g. .nii.gz
+    if (fileName.compare(extension, std::string::npos, ".gz") == 0) {
+      const std::string::size_type previous = fileName.find_last_of('.', extension - 1);
+      if (previous != std::string::npos && previous > searchStart) {
+        extension = previous;
+      }
+    }
+    return fileName.substr(0, extension) + suffix + fileName.substr(extension);
+  }
+
+}
@@ -11,5 +11,9 @@ namespace StringUtils
 
   std::vector<std::string> split(const std::string &s, char delim);
 
+  //! Inserts suffix between the name and the extension of a file name,
+  //! "out/auc.nii.gz" with suffix "-60s" becomes "out/auc-60s.nii.gz".
+  std::string insertBeforeExtension(const std::string &fileName, const std::string &suffix);
+
 }
 #endif
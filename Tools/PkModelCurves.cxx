@@ -0,0 +1,281 @@
+/*=========================================================================
+
+  Program:   PkModeling module
+  Language:  C++
+
+  Regenerates the fitted curves, or the residuals, of voxels from the
+  parameter maps and the model manifest (--outputModelManifest) of a
+  PkModeling run, for single voxels or all voxels of a region.
+
+  See License.txt or http://www.slicer.org/copyright/copyright.txt for details.
+  =========================================================================*/
+
+#include "itkImage.h"
+#include "itkVectorImage.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkMetaDataObject.h"
+
+#include "IO/ModelManifest.h"
+#include "ModelCurveGenerator.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+  typedef itk::Image<float, 3>          MapVolumeType;
+  typedef itk::Image<unsigned short, 3> LabelVolumeType;
+  typedef itk::VectorImage<float, 3>    CurveVolumeType;
+
+  struct Options
+  {
+    std::string manifestFileName;
+    std::string ktransFileName;
+    std::string veFileName;
+    std::string batFileName;
+    std::string fpvFileName;
+    std::string aifRegionsFileName;
+    std::string concentrationsFileName;
+    std::string roiFileName;
+    std::string outputFileName;
+    std::vector<MapVolumeType::IndexType> voxels;
+  };
+
+  void printUsage(const char* program)
+  {
+    std::cerr << "Usage: " << program << " <manifest.csv> <ktrans> <ve> <bat> [options]" << std::endl
+              << "  --fpv <file>             Fpv map, for the three parameter model" << std::endl
+              << "  --aifRegions <file>      AIF region map of the run, for regional AIFs" << std::endl
+              << "  --residuals <file>       Concentrations of the run, to output the" << std::endl
+              << "                           concentration minus the fitted curve" << std::endl
+              << "  --voxel i,j,k            Print the curve of a voxel as comma separated" << std::endl
+              << "                           values, may be repeated" << std::endl
+              << "  --output <file>          Write the curves of the voxels of the ROI" << std::endl
+              << "  --roi <file>             ROI of --output, all voxels if not set" << std::endl;
+  }
+
+  bool parseVoxel(const std::string& value, MapVolumeType::IndexType& index)
+  {
+    std::istringstream in(value);
+    char separator1 = 0, separator2 = 0;
+    in >> index[0] >> separator1 >> index[1] >> separator2 >> index[2];
+    return !in.fail() && in.eof() && separator1 == ',' && separator2 == ',';
+  }
+
+  bool parseOptions(int argc, char* argv[], Options& options)
+  {
+    if (argc < 5) {
+      return false;
+    }
+    options.manifestFileName = argv[1];
+    options.ktransFileName = argv[2];
+    options.veFileName = argv[3];
+    options.batFileName = argv[4];
+    for (int i = 5; i < argc; i += 2) {
+      const std::string option = argv[i];
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const std::string value = argv[i + 1];
+      if (option == "--fpv") {
+        options.fpvFileName = value;
+      }
+      else if (option == "--aifRegions") {
+        options.aifRegionsFileName = value;
+      }
+      else if (option == "--residuals") {
+        options.concentrationsFileName = value;
+      }
+      else if (option == "--roi") {
+        options.roiFileName = value;
+      }
+      else if (option == "--output") {
+        options.outputFileName = value;
+      }
+      else if (option == "--voxel") {
+        MapVolumeType::IndexType index;
+        if (!parseVoxel(value, index)) {
+          return false;
+        }
+        options.voxels.push_back(index);
+      }
+      else {
+        return false;
+      }
+    }
+    return !options.voxels.empty() || !options.outputFileName.empty();
+  }
+
+  template <class TVolume>
+  typename TVolume::Pointer read(const std::string& fileName)
+  {
+    if (fileName.empty()) {
+      return NULL;
+    }
+    typename itk::ImageFileReader<TVolume>::Pointer reader = itk::ImageFileReader<TVolume>::New();
+    reader->SetFileName(fileName.c_str());
+    reader->Update();
+    return reader->GetOutput();
+  }
+
+  //! The parameter maps of a run and the curves they regenerate
+  class Curves
+  {
+  public:
+    Curves(const Options& options, const ModelManifest& manifest)
+      : m_generator(manifest),
+        m_ktrans(read<MapVolumeType>(options.ktransFileName)),
+        m_ve(read<MapVolumeType>(options.veFileName)),
+        m_bat(read<MapVolumeType>(options.batFileName)),
+        m_fpv(read<MapVolumeType>(options.fpvFileName)),
+        m_aifRegions(read<LabelVolumeType>(options.aifRegionsFileName)),
+        m_concentrations(read<CurveVolumeType>(options.concentrationsFileName))
+    {
+      if (manifest.modelType == itk::LMCostFunction::TOFTS_3_PARAMETER && m_fpv.IsNull()) {
+        throw std::runtime_error("The three parameter model needs the Fpv map (--fpv).");
+      }
+      if (m_concentrations.IsNotNull() &&
+          m_concentrations->GetNumberOfComponentsPerPixel() != m_generator.getNumberOfTimePoints()) {
+        throw std::runtime_error("The concentrations and the manifest differ in the number of time points.");
+      }
+    }
+
+    const MapVolumeType* getGeometry() const { return m_ktrans.GetPointer(); }
+
+    const CurveVolumeType* getConcentrations() const { return m_concentrations.GetPointer(); }
+
+    unsigned int getNumberOfTimePoints() const { return m_generator.getNumberOfTimePoints(); }
+
+    bool isInside(const MapVolumeType::IndexType& index) const
+    {
+      return m_ktrans->GetLargestPossibleRegion().IsInside(index);
+    }
+
+    //! The fitted curve of the voxel, or its residual with --residuals
+    void curve(const MapVolumeType::IndexType& index, float* curve) const
+    {
+      const float fpv = m_fpv.IsNotNull() ? m_fpv->GetPixel(index) : 0.0f;
+      const unsigned int label = m_aifRegions.IsNotNull() ? m_aifRegions->GetPixel(index) : 0;
+      const float BAT = m_bat->GetPixel(index);
+      if (m_concentrations.IsNotNull()) {
+        const CurveVolumeType::PixelType concentration = m_concentrations->GetPixel(index);
+        m_generator.residualCurve(concentration.GetDataPointer(), m_ktrans->GetPixel(index), m_ve->GetPixel(index),
+                                  fpv, BAT, curve, label);
+      }
+      else {
+        m_generator.fittedCurve(m_ktrans->GetPixel(index), m_ve->GetPixel(index), fpv, BAT, curve, label);
+      }
+    }
+
+  private:
+    ModelCurveGenerator m_generator;
+    MapVolumeType::Pointer m_ktrans;
+    MapVolumeType::Pointer m_ve;
+    MapVolumeType::Pointer m_bat;
+    MapVolumeType::Pointer m_fpv;
+    LabelVolumeType::Pointer m_aifRegions;
+    CurveVolumeType::Pointer m_concentrations;
+  };
+
+  void printVoxels(const Curves& curves, const std::vector<MapVolumeType::IndexType>& voxels)
+  {
+    std::vector<float> curve(curves.getNumberOfTimePoints());
+    for (std::size_t v = 0; v < voxels.size(); ++v) {
+      const MapVolumeType::IndexType& index = voxels[v];
+      if (!curves.isInside(index)) {
+        throw std::runtime_error("Voxel outside of the parameter maps.");
+      }
+      curves.curve(index, &curve[0]);
+      std::cout << index[0] << "," << index[1] << "," << index[2];
+      for (std::size_t i = 0; i < curve.size(); ++i) {
+        std::cout << "," << curve[i];
+      }
+      std::cout << std::endl;
+    }
+  }
+
+  void writeVolume(const Curves& curves, const ModelManifest& manifest, const std::string& roiFileName,
+                   const std::string& fileName)
+  {
+    const unsigned int timeSize = curves.getNumberOfTimePoints();
+    CurveVolumeType::Pointer volume = CurveVolumeType::New();
+    volume->CopyInformation(curves.getGeometry());
+    volume->SetRegions(curves.getGeometry()->GetLargestPossibleRegion());
+    volume->SetNumberOfComponentsPerPixel(timeSize);
+    volume->Allocate();
+    CurveVolumeType::PixelType zero(timeSize);
+    zero.Fill(0.0f);
+    volume->FillBuffer(zero);
+
+    // the curves are multi-volumes with the frames of the run
+    if (curves.getConcentrations()) {
+      volume->SetMetaDataDictionary(curves.getConcentrations()->GetMetaDataDictionary());
+    }
+    else {
+      std::ostringstream frameLabels;
+      for (unsigned int i = 0; i < timeSize; ++i) {
+        frameLabels << (i ? "," : "") << manifest.timing[i] * 1000.0;
+      }
+      std::ostringstream numberOfFrames;
+      numberOfFrames << timeSize;
+      itk::MetaDataDictionary& dictionary = volume->GetMetaDataDictionary();
+      itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameIdentifyingDICOMTagUnits", "ms");
+      itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.FrameLabels", frameLabels.str());
+      itk::EncapsulateMetaData<std::string>(dictionary, "MultiVolume.NumberOfFrames", numberOfFrames.str());
+    }
+
+    LabelVolumeType::Pointer roi = read<LabelVolumeType>(roiFileName);
+    if (roi.IsNotNull() && roi->GetLargestPossibleRegion() != volume->GetLargestPossibleRegion()) {
+      throw std::runtime_error("The ROI and the parameter maps differ in size.");
+    }
+    itk::ImageRegionConstIteratorWithIndex<MapVolumeType> it(curves.getGeometry(), volume->GetLargestPossibleRegion());
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it) {
+      const MapVolumeType::IndexType index = it.GetIndex();
+      if (roi.IsNull() || roi->GetPixel(index) != 0) {
+        curves.curve(index, volume->GetBufferPointer() + volume->ComputeOffset(index) * timeSize);
+      }
+    }
+
+    itk::ImageFileWriter<CurveVolumeType>::Pointer writer = itk::ImageFileWriter<CurveVolumeType>::New();
+    writer->SetFileName(fileName.c_str());
+    writer->SetInput(volume);
+    writer->SetUseCompression(1);
+    writer->Update();
+  }
+}
+
+
+int main(int argc, char * argv[])
+{
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  try
+  {
+    ModelManifest manifest;
+    readModelManifest(options.manifestFileName, manifest);
+    const Curves curves(options, manifest);
+
+    printVoxels(curves, options.voxels);
+    if (!options.outputFileName.empty()) {
+      std::cout << "Writing " << options.outputFileName << std::endl;
+      writeVolume(curves, manifest, options.roiFileName, options.outputFileName);
+    }
+  }
+  catch (std::exception& excep)
+  {
+    std::cerr << argv[0] << ": exception caught !" << std::endl;
+    std::cerr << excep.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/*=========================================================================
+
+  Program:   PkModeling module
+  Language:  C++
+
+  Scatters the sparse ROI output of PkModeling (--outputSparse) back into
+  full size volumes, one file per channel. Voxels outside the ROI are 0.
+
+  See License.txt or http://www.slicer.org/copyright/copyright.txt for details.
+  =========================================================================*/
+
+#include "itkImage.h"
+#include "itkVectorImage.h"
+#include "itkImageFileWriter.h"
+#include "itkMetaDataObject.h"
+
+#include "IO/SparseVolume.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+
+namespace
+{
+  typedef itk::Image<float, 3>       MapVolumeType;
+  typedef itk::VectorImage<float, 3> CurveVolumeType;
+
+  template <class TVolume>
+  void setGeometry(const SparseVolume& sparse, TVolume* volume)
+  {
+    typename TVolume::RegionType region;
+    typename TVolume::SpacingType spacing;
+    typename TVolume::PointType origin;
+    typename TVolume::DirectionType direction;
+    for (unsigned int i = 0; i < 3; ++i) {
+      region.SetSize(i, sparse.size[i]);
+      spacing[i] = sparse.spacing[i];
+      origin[i] = sparse.origin[i];
+      for (unsigned int j = 0; j < 3; ++j) {
+        direction[i][j] = sparse.direction[i][j];
+      }
+    }
+    volume->SetRegions(region);
+    volume->SetSpacing(spacing);
+    volume->SetOrigin(origin);
+    volume->SetDirection(direction);
+  }
+
+  void scatter(const SparseVolume& sparse, const SparseVolume::Channel& channel, float* buffer)
+  {
+    const unsigned int numberOfComponents = channel.numberOfComponents;
+    std::fill(buffer, buffer + sparse.numberOfVoxels() * numberOfComponents, 0.0f);
+    for (std::size_t i = 0; i < sparse.indices.size(); ++i) {
+      std::copy(channel.values.begin() + i * numberOfComponents,
+                channel.values.begin() + (i + 1) * numberOfComponents,
+                buffer + sparse.indices[i] * numberOfComponents);
+    }
+  }
+
+  template <class TVolume>
+  void write(TVolume* volume, const std::string& fileName)
+  {
+    typename itk::ImageFileWriter<TVolume>::Pointer writer = itk::ImageFileWriter<TVolume>::New();
+    writer->SetFileName(fileName.c_str());
+    writer->SetInput(volume);
+    writer->SetUseCompression(1);
+    writer->Update();
+  }
+
+  void writeChannel(const SparseVolume& sparse, const SparseVolume::Channel& channel, const std::string& fileName)
+  {
+    if (channel.numberOfComponents == 1) {
+      MapVolumeType::Pointer volume = MapVolumeType::New();
+      setGeometry(sparse, volume.GetPointer());
+      volume->Allocate();
+      scatter(sparse, channel, volume->GetBufferPointer());
+      write(volume.GetPointer(), fileName);
+    }
+    else {
+      CurveVolumeType::Pointer volume = CurveVolumeType::New();
+      setGeometry(sparse, volume.GetPointer());
+      volume->SetNumberOfComponentsPerPixel(channel.numberOfComponents);
+      volume->Allocate();
+      scatter(sparse, channel, volume->GetBufferPointer());
+
+      // the curves are multi-volumes with the frames of the input
+      itk::MetaDataDictionary& dictionary = volume->GetMetaDataDictionary();
+      std::map<std::string, std::string>::const_iterator it;
+      for (it = sparse.metaData.begin(); it != sparse.metaData.end(); ++it) {
+        itk::EncapsulateMetaData<std::string>(dictionary, it->first, it->second);
+      }
+      write(volume.GetPointer(), fileName);
+    }
+  }
+}
+
+
+int main(int argc, char * argv[])
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <input.pksparse> <output prefix> [channel ...]" << std::endl;
+    std::cerr << "Writes <output prefix>-<channel>.nrrd for the listed channels, all channels if none are listed." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try
+  {
+    SparseVolume sparse;
+    readSparseVolume(argv[1], sparse);
+    const std::string prefix = argv[2];
+    const std::vector<std::string> requested(argv + 3, argv + argc);
+
+    for (std::size_t i = 0; i < requested.size(); ++i) {
+      bool found = false;
+      for (std::size_t c = 0; c < sparse.channels.size(); ++c) {
+        found = found || sparse.channels[c].name == requested[i];
+      }
+      if (!found) {
+        std::cerr << "No channel \"" << requested[i] << "\" in " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    for (std::size_t c = 0; c < sparse.channels.size(); ++c) {
+      const SparseVolume::Channel& channel = sparse.channels[c];
+      if (!requested.empty() && std::find(requested.begin(), requested.end(), channel.name) == requested.end()) {
+        continue;
+      }
+      const std::string fileName = prefix + "-" + channel.name + ".nrrd";
+      std::cout << "Writing " << fileName << std::endl;
+      writeChannel(sparse, channel, fileName);
+    }
+  }
+  catch (std::exception& excep)
+  {
+    std::cerr << argv[0] << ": exception caught !" << std::endl;
+    std::cerr << excep.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}